@@ -15,8 +15,11 @@
 #include <string>
 #include <iostream>
 #include <cerrno>
+#include <cstdlib>
+#include <vector>
 
 using std::string;
+using std::vector;
 using std::fstream;
 using std::cerr;
 using std::endl;
@@ -38,6 +41,11 @@ class BinaryRead : public fstream {
 
         // Overloaded output/input ops. resp.
         template <class T> BinaryRead & operator>>(T& val);
+    
+        // Reads buffer written by BinaryWrite::writeBuffer(), if fixedSize is true
+        // the buffer is not resized (others may hold pointers into it), so the
+        // stored length must match present size.
+        template <class T, class A> void readBuffer(vector<T, A> & buffer, bool fixedSize);
 };
 
 // We include code here because of templates definitions having to be visible at compile time
@@ -51,4 +59,45 @@ BinaryRead & BinaryRead::operator>>(T& val) {
     return *this;
 }
 
+template <class T, class A>
+void BinaryRead::readBuffer(vector<T, A> & buffer, bool fixedSize) {
+    
+    unsigned long long length;
+    *this >> length;
+    
+    if(fixedSize && length != buffer.size()) {
+        
+        cerr << "Buffer size in " << filename << " does not match: " << length << " != " << buffer.size() << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    // A corrupt length must not resize to more than the file holds
+    std::streampos here = tellg();
+    seekg(0, std::ios::end);
+    unsigned long long remaining = static_cast<unsigned long long>(tellg() - here);
+    seekg(here);
+    
+    if(length > remaining / sizeof(T)) {
+        
+        cerr << "Buffer in " << filename << " is truncated or corrupt: " << length << " elements, " << remaining << " bytes left" << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    buffer.resize(length);
+    
+    if(length == 0)
+        return;
+    
+    read(reinterpret_cast<char*>(&buffer[0]), length * sizeof(T));
+    
+    if(fail() || static_cast<unsigned long long>(gcount()) != length * sizeof(T)) {
+        
+        cerr << "Failed while reading buffer in " << filename << ": " << gcount() << " of " << length * sizeof(T) << " bytes" << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+}
+
 #endif // BINARYREAD_H
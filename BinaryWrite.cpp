@@ -10,11 +10,11 @@
 // Includes
 #include "BinaryWrite.h"
 
-BinaryWrite::BinaryWrite() : fstream() {}
+BinaryWrite::BinaryWrite() : fstream(), exitOnFailure(true) {}
 
-BinaryWrite::BinaryWrite(const char * filename) : fstream() { openFile(filename); }
+BinaryWrite::BinaryWrite(const char * filename) : fstream(), exitOnFailure(true) { openFile(filename); }
 
-BinaryWrite::BinaryWrite(const string & filename) : fstream() { openFile(filename); }
+BinaryWrite::BinaryWrite(const string & filename) : fstream(), exitOnFailure(true) { openFile(filename); }
 
 void BinaryWrite::openFile(const string & filename) { openFile(filename.c_str()); }
 
@@ -31,8 +31,28 @@ void BinaryWrite::openFile(const char * filename) {
         
 	} catch (fstream::failure e) { 
         
+        if(!exitOnFailure)
+            throw std::runtime_error(string(strerror(errno)) + ", file = " + filename);
+        
 		cerr << "Unable to open file for writing: error = " << strerror(errno) << ", file = " << filename << endl;
         cerr.flush();
 		exit(EXIT_FAILURE);
 	}
 }
+
+void BinaryWrite::close() {
+    
+    try {
+        
+        fstream::close();
+        
+    } catch (fstream::failure e) {
+        
+        if(!exitOnFailure)
+            throw std::runtime_error(string(strerror(errno)) + ", file = " + filename);
+        
+    	cerr << "Unable to write to: error = " << strerror(errno) << ", file = " << filename << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+}
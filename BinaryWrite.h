@@ -17,8 +17,11 @@
 #include <cerrno>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
+#include <stdexcept>
 
 using std::string;
+using std::vector;
 using std::fstream;
 using std::cerr;
 using std::endl;
@@ -26,10 +29,15 @@ using std::endl;
 class BinaryWrite : public fstream {
 
 	private:   
-        const char * filename;
+        string filename;
     
     public: 
         
+        // True by default. When false, failures throw std::runtime_error to the
+        // caller instead of ending the process, with the reason errno gave
+        // when it happened, see RunOptions
+        bool exitOnFailure;
+        
         // Constructors
         BinaryWrite();
 		BinaryWrite(const char * filename);
@@ -37,9 +45,15 @@ class BinaryWrite : public fstream {
     
         void openFile(const char * file);
         void openFile(const string & file);
+        
+        // Flushes what is left, fails as writes do
+        void close();
 
         // Overloaded output/input ops. resp.
         template <class T> BinaryWrite & operator<<(T val);
+    
+        // Length prefixed raw dump of a whole buffer, read back with BinaryRead::readBuffer()
+        template <class T, class A> void writeBuffer(const vector<T, A> & buffer);
 };
 
 // We include code here because of templates definitions having to be visible at compile time
@@ -53,6 +67,9 @@ BinaryWrite & BinaryWrite::operator<<(T val) {
         write(reinterpret_cast<char*>(&val), sizeof(T));
     
     } catch (fstream::failure e) {
+        
+        if(!exitOnFailure)
+            throw std::runtime_error(string(strerror(errno)) + ", file = " + filename);
     
     	cerr << "Unable to write to: error = " << strerror(errno) << ", file = " << filename << endl;
         cerr.flush();
@@ -61,4 +78,26 @@ BinaryWrite & BinaryWrite::operator<<(T val) {
     
     return *this;
 }
+
+template <class T, class A>
+void BinaryWrite::writeBuffer(const vector<T, A> & buffer) {
+    
+    unsigned long long length = buffer.size();
+    *this << length;
+    
+    try {
+        
+        if(length > 0)
+            write(reinterpret_cast<const char*>(&buffer[0]), length * sizeof(T));
+        
+    } catch (fstream::failure e) {
+        
+        if(!exitOnFailure)
+            throw std::runtime_error(string(strerror(errno)) + ", file = " + filename);
+        
+    	cerr << "Unable to write to: error = " << strerror(errno) << ", file = " << filename << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+}
 #endif // BINARYWRITE_H
@@ -0,0 +1,844 @@
+/*
+ *  Ensemble.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Ensemble.h"
+#include "Network.h"
+#include "HiddenRegion.h"
+#include "HiddenNeuron.h"
+#include "InputRegion.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include "Utilities.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::stringstream;
+using std::nth_element;
+using std::greater;
+
+// Index of neuron in its region, same order as the Neurons[d][i][j] iteration
+static unsigned int neuronIndex(const Neuron * n) {
+    return (n->depth * n->region->verDimension + n->row) * n->region->horDimension + n->col;
+}
+
+void EnsembleRegion::init(const vector<HiddenRegion *> & replicas, const vector<float> & weightVectorLengths, unsigned long int timeStepsPerEpoch) {
+
+    HiddenRegion & first = *replicas.front();
+
+    this->R = replicas.size();
+    this->depth = first.depth;
+    this->verDimension = first.verDimension;
+    this->horDimension = first.horDimension;
+    this->nrOfNeurons = depth * verDimension * horDimension;
+    this->preSynapticRegionNr = first.regionNr - 1;
+
+    this->stepSize = first.stepSize;
+    this->learns = first.learningRate != 0;
+    this->rule = first.rule;
+    this->sparsenessRoutine = first.sparsenessRoutine;
+    this->weightNormalization = first.weightNormalization;
+    this->lateralInteraction = first.lateralInteraction;
+    this->filterWidth = first.filterWidth;
+    this->filterCenter = first.filterCenter;
+    this->timeStep = 0;
+
+    // Connectivity, Ensemble::canRun() has checked that all replicas have the same
+    firstSynapse.push_back(0);
+
+    for(int d = 0;d < depth;d++)
+        for(int i = 0;i < verDimension;i++)
+            for(int j = 0;j < horDimension;j++) {
+
+                const vector<Synapse> & synapses = first.Neurons[d][i][j].afferentSynapses;
+
+                for(unsigned s = 0;s < synapses.size();s++)
+                    preSynapticNeuron.push_back(neuronIndex(synapses[s].preSynapticNeuron));
+
+                firstSynapse.push_back(preSynapticNeuron.size());
+            }
+
+    weight.resize(preSynapticNeuron.size() * R);
+
+    activation.resize(nrOfNeurons * R);
+    newActivation.resize(nrOfNeurons * R);
+    inhibitedActivation.resize(nrOfNeurons * R);
+    newInhibitedActivation.resize(nrOfNeurons * R);
+    firingRate.resize(nrOfNeurons * R);
+    newFiringRate.resize(nrOfNeurons * R);
+    trace.resize(nrOfNeurons * R);
+    newTrace.resize(nrOfNeurons * R);
+    stimulation.resize(nrOfNeurons * R);
+
+    // Interleave replicas, weights are first touched in the partition of computeNewActivation()
+    #pragma omp parallel
+    {
+        bindThread();
+
+        #pragma omp for
+        for(unsigned int n = 0;n < nrOfNeurons;n++)
+            for(u_short r = 0;r < R;r++) {
+
+                HiddenNeuron & neuron = replicas[r]->Neurons[n / (verDimension * horDimension)][(n / horDimension) % verDimension][n % horDimension];
+
+                for(unsigned int s = firstSynapse[n];s < firstSynapse[n+1];s++)
+                    weight[s * R + r] = neuron.afferentSynapses[s - firstSynapse[n]].weight;
+
+                activation[n * R + r] = neuron.activation;
+                newActivation[n * R + r] = neuron.newActivation;
+                inhibitedActivation[n * R + r] = neuron.inhibitedActivation;
+                newInhibitedActivation[n * R + r] = neuron.newInhibitedActivation;
+                firingRate[n * R + r] = neuron.firingRate;
+                newFiringRate[n * R + r] = neuron.newFiringRate;
+                trace[n * R + r] = neuron.trace;
+                newTrace[n * R + r] = neuron.newTrace;
+                stimulation[n * R + r] = neuron.stimulation;
+            }
+    }
+
+    for(u_short r = 0;r < R;r++) {
+
+        HiddenRegion & region = *replicas[r];
+
+        learningRate.push_back(region.learningRate);
+        timeConstant.push_back(region.timeConstant);
+        sigmoidSlope.push_back(region.sigmoidSlope);
+        sigmoidThreshold.push_back(region.sigmoidThreshold);
+        traceTimeConstant.push_back(region.traceTimeConstant);
+        globalInhibitoryConstant.push_back(region.globalInhibitoryConstant);
+        covarianceThreshold.push_back(region.covarianceThreshold);
+        weightVectorLength.push_back(weightVectorLengths[r]);
+        percentileSize.push_back(region.percentileSize);
+        threshold.push_back(region.threshold);
+    }
+
+    if(lateralInteraction != NONE) {
+
+        filter.resize(filterWidth * filterWidth * R);
+
+        for(u_short r = 0;r < R;r++)
+            for(int f_i = 0;f_i < filterWidth;f_i++)
+                for(int f_j = 0;f_j < filterWidth;f_j++)
+                    filter[(f_i * filterWidth + f_j) * R + r] = (lateralInteraction == SHORT_INHIBITION_LONG_EXCITATION ? replicas[r]->inhibitoryFilter[f_i][f_j] : replicas[r]->somFilter[f_i][f_j]);
+    }
+
+    // Delayed trace is read at (timeStep - delay), and timeStep never
+    // exceeds the length of an epoch
+    this->traceLogLength = 0;
+    this->traceLogCapacity = (learns && rule == TRACE_RULE) ? timeStepsPerEpoch : 0;
+    traceLog.resize(traceLogCapacity * nrOfNeurons * R);
+}
+
+void EnsembleRegion::computeNewFiringRate(const float * preSynapticFiringRate, bool isShared) {
+
+    if(sparsenessRoutine == HEAP) {
+
+        computeNewActivation(preSynapticFiringRate, isShared);
+
+        if(lateralInteraction != NONE)
+            filterActivation();
+
+        // One replica per thread
+        #pragma omp for
+        for(int r = 0;r < R;r++) {
+
+            vector<float> buffer(nrOfNeurons);
+            threshold[r] = findThreshold(r, &buffer[0]);
+        }
+
+        #pragma omp for nowait
+        for(unsigned int n = 0;n < nrOfNeurons;n++)
+            for(u_short r = 0;r < R;r++) {
+
+                unsigned int k = n * R + r;
+                float slope = sigmoidSlope[r], t = threshold[r], sigmoidT = sigmoidThreshold[r];
+
+                newFiringRate[k] = (1/(1+exp(-2*slope*(newInhibitedActivation[k] - t - sigmoidT))));
+            }
+
+    } else if(sparsenessRoutine == GLOBAL) {
+
+        // Only first sheet, as in HiddenRegion
+        unsigned int sheetSize = verDimension * horDimension;
+
+        vector<float> cumulativeFiringRate(R, 0);
+
+        for(unsigned int n = 0;n < sheetSize;n++)
+            for(u_short r = 0;r < R;r++)
+                cumulativeFiringRate[r] += firingRate[n * R + r];
+
+        #pragma omp for nowait
+        for(unsigned int n = 0;n < sheetSize;n++) {
+
+            float * stim = &stimulation[n * R];
+
+            for(u_short r = 0;r < R;r++)
+                stim[r] = 0;
+
+            for(unsigned int s = firstSynapse[n];s < firstSynapse[n+1];s++) {
+
+                const float * w = &weight[s * R];
+
+                if(isShared) {
+
+                    float rate = preSynapticFiringRate[preSynapticNeuron[s]];
+
+                    #pragma omp simd
+                    for(int r = 0;r < R;r++)
+                        stim[r] += w[r] * rate;
+
+                } else {
+
+                    const float * rate = &preSynapticFiringRate[preSynapticNeuron[s] * R];
+
+                    #pragma omp simd
+                    for(int r = 0;r < R;r++)
+                        stim[r] += w[r] * rate[r];
+                }
+            }
+
+            for(u_short r = 0;r < R;r++) {
+
+                unsigned int k = n * R + r;
+                float slope = sigmoidSlope[r], sigmoidT = sigmoidThreshold[r];
+
+                newInhibitedActivation[k] = globalInhibitoryConstant[r] * cumulativeFiringRate[r];
+                newActivation[k] = activation[k] + (stepSize/timeConstant[r]) * (-activation[k] + stim[r] - newInhibitedActivation[k]);
+                newFiringRate[k] = 1/(1+exp(-2*slope*(newActivation[k] - sigmoidT)));
+            }
+        }
+    }
+}
+
+void EnsembleRegion::computeNewActivation(const float * preSynapticFiringRate, bool isShared) {
+
+    #pragma omp for
+    for(unsigned int n = 0;n < nrOfNeurons;n++) {
+
+        float * stim = &stimulation[n * R];
+
+        for(u_short r = 0;r < R;r++)
+            stim[r] = 0;
+
+        for(unsigned int s = firstSynapse[n];s < firstSynapse[n+1];s++) {
+
+            const float * w = &weight[s * R];
+
+            if(isShared) {
+
+                float rate = preSynapticFiringRate[preSynapticNeuron[s]];
+
+                #pragma omp simd
+                for(int r = 0;r < R;r++)
+                    stim[r] += w[r] * rate;
+
+            } else {
+
+                const float * rate = &preSynapticFiringRate[preSynapticNeuron[s] * R];
+
+                #pragma omp simd
+                for(int r = 0;r < R;r++)
+                    stim[r] += w[r] * rate[r];
+            }
+        }
+
+        float stimulationFactor = 2000; // as in HiddenRegion
+
+        #pragma omp simd
+        for(int r = 0;r < R;r++) {
+
+            unsigned int k = n * R + r;
+
+            newActivation[k] = activation[k] + (stepSize/timeConstant[r]) * (-activation[k] + stimulationFactor * stim[r]);
+            newInhibitedActivation[k] = newActivation[k];
+        }
+    }
+}
+
+void EnsembleRegion::filterActivation() {
+
+    #pragma omp for
+    for(int i = 0;i < verDimension;i++)
+        for(int j = 0;j < horDimension;j++) {
+
+            float * convolutionResult = &newInhibitedActivation[(i * horDimension + j) * R];
+
+            for(u_short r = 0;r < R;r++)
+                convolutionResult[r] = 0;
+
+            for(int f_i = 0; f_i < filterWidth;f_i++)
+                for(int f_j = 0; f_j < filterWidth;f_j++) {
+
+                    int n_i = wrap(i + f_i - filterCenter, verDimension);
+                    int n_j = wrap(j + f_j - filterCenter, horDimension);
+
+                    const float * a = &newActivation[(n_i * horDimension + n_j) * R];
+                    const float * f = &filter[(f_i * filterWidth + f_j) * R];
+
+                    #pragma omp simd
+                    for(int r = 0;r < R;r++)
+                        convolutionResult[r] += a[r] * f[r];
+                }
+        }
+}
+
+// Same value as the min heap in HiddenRegion::findThreshold()
+float EnsembleRegion::findThreshold(u_short r, float * buffer) {
+
+    for(unsigned int n = 0;n < nrOfNeurons;n++)
+        buffer[n] = newInhibitedActivation[n * R + r];
+
+    nth_element(buffer, buffer + percentileSize[r] - 1, buffer + nrOfNeurons, greater<float>());
+
+    return buffer[percentileSize[r] - 1];
+}
+
+void EnsembleRegion::applyLearningRule(const float * preSynapticFiringRate, bool isShared) {
+
+    if(!learns)
+        return;
+
+    // Trace rule reads trace history at (timeStep - 15), see HiddenRegion
+    const float * delayedTrace = NULL;
+    int delayedTimeStep = timeStep - 15;
+
+    if(rule == TRACE_RULE && delayedTimeStep >= 0) {
+
+        if(static_cast<unsigned long int>(delayedTimeStep) >= traceLogLength) {
+
+            cerr << "Delayed trace is outside of trace history: " << delayedTimeStep << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+
+        delayedTrace = &traceLog[delayedTimeStep * nrOfNeurons * R];
+    }
+
+    vector<float> norm(R);
+    vector<float> zero(R, 0);
+    float deltaW = 0;
+
+    #pragma omp for nowait
+    for(unsigned int n = 0;n < nrOfNeurons;n++) {
+
+        const float * fr = &firingRate[n * R];
+        const float * tr = &trace[n * R];
+        const float * dtr = (delayedTrace != NULL) ? &delayedTrace[n * R] : &zero[0];
+
+        for(u_short r = 0;r < R;r++)
+            norm[r] = 0;
+
+        for(unsigned int s = firstSynapse[n];s < firstSynapse[n+1];s++) {
+
+            float * w = &weight[s * R];
+
+            // Broadcast or per replica presynaptic rate
+            const float * rate = isShared ? &preSynapticFiringRate[preSynapticNeuron[s]] : &preSynapticFiringRate[preSynapticNeuron[s] * R];
+            unsigned int rateStride = isShared ? 0 : 1;
+
+            switch (rule) {
+
+                case HEBB_RULE:
+
+                    #pragma omp simd
+                    for(int r = 0;r < R;r++) {
+
+                        float oldWeight = w[r];
+                        norm[r] += oldWeight * oldWeight;
+                        w[r] += stepSize * (learningRate[r] * fr[r] * rate[r * rateStride]);
+                    }
+
+                    break;
+
+                case TRACE_RULE:
+
+                    #pragma omp simd
+                    for(int r = 0;r < R;r++) {
+
+                        float oldWeight = w[r];
+                        norm[r] += oldWeight * oldWeight;
+                        w[r] += stepSize * (learningRate[r] * dtr[r] * rate[r * rateStride]);
+                    }
+
+                    for(u_short r = 0;r < R;r++) {
+
+                        if (w[r] < 0) { cout << "No... Bad, bad NEGATIVE SYNAPTIC: " << w[r] << endl; exit(EXIT_FAILURE); }
+
+                        ((w[r] + deltaW) < 0) ? w[r] = 0 : w[r] += deltaW;
+                    }
+
+                    break;
+
+                case COVARIANCE_PRESYNAPTIC_TRACE_RULE:
+
+                    #pragma omp simd
+                    for(int r = 0;r < R;r++) {
+
+                        float oldWeight = w[r];
+                        norm[r] += oldWeight * oldWeight;
+
+                        if(rate[r * rateStride] > covarianceThreshold[r])
+                            w[r] += stepSize * (learningRate[r] * tr[r]);
+                    }
+
+                    break;
+            }
+        }
+
+        // Update trace
+        for(u_short r = 0;r < R;r++) {
+
+            unsigned int k = n * R + r;
+
+            newTrace[k] = trace[k] + (stepSize/traceTimeConstant[r])*(-trace[k] + firingRate[k]);
+            trace[k] = newTrace[k];
+        }
+
+        if(traceLogLength < traceLogCapacity)
+            for(u_short r = 0;r < R;r++)
+                traceLog[traceLogLength * nrOfNeurons * R + n * R + r] = trace[n * R + r];
+
+        // Normalization
+        if(weightNormalization == CLASSIC) {
+
+            for(u_short r = 0;r < R;r++)
+                norm[r] = weightVectorLength[r]/static_cast<float>(sqrt(norm[r]));
+
+            for(unsigned int s = firstSynapse[n];s < firstSynapse[n+1];s++) {
+
+                float * w = &weight[s * R];
+
+                #pragma omp simd
+                for(int r = 0;r < R;r++)
+                    w[r] *= norm[r];
+            }
+        }
+    }
+}
+
+void EnsembleRegion::doTimeStep() {
+
+    #pragma omp for
+    for(unsigned int k = 0;k < nrOfNeurons * R;k++) {
+
+        activation[k] = newActivation[k];
+        newActivation[k] = FLT_MIN;
+
+        inhibitedActivation[k] = newInhibitedActivation[k];
+        newInhibitedActivation[k] = FLT_MIN;
+
+        firingRate[k] = newFiringRate[k];
+        newFiringRate[k] = FLT_MIN;
+
+        trace[k] = newTrace[k];
+    }
+
+    #pragma omp single
+    {
+        timeStep++;
+
+        if(traceLogLength < traceLogCapacity)
+            traceLogLength++;
+    }
+}
+
+void EnsembleRegion::clearState(bool resetTrace) {
+
+    #pragma omp for
+    for(unsigned int k = 0;k < nrOfNeurons * R;k++) {
+
+        firingRate[k] = 0;
+        newFiringRate[k] = 0;
+        activation[k] = 0;
+        newActivation[k] = 0;
+        inhibitedActivation[k] = 0;
+        newInhibitedActivation[k] = 0;
+        stimulation[k] = 0;
+
+        if(resetTrace) {
+            trace[k] = 0;
+            newTrace[k] = 0;
+        }
+    }
+
+    #pragma omp single
+    timeStep = 0;
+}
+
+void EnsembleRegion::resetTrace() {
+
+    #pragma omp for
+    for(unsigned int k = 0;k < nrOfNeurons * R;k++) {
+        trace[k] = 0;
+        newTrace[k] = 0;
+    }
+}
+
+void EnsembleRegion::scatterWeights(HiddenRegion & region, u_short r) {
+
+    #pragma omp for
+    for(unsigned int n = 0;n < nrOfNeurons;n++) {
+
+        HiddenNeuron & neuron = region.Neurons[n / (verDimension * horDimension)][(n / horDimension) % verDimension][n % horDimension];
+
+        for(unsigned int s = firstSynapse[n];s < firstSynapse[n+1];s++)
+            neuron.afferentSynapses[s - firstSynapse[n]].weight = weight[s * R + r];
+    }
+}
+
+void EnsembleRegion::scatterState(HiddenRegion & region, u_short r) {
+
+    #pragma omp for
+    for(unsigned int n = 0;n < nrOfNeurons;n++) {
+
+        HiddenNeuron & neuron = region.Neurons[n / (verDimension * horDimension)][(n / horDimension) % verDimension][n % horDimension];
+        unsigned int k = n * R + r;
+
+        neuron.activation = activation[k];
+        neuron.inhibitedActivation = inhibitedActivation[k];
+        neuron.firingRate = firingRate[k];
+        neuron.trace = trace[k];
+        neuron.stimulation = stimulation[k];
+
+        // Synapse history is saved from the weights
+        if(neuron.saveSynapseHistory)
+            for(unsigned int s = firstSynapse[n];s < firstSynapse[n+1];s++)
+                neuron.afferentSynapses[s - firstSynapse[n]].weight = weight[s * R + r];
+    }
+
+    // Threshold is only computed by this routine
+    if(sparsenessRoutine == HEAP)
+        region.threshold = threshold[r];
+}
+
+bool Ensemble::canRun(const vector<Network *> & networks) {
+
+    const Network & first = *networks.front();
+    const Param & p = first.p;
+
+    for(unsigned r = 1;r < networks.size();r++) {
+
+        const Network & n = *networks[r];
+        const Param & q = n.p;
+
+        stringstream reason;
+
+        if(q.dimensions != p.dimensions || q.depths != p.depths || q.filterWidth != p.filterWidth || q.saveHistory != p.saveHistory)
+            reason << "architecture or saved history differs";
+        else if(q.stepSize != p.stepSize || q.nrOfEpochs != p.nrOfEpochs || q.outputAtTimeStepMultiple != p.outputAtTimeStepMultiple)
+            reason << "time step schedule differs";
+        else if(q.resetActivity != p.resetActivity || q.resetTrace != p.resetTrace || q.saveNetwork != p.saveNetwork || q.saveNetworkAtEpochMultiple != p.saveNetworkAtEpochMultiple)
+            reason << "reset or save settings differ";
+        else if(q.rule != p.rule || q.sparsenessRoutine != p.sparsenessRoutine || q.weightNormalization != p.weightNormalization || q.lateralInteraction != p.lateralInteraction)
+            reason << "learning rule or competition differs";
+        else if(n.area7a.depth != first.area7a.depth || n.area7a.horVisualDimension != first.area7a.horVisualDimension || n.area7a.horEyeDimension != first.area7a.horEyeDimension || n.area7a.timeStepsInObject != first.area7a.timeStepsInObject)
+            reason << "input differs";
+
+        for(unsigned k = 0;k < n.ESPathway.size() && reason.str().empty();k++) {
+
+            const HiddenRegion & a = first.ESPathway[k];
+            const HiddenRegion & b = n.ESPathway[k];
+
+            if((a.learningRate == 0) != (b.learningRate == 0)) {
+                reason << "region #" << k+1 << " only learns in some runs";
+                break;
+            }
+
+            for(int d = 0;d < a.depth && reason.str().empty();d++)
+                for(int i = 0;i < a.verDimension && reason.str().empty();i++)
+                    for(int j = 0;j < a.horDimension && reason.str().empty();j++) {
+
+                        const vector<Synapse> & sa = a.Neurons[d][i][j].afferentSynapses;
+                        const vector<Synapse> & sb = b.Neurons[d][i][j].afferentSynapses;
+
+                        if(sa.size() != sb.size())
+                            reason << "connectivity of region #" << k+1 << " differs";
+
+                        for(unsigned s = 0;s < sa.size() && reason.str().empty();s++)
+                            if(sa[s].preSynapticNeuron->region->regionNr != sb[s].preSynapticNeuron->region->regionNr ||
+                               neuronIndex(sa[s].preSynapticNeuron) != neuronIndex(sb[s].preSynapticNeuron))
+                                reason << "connectivity of region #" << k+1 << " differs";
+                    }
+        }
+
+        if(reason.str().empty() && q.convergenceTolerance > 0)
+            reason << "convergenceTolerance would stop runs at different epochs";
+
+        if(reason.str().empty() && (p.layerwise || q.layerwise))
+            reason << "layer-wise training is not supported in lock step";
+
+        if(reason.str().empty() && q.pushEpsilon >= 0)
+            reason << "push propagation is not supported in lock step";
+
+        if(reason.str().empty() && q.plasticityThreshold >= 0)
+            reason << "gated learning is not supported in lock step";
+
+        if(reason.str().empty() && q.trainAtTimeStepMultiple > 1)
+            reason << "learning every trainAtTimeStepMultiple steps is not supported in lock step";
+
+        if(reason.str().empty() && (q.integrator != EULER || q.multiRate))
+            reason << "exponential or multi-rate integration is not supported in lock step";
+
+        if(reason.str().empty() && (q.pruneThreshold > 0 || q.pruneKeep > 0))
+            reason << "pruning would give runs different connectivity";
+
+        if(!reason.str().empty()) {
+            cout << "Runs #1 and #" << r+1 << " cannot train as an ensemble: " << reason.str() << "." << endl;
+            return false;
+        }
+    }
+
+    if(p.convergenceTolerance > 0) {
+        cout << "Runs cannot train as an ensemble: convergenceTolerance would stop runs at different epochs." << endl;
+        return false;
+    }
+
+    if(p.layerwise) {
+        cout << "Runs cannot train as an ensemble: layer-wise training is not supported in lock step." << endl;
+        return false;
+    }
+
+    if(p.pushEpsilon >= 0) {
+        cout << "Runs cannot train as an ensemble: push propagation is not supported in lock step." << endl;
+        return false;
+    }
+
+    if(p.plasticityThreshold >= 0) {
+        cout << "Runs cannot train as an ensemble: gated learning is not supported in lock step." << endl;
+        return false;
+    }
+
+    if(p.trainAtTimeStepMultiple > 1) {
+        cout << "Runs cannot train as an ensemble: learning every trainAtTimeStepMultiple steps is not supported in lock step." << endl;
+        return false;
+    }
+
+    if(p.weightNormalization == SCALED) {
+        cout << "Runs cannot train as an ensemble: SCALED weight normalization is not supported in lock step." << endl;
+        return false;
+    }
+
+    if(p.integrator != EULER || p.multiRate) {
+        cout << "Runs cannot train as an ensemble: exponential or multi-rate integration is not supported in lock step." << endl;
+        return false;
+    }
+
+    if(p.pruneThreshold > 0 || p.pruneKeep > 0) {
+        cout << "Runs cannot train as an ensemble: pruning would give runs different connectivity." << endl;
+        return false;
+    }
+
+    // Every region must be fed only by the region below it
+    for(unsigned k = 0;k < first.ESPathway.size();k++) {
+
+        const HiddenRegion & a = first.ESPathway[k];
+
+        for(int d = 0;d < a.depth;d++)
+            for(int i = 0;i < a.verDimension;i++)
+                for(int j = 0;j < a.horDimension;j++) {
+
+                    const vector<Synapse> & sa = a.Neurons[d][i][j].afferentSynapses;
+
+                    for(unsigned s = 0;s < sa.size();s++)
+                        if(sa[s].preSynapticNeuron->region->regionNr != k) {
+                            cout << "Runs cannot train as an ensemble: region #" << k+1 << " has afferents from other regions than #" << k << "." << endl;
+                            return false;
+                        }
+                }
+    }
+
+    return true;
+}
+
+Ensemble::Ensemble(const vector<Network *> & networks) :
+replicas(networks),
+R(networks.size()),
+regions(networks.front()->ESPathway.size()) {
+
+    const InputRegion & input = replicas.front()->area7a;
+
+    // Input stored once when it is identical
+    sharedInput = true;
+
+    for(u_short r = 1;r < R;r++)
+        sharedInput = sharedInput && replicas[r]->area7a.respondsAs(input);
+
+    inputFiringRate.resize(input.depth * input.horVisualDimension * input.horEyeDimension * (sharedInput ? 1 : R));
+
+    for(unsigned k = 0;k < regions.size();k++) {
+
+        vector<HiddenRegion *> region;
+        vector<float> weightVectorLengths;
+
+        for(u_short r = 0;r < R;r++) {
+            region.push_back(&replicas[r]->ESPathway[k]);
+            weightVectorLengths.push_back(replicas[r]->p.weightVectorLength);
+        }
+
+        regions[k].init(region, weightVectorLengths, input.timeStepsPerEpoch);
+    }
+
+    cout << "Ensemble of " << R << " replicas, " << (sharedInput ? "input shared" : "input per replica") << "." << endl;
+}
+
+void Ensemble::setInputFiringRate(u_short object, unsigned long int timeStep) {
+
+    if(sharedInput) {
+
+        InputRegion & input = replicas.front()->area7a;
+
+        input.setFiringRate(object, timeStep);
+
+        #pragma omp for
+        for(int d = 0;d < input.depth;d++)
+            for(int i = 0;i < input.horVisualDimension;i++)
+                for(int j = 0;j < input.horEyeDimension;j++)
+                    inputFiringRate[(d * input.horVisualDimension + i) * input.horEyeDimension + j] = input.Neurons[d][i][j].firingRate;
+
+    } else {
+
+        for(u_short r = 0;r < R;r++)
+            replicas[r]->area7a.setFiringRate(object, timeStep);
+
+        InputRegion & input = replicas.front()->area7a;
+
+        #pragma omp for
+        for(int d = 0;d < input.depth;d++)
+            for(int i = 0;i < input.horVisualDimension;i++)
+                for(int j = 0;j < input.horEyeDimension;j++) {
+
+                    unsigned int n = (d * input.horVisualDimension + i) * input.horEyeDimension + j;
+
+                    for(u_short r = 0;r < R;r++)
+                        inputFiringRate[n * R + r] = replicas[r]->area7a.Neurons[d][i][j].firingRate;
+                }
+    }
+}
+
+void Ensemble::saveHistory() {
+
+    for(unsigned k = 0;k < regions.size();k++)
+        for(u_short r = 0;r < R;r++) {
+
+            regions[k].scatterState(replicas[r]->ESPathway[k], r);
+            replicas[r]->ESPathway[k].saveState();
+        }
+}
+
+void Ensemble::scatterWeights() {
+
+    for(unsigned k = 0;k < regions.size();k++)
+        for(u_short r = 0;r < R;r++)
+            regions[k].scatterWeights(replicas[r]->ESPathway[k], r);
+}
+
+void Ensemble::run(const vector<string> & outputDirectories) {
+
+    // Schedule is the same for all replicas
+    const Param & p = replicas.front()->p;
+    const InputRegion & input = replicas.front()->area7a;
+
+    for(u_short r = 0;r < R;r++) {
+
+        replicas[r]->epochsCompleted = 0;
+
+        for(unsigned k = 0;k < regions.size();k++)
+            replicas[r]->ESPathway[k].takeWeightSnapshot();
+    }
+
+#pragma omp parallel
+    {
+        bindThread();
+
+        for(u_short e = 0;e < p.nrOfEpochs;e++) {
+
+            for(unsigned k = 0;k < regions.size();k++)
+                regions[k].clearState(true);
+
+#pragma omp single
+            {
+                cout << ">> epoch #" << e << endl;
+            }
+
+            for(u_short o = 0;o < input.nrOfObjects;o++) {
+
+                for(unsigned long int t = 0;t < input.timeStepsInObject[o];t++) {
+
+                    setInputFiringRate(o, t);
+
+                    for(unsigned k = 0;k < regions.size();k++)
+                        regions[k].computeNewFiringRate(k == 0 ? &inputFiringRate[0] : &regions[k-1].firingRate[0], k == 0 && sharedInput);
+
+#pragma omp barrier
+
+                    for(unsigned k = 0;k < regions.size();k++)
+                        regions[k].applyLearningRule(k == 0 ? &inputFiringRate[0] : &regions[k-1].firingRate[0], k == 0 && sharedInput);
+
+#pragma omp barrier
+
+                    for(unsigned k = 0;k < regions.size();k++)
+                        regions[k].doTimeStep();
+
+                    if(((t+1) % p.outputAtTimeStepMultiple) == 0)
+                        saveHistory();
+                }
+
+#pragma omp single
+                {
+                    cout << ">Completed Periode nr." << o+1 << endl;
+                }
+
+                if(p.resetActivity) {
+
+                    for(unsigned k = 0;k < regions.size();k++)
+                        regions[k].clearState(p.resetTrace);
+
+                } else if(p.resetTrace) {
+
+                    for(unsigned k = 0;k < regions.size();k++)
+                        regions[k].resetTrace();
+                }
+            }
+
+            scatterWeights();
+
+            // Save network after EPOCHS, and weight convergence, one replica per thread
+            #pragma omp for
+            for(int r = 0;r < R;r++) {
+
+                if(p.saveNetwork && (e+1) % p.saveNetworkAtEpochMultiple == 0) {
+
+                    stringstream ss;
+                    ss << outputDirectories[r] << "TrainedNetwork_e" << e+1 << ".txt";
+                    string name = ss.str();
+                    replicas[r]->outputFinalNetwork(name.c_str());
+                }
+
+                stringstream rms;
+                rms << "Run #" << r+1 << ", RMS weight change in epoch #" << e << ":";
+
+                for(unsigned k = 0;k < regions.size();k++)
+                    rms << " region #" << k+1 << " = " << replicas[r]->ESPathway[k].computeWeightChange();
+
+                replicas[r]->epochsCompleted = e+1;
+
+#pragma omp critical(ensembleOutput)
+                cout << rms.str() << endl;
+            }
+        }
+    }
+
+    cout << "Saving history..." << endl;
+
+    for(u_short r = 0;r < R;r++)
+        replicas[r]->outputHistory(outputDirectories[r].c_str(), true);
+}
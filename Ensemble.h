@@ -0,0 +1,146 @@
+/*
+ *  Ensemble.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+// Forward declarations
+class Network;
+class HiddenRegion;
+
+// Includes
+#include "Param.h"
+#include "RegionMemory.h"
+#include <vector>
+#include <string>
+#include "Utilities.h"
+
+using std::vector;
+using std::string;
+
+// One hidden region of all replicas. Connectivity is stored once, all
+// replica values are interleaved, value[neuron * R + r] and weight[synapse * R + r],
+// so the innermost loops run over replicas and vectorize. Mirrors
+// HiddenRegion operation for operation, so each replica trains exactly as
+// it would on its own.
+class EnsembleRegion {
+
+    public:
+
+        u_short R;
+        u_short depth, verDimension, horDimension;
+        unsigned int nrOfNeurons;
+        u_short preSynapticRegionNr;
+
+        // Afferent synapses of neuron n are [firstSynapse[n], firstSynapse[n+1])
+        vector<unsigned int> firstSynapse;
+        vector<unsigned int> preSynapticNeuron;   // index in presynaptic region
+        RegionBuffer weight;
+
+        // Neuron state
+        vector<float> activation, newActivation;
+        vector<float> inhibitedActivation, newInhibitedActivation;
+        vector<float> firingRate, newFiringRate;
+        vector<float> trace, newTrace;
+        vector<float> stimulation;
+        int timeStep;
+
+        // Trace history for delayed trace rule, traceLog[k * nrOfNeurons * R + n * R + r],
+        // only the first time steps are kept, as those are the only ones ever read
+        vector<float> traceLog;
+        unsigned long int traceLogLength;
+        unsigned long int traceLogCapacity;
+
+        // Replica parameters
+        vector<float> learningRate;
+        vector<float> timeConstant;
+        vector<float> sigmoidSlope;
+        vector<float> sigmoidThreshold;
+        vector<float> traceTimeConstant;
+        vector<float> globalInhibitoryConstant;
+        vector<float> covarianceThreshold;
+        vector<float> weightVectorLength;
+        vector<u_short> percentileSize;
+        vector<float> threshold;
+        vector<float> filter; // filter[(f_i * filterWidth + f_j) * R + r]
+
+        // Shared parameters
+        double stepSize;
+        bool learns;
+        LEARNING_RULE rule;
+        SPARSENESSROUTINE sparsenessRoutine;
+        WEIGHTNORMALIZATION weightNormalization;
+        LATERAL lateralInteraction;
+        u_short filterWidth;
+        u_short filterCenter;
+
+        void init(const vector<HiddenRegion *> & replicas, const vector<float> & weightVectorLengths, unsigned long int timeStepsPerEpoch);
+
+        // Same as HiddenRegion, presynaptic firing rates are either [neuron * R + r],
+        // or [neuron] when all replicas have the same presynaptic firing rates
+        void computeNewFiringRate(const float * preSynapticFiringRate, bool isShared);
+        void applyLearningRule(const float * preSynapticFiringRate, bool isShared);
+        void doTimeStep();
+        void clearState(bool resetTrace);
+        void resetTrace();
+
+        // Copy replica values back for output
+        void scatterWeights(HiddenRegion & region, u_short r);
+        void scatterState(HiddenRegion & region, u_short r);
+
+    private:
+
+        void computeNewActivation(const float * preSynapticFiringRate, bool isShared);
+        void filterActivation();
+        float findThreshold(u_short r, float * buffer);
+        u_short wrap(int x, u_short d);
+};
+
+// Trains replicas of one architecture in lock step, used by sweep when
+// ensemble = true; is given. Replicas may differ in seed and in the
+// region parameters kept per replica above, not in anything that changes
+// connectivity or the time step schedule.
+class Ensemble {
+
+    private:
+
+        vector<Network *> replicas;
+        u_short R;
+        vector<EnsembleRegion> regions;
+
+        // Input firing rates, [neuron] when all replicas have identical
+        // input neurons, [neuron * R + r] otherwise
+        bool sharedInput;
+        vector<float> inputFiringRate;
+
+        void setInputFiringRate(u_short object, unsigned long int timeStep);
+        void saveHistory();
+        void scatterWeights();
+
+    public:
+
+        // Prints reason and returns false when replicas cannot be run in lock step
+        static bool canRun(const vector<Network *> & networks);
+
+        Ensemble(const vector<Network *> & networks);
+
+        // Replica r is written to outputDirectories[r]
+        void run(const vector<string> & outputDirectories);
+};
+
+inline u_short EnsembleRegion::wrap(int x, u_short d) {
+
+    // Same as HiddenRegion::wrap()
+	if(x > 0)
+		return x % d;
+	else if((-x) % d == 0)
+		return 0;
+	else
+		return d - ((-x) % d);
+}
+
+#endif // ENSEMBLE_H
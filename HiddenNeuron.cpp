@@ -13,6 +13,7 @@
 #include "InputRegion.h"
 #include "InputNeuron.h"
 #include "BinaryWrite.h"
+#include "BinaryRead.h"
 #include <iostream>
 #include <cstdlib>
 
@@ -34,6 +35,7 @@ void HiddenNeuron::init(HiddenRegion * region,
                         float * effectiveTraceHistory,
                         bool saveNeuronHistory, 
                         bool saveSynapseHistory, 
+                        bool halfWeightHistory,
                         u_short desiredFanIn,
                         float weightVectorLength,
                         int fixedBufferWeightHistorySize) {
@@ -48,8 +50,11 @@ void HiddenNeuron::init(HiddenRegion * region,
 	this->timeStep = 0;														// dnavarro2015 Implementing anti-Hebbian learning rule 10 (Rolls and Stringer, 2001) 
 	this->saveNeuronHistory = saveNeuronHistory;
 	this->saveSynapseHistory = saveSynapseHistory;
+    this->halfWeightHistory = halfWeightHistory;
     this->desiredFanIn = desiredFanIn;
     this->weightVectorLength = weightVectorLength;
+    this->weightScale = 1;
+    this->rawNormSquared = 0;
 
     
     // Setup buffer pointers
@@ -78,7 +83,8 @@ HiddenNeuron::~HiddenNeuron() {
 
 void HiddenNeuron::addAfferentSynapse(const Neuron * preSynapticNeuron, float weight) {
     
-    float * buffer;
+    float * buffer = NULL;
+    bfloat16 * halfBuffer = NULL;
     
     if (saveSynapseHistory) {
         
@@ -94,14 +100,17 @@ void HiddenNeuron::addAfferentSynapse(const Neuron * preSynapticNeuron, float we
         //    cout << ">> Allocating for synapse buffer for neuron (" << row << "," << col << ")" << endl;
         //}
     
-        buffer = (static_cast<HiddenRegion *>(region))->getSynapseHistorySlot();
-
+        if(halfWeightHistory)
+            halfBuffer = (static_cast<HiddenRegion *>(region))->getHalfSynapseHistorySlot();
+        else
+            buffer = (static_cast<HiddenRegion *>(region))->getSynapseHistorySlot();
     }
-    else
-        buffer = NULL;  
     
     // Add synapse to synapse lisr
     afferentSynapses.push_back(Synapse(weight, preSynapticNeuron, this, buffer));//, fixedBufferWeightHistorySize)); // historyLength
+    
+    if(halfWeightHistory)
+        afferentSynapses.back().halfWeightHistory = halfBuffer;
 }
 
 void HiddenNeuron::setupAfferentSynapses(Region & preSynapticRegion, CONNECTIVITY connectivity, INITIALWEIGHT initialWeight, gsl_rng * rngController) {
@@ -221,7 +230,7 @@ void HiddenNeuron::output(BinaryWrite & file, DATA data) {
     	for(std::vector<Synapse>::iterator s = afferentSynapses.begin(); s != afferentSynapses.end();s++) {
             
             const Neuron * n = (*s).preSynapticNeuron;
-            file << n->region->regionNr << n->depth << n->row << n->col << (*s).weight;
+            file << n->region->regionNr << n->depth << n->row << n->col << (*s).weight * weightScale;
         }
         
     } else if(data == WEIGHT_HISTORY) {
@@ -234,8 +243,7 @@ void HiddenNeuron::output(BinaryWrite & file, DATA data) {
         	file << n->region->regionNr << n->depth << n->row << n->col;
 
             // Output weight history for this synapse
-            for(unsigned long t = 0;t < synapseHistoryCounter;t++)
-                file << (*s).weightHistory[t];
+            outputWeightHistory(file, *s);
         }
 
     } else if(data == WEIGHT_AND_NEURON_HISTORY) {
@@ -262,12 +270,88 @@ void HiddenNeuron::output(BinaryWrite & file, DATA data) {
         for(std::vector<Synapse>::iterator s = afferentSynapses.begin(); s != afferentSynapses.end();s++)  {
             
             // Output weight history for this synapse
-            for(unsigned long t = 0;t < synapseHistoryCounter;t++)
-                file << (*s).weightHistory[t];
+            outputWeightHistory(file, *s);
         }
     }
 }
 
+void HiddenNeuron::outputState(BinaryWrite & file) {
+    
+    // State variables
+    file << firingRate << newFiringRate << oldFiringRate << myOldFiringRate;
+    file << activation << newActivation << inhibitedActivation << newInhibitedActivation;
+    file << trace << newTrace << effectiveTrace << stimulation << timeStep;
+    
+    // History counters, buffers themselves are saved by region
+    file << neuronHistoryCounter << synapseHistoryCounter;
+    
+    // Trace ring buffer
+    file << lastTraceBufferElement;
+    for(int i = 0;i < fixedBufferWeightHistorySize;i++)
+        file << fixedBufferTraceHistory[i];
+    
+    // Delayed trace/firing rate history
+    file.writeBuffer(myTraceHistory);
+    file.writeBuffer(myFiringRateHistory);
+    file.writeBuffer(mySquareDiffValue);
+    
+    // Afferent synapses, same layout as weight file
+    file << static_cast<u_short>(afferentSynapses.size());
+    
+    for(std::vector<Synapse>::iterator s = afferentSynapses.begin(); s != afferentSynapses.end();s++) {
+        
+        const Neuron * n = (*s).preSynapticNeuron;
+        file << n->region->regionNr << n->depth << n->row << n->col << (*s).weight << (*s).blockage;
+    }
+    
+    // Raw weights above are exact, so is the resumed scale
+    file << weightScale << rawNormSquared;
+}
+
+// regions[0] is 7a, regions[k] is ESPathway[k-1]
+void HiddenNeuron::loadState(BinaryRead & file, const vector<Region *> & regions) {
+    
+    file >> firingRate >> newFiringRate >> oldFiringRate >> myOldFiringRate;
+    file >> activation >> newActivation >> inhibitedActivation >> newInhibitedActivation;
+    file >> trace >> newTrace >> effectiveTrace >> stimulation >> timeStep;
+    
+    file >> neuronHistoryCounter >> synapseHistoryCounter;
+    
+    file >> lastTraceBufferElement;
+    for(int i = 0;i < fixedBufferWeightHistorySize;i++)
+        file >> fixedBufferTraceHistory[i];
+    
+    file.readBuffer(myTraceHistory, false);
+    file.readBuffer(myFiringRateHistory, false);
+    file.readBuffer(mySquareDiffValue, false);
+    
+    // Rebuild afferent synapses, region must have rewound its
+    // synapse history slots before this call
+    u_short fanIn;
+    file >> fanIn;
+    
+    afferentSynapses.clear();
+    
+    for(u_short m = 0;m < fanIn;m++) {
+        
+        u_short regionNr, depth, row, col;
+        float weight, blockage;
+        
+        file >> regionNr >> depth >> row >> col >> weight >> blockage;
+        
+        if(regionNr >= regions.size()) {
+            
+            cerr << "Checkpoint refers to non existing region: " << regionNr << endl;
+            exit(EXIT_FAILURE);
+        }
+        
+        addAfferentSynapse(regions[regionNr]->getNeuron(depth, row, col), weight);
+        afferentSynapses.back().blockage = blockage;
+    }
+    
+    file >> weightScale >> rawNormSquared;
+}
+
 void HiddenNeuron::output(BinaryWrite & file, const float * buffer) {
     
     for(unsigned long t = 0;t < neuronHistoryCounter;t++)
@@ -275,6 +359,16 @@ void HiddenNeuron::output(BinaryWrite & file, const float * buffer) {
     
 }
 
+void HiddenNeuron::outputWeightHistory(BinaryWrite & file, const Synapse & s) {
+    
+    if(halfWeightHistory)
+        for(unsigned long t = 0;t < synapseHistoryCounter;t++)
+            file << fromBfloat16(s.halfWeightHistory[t]);
+    else
+        for(unsigned long t = 0;t < synapseHistoryCounter;t++)
+            file << s.weightHistory[t];
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Trace buffer
 //////////////////////////////////////////////////////////////////////////
@@ -14,6 +14,7 @@ class Region;
 class HiddenRegion;
 class InputRegion;
 class BinaryWrite;
+class BinaryRead;
 
 // Includes
 #include "Neuron.h"
@@ -37,6 +38,7 @@ class HiddenNeuron: public Neuron {
         unsigned long neuronHistoryCounter;
         unsigned long synapseHistoryCounter;
 		bool saveNeuronHistory;
+        bool halfWeightHistory;     // Synapse::halfWeightHistory, p.weightPrecision == BF16
         
         // History buffers
         float * activationHistory;
@@ -47,6 +49,7 @@ class HiddenNeuron: public Neuron {
         float * effectiveTraceHistory;
     
         void output(BinaryWrite & file, const float * buffer);
+        void outputWeightHistory(BinaryWrite & file, const Synapse & s);  // as float, also when kept as bfloat16
     
         /////////////////////
         // Trace buffer
@@ -59,10 +62,16 @@ class HiddenNeuron: public Neuron {
     
         // temporarily moved
         bool saveSynapseHistory;
+        bool savesNeuronHistory() const { return saveNeuronHistory; }
         
         // Data structures
         vector<Synapse> afferentSynapses;
         
+        // SCALED normalization: a weight is weightScale times Synapse::weight,
+        // rawNormSquared is the sum of squared Synapse::weight
+        float weightScale;
+        double rawNormSquared;
+        
         // Neuron State
         float activation;             // Normal weighted sum of input firing rates
         float inhibitedActivation;    // Activation after being passed through inhibit routine
@@ -95,6 +104,7 @@ class HiddenNeuron: public Neuron {
                   float * const effectiveTraceHistory,
                   bool saveNeuronHistory, 
                   bool saveSynapseHistory,
+                  bool halfWeightHistory,
                   u_short desiredFanIn,
                   float weightVectorLength,
                   int fixedBufferWeightHistorySize);
@@ -103,12 +113,16 @@ class HiddenNeuron: public Neuron {
         ~HiddenNeuron();
         
         void doTimeStep(bool save);
-        void saveState();
+        void saveState(bool idle = false);  // idle: neuron was not simulated, its history gets NaN
         void clearState(bool resetTrace); // Does not clear history vectors, just state vars
 		
         // Output data
         unsigned long int getTotalNumberAfferentSynapses(); // dnavarro2016 convergence
         void output(BinaryWrite & file, DATA data);
+    
+        // Checkpointing, full dynamic state including afferent synapses
+        void outputState(BinaryWrite & file);
+        void loadState(BinaryRead & file, const vector<Region *> & regions);
         
 		// Setup network
         void setupAfferentSynapses(Region & preSynapticRegion, CONNECTIVITY connectivity, INITIALWEIGHT initialWeight, gsl_rng * rngController);    
@@ -119,6 +133,9 @@ class HiddenNeuron: public Neuron {
         bool areYouConnectedTo(const Neuron * n);
 		void normalize();
 		void normalize(float norm);
+        void rescale(double normSquared);
+        void setupWeightScale();    // rawNormSquared from Synapse::weight
+        void applyWeightScale();    // Synapse::weight becomes the weight, scale is 1 again
     
         
         float getDelayedTrace();
@@ -141,6 +158,7 @@ class HiddenNeuron: public Neuron {
 
 #include <cfloat>
 #include <cmath>
+#include <limits>
 
 //////////////////// DEBUG
 #include <math.h>
@@ -207,9 +225,21 @@ inline void HiddenNeuron::doTimeStep(bool save) {
 		saveState();
 }
 
-inline void HiddenNeuron::saveState() {
+inline void HiddenNeuron::saveState(bool idle) {
     
-    if(saveNeuronHistory) {
+    if(saveNeuronHistory && idle) {
+        
+        float notSimulated = std::numeric_limits<float>::quiet_NaN();
+        
+        activationHistory[neuronHistoryCounter] = notSimulated;
+        inhibitedActivationHistory[neuronHistoryCounter] = notSimulated;
+        firingRateHistory[neuronHistoryCounter] = notSimulated;
+        traceHistory[neuronHistoryCounter] = notSimulated;
+        stimulationHistory[neuronHistoryCounter] = notSimulated;
+        effectiveTraceHistory[neuronHistoryCounter] = notSimulated;
+        neuronHistoryCounter++;
+        
+    } else if(saveNeuronHistory) {
         
         activationHistory[neuronHistoryCounter] = activation;
         inhibitedActivationHistory[neuronHistoryCounter] = inhibitedActivation;
@@ -222,8 +252,12 @@ inline void HiddenNeuron::saveState() {
     
     if(saveSynapseHistory) {
         
-        for(u_short s = 0;s < afferentSynapses.size();s++)
-            afferentSynapses[s].weightHistory[synapseHistoryCounter] = afferentSynapses[s].weight;
+        if(halfWeightHistory)
+            for(u_short s = 0;s < afferentSynapses.size();s++)
+                afferentSynapses[s].halfWeightHistory[synapseHistoryCounter] = toBfloat16(afferentSynapses[s].weight * weightScale);
+        else
+            for(u_short s = 0;s < afferentSynapses.size();s++)
+                afferentSynapses[s].weightHistory[synapseHistoryCounter] = afferentSynapses[s].weight * weightScale;
         
         synapseHistoryCounter++;
     }
@@ -249,5 +283,34 @@ inline void HiddenNeuron::normalize(float norm) {
 		afferentSynapses[s].weight *= weightVectorLength/norm;
 }
 
+// SCALED counterpart of normalize(norm), normSquared is rawNormSquared before
+// the update, so the same old norm is used. Only the scale changes, weights are
+// rewritten when it has drifted far from 1.
+inline void HiddenNeuron::rescale(double normSquared) {
+    
+    weightScale = static_cast<float>(weightVectorLength / sqrt(normSquared));
+    
+    if(weightScale < 1.0f/16 || weightScale > 16)
+        applyWeightScale();
+}
+
+inline void HiddenNeuron::setupWeightScale() {
+    
+    rawNormSquared = 0;
+    
+    for(u_short s = 0;s < afferentSynapses.size();s++)
+        rawNormSquared += static_cast<double>(afferentSynapses[s].weight) * afferentSynapses[s].weight;
+}
+
+// Also clears rounding errors gathered by rawNormSquared
+inline void HiddenNeuron::applyWeightScale() {
+    
+    for(u_short s = 0;s < afferentSynapses.size();s++)
+        afferentSynapses[s].weight *= weightScale;
+    
+    weightScale = 1;
+    setupWeightScale();
+}
+
 
 #endif // HIDDENNEURON_H
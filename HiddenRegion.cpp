@@ -9,16 +9,23 @@
 #include "HiddenNeuron.h"
 #include "Synapse.h"
 #include "BinaryWrite.h"
+#include "BinaryRead.h"
 #include "InputNeuron.h"
 #include "InputRegion.h"
 #include <cmath>
 #include <sstream>
 #include <algorithm>
+#include <functional>
 #include <queue>
+#include <limits>
 #include <iostream>
 #include <cstdlib>
 #include "Utilities.h"
 
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
 #include <vector>
 
 using std::vector;
@@ -27,6 +34,57 @@ using std::cout;
 using std::endl;
 using std::cerr;
 
+const unsigned int HiddenRegion::sampleStride;
+
+#if defined(__AVX2__)
+static int horizontalSum(__m256i x) {
+    
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+// Sum of rates[s] * weights[s]. Rates are at most 127, so no pair of
+// products saturates _mm256_maddubs_epi16, and every path sums the same
+static int dotProduct(const unsigned char * rates, const signed char * weights, unsigned long long n) {
+    
+    unsigned long long s = 0;
+    int sum = 0;
+    
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    __m256i acc = _mm256_setzero_si256();
+    
+    for(;s + 32 <= n;s += 32)
+        acc = _mm256_dpbusd_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rates + s)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + s)));
+    
+    sum = horizontalSum(acc);
+#elif defined(__AVXVNNI__)
+    __m256i acc = _mm256_setzero_si256();
+    
+    for(;s + 32 <= n;s += 32)
+        acc = _mm256_dpbusd_avx_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rates + s)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + s)));
+    
+    sum = horizontalSum(acc);
+#elif defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    
+    for(;s + 32 <= n;s += 32) {
+        __m256i pairs = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(rates + s)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weights + s)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(pairs, ones));
+    }
+    
+    sum = horizontalSum(acc);
+#endif
+    
+    for(;s < n;s++)
+        sum += rates[s] * weights[s];
+    
+    return sum;
+}
+
 // reason we use init and not ctor is because Network class puts a bunch of 
 // objects of this type in a vector in its ctor auto list, which does not allow passing args,
 // should have just used ptrs in retrospect.
@@ -37,6 +95,27 @@ void HiddenRegion::init(u_short regionNr, Param & p, bool isTraining, unsigned l
     
 	// Set vars
 	this->regionHistoryCounter = 0;
+    this->idle = false;
+    this->frozen = false;
+    this->frozenWeight = NULL;
+    this->frozenHalfWeight = NULL;
+    this->halfFrozenWeights = p.weightPrecision == BF16 && p.pushEpsilon < 0;
+    this->quantizedFrozenWeights = p.weightPrecision == INT8 && p.pushEpsilon < 0;
+    this->frozenInputRegion = NULL;
+    this->frozenQuantizedWeight = NULL;
+    this->frozenPreSynapticIndex = NULL;
+    this->inputScale = 0;
+    this->quantizationDifference = this->quantizationReference = 0;
+    this->pushEpsilon = p.pushEpsilon;
+    this->pushedSynapses = 0;
+    this->pushableSynapses = 0;
+    this->plasticityThreshold = p.plasticityThreshold;
+    this->efferentLearning = false;
+    this->learningNeurons = this->learnedNeurons = 0;
+    this->learningSynapses = this->learnedSynapses = 0;
+    this->trainAtTimeStepMultiple = p.trainAtTimeStepMultiple;
+    this->preSynapticVerDimension = this->preSynapticHorDimension = 0;
+    this->sampledDifference = this->sampledChange = 0;
 	this->filterWidth = p.filterWidth[regionNr-1]; 
 	this->inhibitoryRadius = p.inhibitoryRadius[regionNr-1]; 
 	this->inhibitoryContrast = p.inhibitoryContrast[regionNr-1];
@@ -54,8 +133,17 @@ void HiddenRegion::init(u_short regionNr, Param & p, bool isTraining, unsigned l
     this->externalStimulation = p.externalStimulation[regionNr-1];
     
     this->covarianceThreshold = p.covarianceThreshold;
-	this->stepSize = p.stepSize;
+	this->stepSize = p.stepSize * p.stepMultiples[regionNr-1];
 	this->traceTimeConstant = p.traceTimeConstant;
+    
+    // Leaky equations relax by a factor exp(-stepSize/tau) per step exactly, forward Euler by 1 - stepSize/tau
+    if(p.integrator == EXPONENTIAL) {
+        this->activationFactor = -expm1(-stepSize/timeConstant);
+        this->traceFactor = -expm1(-stepSize/traceTimeConstant);
+    } else {
+        this->activationFactor = stepSize/timeConstant;
+        this->traceFactor = stepSize/traceTimeConstant;
+    }
 	this->sparsenessRoutine = p.sparsenessRoutine;
     //this->transferFunction = p.transferFunction;
 	this->rule = p.rule;
@@ -95,9 +183,22 @@ void HiddenRegion::init(u_short regionNr, Param & p, bool isTraining, unsigned l
 		exit(EXIT_FAILURE);
     }
     
+    // Every neuron is normalised at its first step without learning, as without gating
+    learnedLastStep.assign(depth * verDimension * horDimension, 1);
+    
 	// Build - this part is identical in InputRegion as well, but not for long, so we don't put it in region
-	vector<vector<vector<HiddenNeuron> > > tmp1(depth, vector<vector<HiddenNeuron> >(verDimension, vector<HiddenNeuron>(horDimension)));
-	Neurons = tmp1;
+	// Rows are allocated by the thread that updates them (first touch)
+	Neurons = vector<vector<vector<HiddenNeuron> > >(depth, vector<vector<HiddenNeuron> >(verDimension));
+    
+	#pragma omp parallel
+	{
+		bindThread();
+        
+		for(int d = 0;d < depth;d++)
+			#pragma omp for
+			for(int i = 0;i < verDimension;i++)
+				Neurons[d][i] = vector<HiddenNeuron>(horDimension);
+	}
     
     // Compute epoch size
     unsigned long int outputsPerCellPerEpoch = outputtedTimeStepsPerEpoch;
@@ -128,9 +229,14 @@ void HiddenRegion::init(u_short regionNr, Param & p, bool isTraining, unsigned l
                     bufferSize *= p.nrOfRecordedSingleCells[regionNr-1];
                 
                 unsigned long long int regionSynapseBufferSize = bufferSize*desiredFanIn;
-                synapseHistoryBuffer.resize(regionSynapseBufferSize,-1); // put in -1 junk for safety
                 
-                cout << "***>> Allocated synapse buffer space for region #" << regionNr << " = " << regionSynapseBufferSize << " data points (float)." << endl;
+                // -1 junk is put in by placeHistoryBuffers()
+                if(p.weightPrecision == BF16)
+                    halfSynapseHistoryBuffer.resize(regionSynapseBufferSize);
+                else
+                    synapseHistoryBuffer.resize(regionSynapseBufferSize);
+                
+                cout << "***>> Allocated synapse buffer space for region #" << regionNr << " = " << regionSynapseBufferSize << " data points (" << (p.weightPrecision == BF16 ? "bfloat16" : "float") << ")." << endl;
             }
         }
         
@@ -143,14 +249,15 @@ void HiddenRegion::init(u_short regionNr, Param & p, bool isTraining, unsigned l
         bufferSize = outputsPerCell*depth*verDimension*horDimension;
     }
     
-    // Resize, put in -1 junk for safety
-    this->activationBuffer.resize(bufferSize,-1);
-    this->inhibitedActivationHistoryBuffer.resize(bufferSize,-1);
-    this->firingRateBuffer.resize(bufferSize,-1);
-    this->traceBuffer.resize(bufferSize,-1);
-    this->stimulationBuffer.resize(bufferSize,-1);
-    this->effectiveTraceBuffer.resize(bufferSize,-1);
-
+    // Resize, pages are not touched yet, -1 junk is put in for safety
+    // by placeHistoryBuffers() once Network knows which thread steps which neuron
+    this->activationBuffer.resize(bufferSize);
+    this->inhibitedActivationHistoryBuffer.resize(bufferSize);
+    this->firingRateBuffer.resize(bufferSize);
+    this->traceBuffer.resize(bufferSize);
+    this->stimulationBuffer.resize(bufferSize);
+    this->effectiveTraceBuffer.resize(bufferSize);
+    
     this->sparsityPercentileValue = vector<float>(outputsPerRegion);
     
     this->synapseHistoryCounter = 0;
@@ -189,7 +296,7 @@ void HiddenRegion::init(u_short regionNr, Param & p, bool isTraining, unsigned l
                 }
                 
                 // Init cell
-                Neurons[d][i][j].init(this, d, i, j, activation, inibitedActivation, firingRate, trace, stimulation, effectiveTrace, saveNeuronHistory, saveSynapseHistory, desiredFanIn, p.weightVectorLength, fixedBufferWeightHistorySize);
+                Neurons[d][i][j].init(this, d, i, j, activation, inibitedActivation, firingRate, trace, stimulation, effectiveTrace, saveNeuronHistory, saveSynapseHistory, p.weightPrecision == BF16, desiredFanIn, p.weightVectorLength, fixedBufferWeightHistorySize);
             }
                
 	
@@ -220,6 +327,494 @@ HiddenRegion::~HiddenRegion() {
     traceBuffer.clear();
 }
 
+// Fills the part of buffer that belongs to neurons [first, last) of region,
+// exact when every neuron saves history, proportional otherwise
+template <class Buffer>
+static void touchNeurons(Buffer & buffer, unsigned long long first, unsigned long long last, unsigned long long neurons, typename Buffer::value_type junk) {
+    
+    unsigned long long begin = buffer.size() * first / neurons;
+    unsigned long long end = buffer.size() * last / neurons;
+    
+    std::fill(buffer.begin() + begin, buffer.begin() + end, junk);
+}
+
+void HiddenRegion::placeHistoryBuffers(unsigned int first, unsigned int last) {
+    
+    unsigned long long neurons = getNrOfNeurons();
+    
+    touchNeurons(activationBuffer, first, last, neurons, -1.0f);
+    touchNeurons(inhibitedActivationHistoryBuffer, first, last, neurons, -1.0f);
+    touchNeurons(firingRateBuffer, first, last, neurons, -1.0f);
+    touchNeurons(traceBuffer, first, last, neurons, -1.0f);
+    touchNeurons(stimulationBuffer, first, last, neurons, -1.0f);
+    touchNeurons(effectiveTraceBuffer, first, last, neurons, -1.0f);
+    touchNeurons(synapseHistoryBuffer, first, last, neurons, -1.0f);
+    touchNeurons(halfSynapseHistoryBuffer, first, last, neurons, toBfloat16(-1.0f));
+}
+
+void HiddenRegion::placeSynapses(unsigned int first, unsigned int last) {
+    
+    for(unsigned int k = first;k < last;k++) {
+        
+        vector<Synapse> & synapses = neuron(k).afferentSynapses;
+        
+        if(frozen) {
+            
+            // Written by this thread, then the Synapse objects are gone
+            if(quantizedFrozenWeights)
+                placeQuantizedSynapses(k);
+            else if(halfFrozenWeights)
+                for(unsigned int s = 0;s < synapses.size();s++) {
+                    
+                    const Neuron * n = synapses[s].preSynapticNeuron;
+                    
+                    frozenHalfWeights[frozenStart[k] + s] = toBfloat16(synapses[s].weight * neuron(k).weightScale);
+                    frozenPreSynapticIndices[frozenStart[k] + s] = (n->depth * frozenInputRegion->verDimension + n->row) * frozenInputRegion->horDimension + n->col;
+                }
+            else
+                for(unsigned int s = 0;s < synapses.size();s++) {
+                    
+                    frozenWeights[frozenStart[k] + s] = synapses[s].weight * neuron(k).weightScale;
+                    frozenPreSynaptic[frozenStart[k] + s] = synapses[s].preSynapticNeuron;
+                }
+            
+            vector<Synapse>().swap(synapses);
+            neuron(k).weightScale = 1;
+            
+        } else {
+            
+            // Copy is allocated by this thread, synapse history slots are unaffected
+            vector<Synapse>(synapses).swap(synapses);
+        }
+    }
+}
+
+// Neuron k of a frozen INT8 region, see placeSynapses()
+void HiddenRegion::placeQuantizedSynapses(unsigned int k) {
+    
+    const vector<Synapse> & synapses = neuron(k).afferentSynapses;
+    float weightScale = neuron(k).weightScale;
+    unsigned long long first = frozenStart[k];
+    
+    float largest = 0;
+    
+    for(unsigned int s = 0;s < synapses.size();s++)
+        largest = std::max(largest, static_cast<float>(fabs(synapses[s].weight * weightScale)));
+    
+    float inverse = largest > 0 ? 127 / largest : 0;
+    bool dense = !synapses.empty();
+    
+    for(unsigned int s = 0;s < synapses.size();s++) {
+        
+        const Neuron * n = synapses[s].preSynapticNeuron;
+        unsigned int p = (n->depth * frozenInputRegion->verDimension + n->row) * frozenInputRegion->horDimension + n->col;
+        
+        frozenQuantizedWeights[first + s] = static_cast<signed char>(lrintf(synapses[s].weight * weightScale * inverse));
+        frozenPreSynapticIndices[first + s] = p;
+        dense = dense && p == frozenPreSynapticIndices[first] + s;
+    }
+    
+    frozenQuantizedScale[k] = largest / 127;
+    frozenDenseStart[k] = dense ? static_cast<long long>(frozenPreSynapticIndices[first]) : -1;
+}
+
+void HiddenRegion::freezeSynapses(Region & region) {
+    
+    if(frozen)
+        return;
+    
+    unsigned int neurons = getNrOfNeurons();
+    
+    frozenStart.resize(neurons + 1);
+    frozenStart[0] = 0;
+    
+    for(unsigned int k = 0;k < neurons;k++)
+        frozenStart[k+1] = frozenStart[k] + neuron(k).afferentSynapses.size();
+    
+    // Presynaptic neurons are indices into the firing rates of region
+    if(quantizedFrozenWeights || halfFrozenWeights)
+        for(unsigned int k = 0;k < neurons;k++)
+            for(std::vector<Synapse>::iterator s = neuron(k).afferentSynapses.begin(); s != neuron(k).afferentSynapses.end();s++)
+                if((*s).preSynapticNeuron->region != &region) {
+                    
+                    cerr << (quantizedFrozenWeights ? "INT8" : "BF16") << " weights need region #" << regionNr << " to read only region #" << region.regionNr << endl;
+                    cerr.flush();
+                    exit(EXIT_FAILURE);
+                }
+    
+    // Pages are not touched yet, placeSynapses() fills them
+    if(quantizedFrozenWeights) {
+        
+        setupFrozenInput(region);
+        
+        // Float weights of sampled neurons, while there are Synapse objects
+        quantizationSampleStart.assign(1, 0);
+        quantizationSampleWeight.clear();
+        
+        for(unsigned int k = 0;k < neurons;k++) {
+            
+            for(std::vector<Synapse>::iterator s = neuron(k).afferentSynapses.begin(); s != neuron(k).afferentSynapses.end();s++)
+                if(k % sampleStride == 0)
+                    quantizationSampleWeight.push_back((*s).weight * neuron(k).weightScale);
+            
+            if(k % sampleStride == 0)
+                quantizationSampleStart.push_back(quantizationSampleWeight.size());
+        }
+        
+        frozenQuantizedWeights.resize(frozenStart[neurons]);
+        frozenQuantizedWeight = frozenQuantizedWeights.data();
+        frozenPreSynapticIndices.resize(frozenStart[neurons]);
+        frozenPreSynapticIndex = frozenPreSynapticIndices.data();
+        frozenQuantizedScale.resize(neurons);
+        frozenDenseStart.resize(neurons);
+        
+        frozen = true;
+        return;
+    }
+    
+    if(halfFrozenWeights) {
+        
+        setupFrozenInput(region);
+        frozenHalfWeights.resize(frozenStart[neurons]);
+        frozenHalfWeight = frozenHalfWeights.data();
+        frozenPreSynapticIndices.resize(frozenStart[neurons]);
+        frozenPreSynapticIndex = frozenPreSynapticIndices.data();
+        
+        frozen = true;
+        return;
+    }
+    
+    frozenWeights.resize(frozenStart[neurons]);
+    frozenWeight = frozenWeights.data();
+    frozenPreSynaptic.resize(frozenStart[neurons]);
+    
+    frozen = true;
+}
+
+void HiddenRegion::shareFrozenSynapses(const HiddenRegion & source, const vector<Region *> & regions) {
+    
+    if(!source.frozen || source.frozenStart.size() != getNrOfNeurons() + 1) {
+        
+        cerr << "Weights can only be shared with a frozen region of the same size." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    frozenStart = source.frozenStart;
+    halfFrozenWeights = source.halfFrozenWeights;
+    frozenWeight = source.frozenWeight;
+    frozenHalfWeight = source.frozenHalfWeight;
+    
+    // Indices are the same in any network, only the neurons they stand for are not
+    if(source.quantizedFrozenWeights) {
+        
+        quantizedFrozenWeights = true;
+        setupFrozenInput(*regions[source.frozenInputRegion->regionNr]);
+        frozenQuantizedWeight = source.frozenQuantizedWeight;
+        frozenPreSynapticIndex = source.frozenPreSynapticIndex;
+        frozenQuantizedScale = source.frozenQuantizedScale;
+        frozenDenseStart = source.frozenDenseStart;
+        quantizationSampleStart = source.quantizationSampleStart;
+        quantizationSampleWeight = source.quantizationSampleWeight;
+        
+        frozen = true;
+        return;
+    }
+    
+    if(source.halfFrozenWeights) {
+        
+        setupFrozenInput(*regions[source.frozenInputRegion->regionNr]);
+        frozenPreSynapticIndex = source.frozenPreSynapticIndex;
+        
+        frozen = true;
+        return;
+    }
+    
+    frozenPreSynaptic.resize(source.frozenPreSynaptic.size());
+    
+    for(unsigned long long s = 0;s < frozenPreSynaptic.size();s++) {
+        
+        const Neuron * n = source.frozenPreSynaptic[s];
+        frozenPreSynaptic[s] = regions[n->region->regionNr]->getNeuron(n->depth, n->row, n->col);
+    }
+    
+    frozen = true;
+}
+
+void HiddenRegion::setupFrozenInput(Region & region) {
+    
+    frozenInputRegion = &region;
+    frozenInputNeuron.resize(region.depth * region.verDimension * region.horDimension);
+    
+    for(int d = 0;d < region.depth;d++)
+        for(int i = 0;i < region.verDimension;i++)
+            for(int j = 0;j < region.horDimension;j++)
+                frozenInputNeuron[(d * region.verDimension + i) * region.horDimension + j] = region.getNeuron(d, i, j);
+    
+    if(quantizedFrozenWeights)
+        quantizedInput.assign(frozenInputNeuron.size(), 0);
+    else
+        frozenInput.assign(frozenInputNeuron.size(), 0);
+    
+    inputScale = 0;
+}
+
+// INT8 firing rates are not negative, the largest one is 127
+void HiddenRegion::gatherInput() {
+    
+    if(halfFrozenWeights) {
+        
+        for(unsigned int p = 0;p < frozenInputNeuron.size();p++)
+            frozenInput[p] = frozenInputNeuron[p]->firingRate;
+        
+        return;
+    }
+    
+    float largest = 0;
+    
+    for(unsigned int p = 0;p < frozenInputNeuron.size();p++)
+        largest = std::max(largest, frozenInputNeuron[p]->firingRate);
+    
+    float inverse = largest > 0 ? 127 / largest : 0;
+    
+    for(unsigned int p = 0;p < frozenInputNeuron.size();p++) {
+        
+        float firingRate = std::max(frozenInputNeuron[p]->firingRate, 0.0f);
+        quantizedInput[p] = static_cast<unsigned char>(lrintf(firingRate * inverse));
+    }
+    
+    inputScale = largest / 127;
+}
+
+// Sampled neurons also sum the difference to float weights and firing rates
+float HiddenRegion::quantizedStimulation(unsigned int k) {
+    
+    unsigned long long first = frozenStart[k], last = frozenStart[k+1];
+    int sum = 0;
+    
+    if(frozenDenseStart[k] >= 0)
+        sum = dotProduct(&quantizedInput[frozenDenseStart[k]], &frozenQuantizedWeight[first], last - first);
+    else
+        for(unsigned long long s = first;s < last;s++)
+            sum += quantizedInput[frozenPreSynapticIndex[s]] * frozenQuantizedWeight[s];
+    
+    float stimulation = sum * frozenQuantizedScale[k] * inputScale;
+    
+    if(k % sampleStride == 0) {
+        
+        const float * weight = &quantizationSampleWeight[quantizationSampleStart[k / sampleStride]];
+        float exact = 0;
+        
+        for(unsigned long long s = first;s < last;s++)
+            exact += weight[s - first] * frozenInputNeuron[frozenPreSynapticIndex[s]]->firingRate;
+        
+        double difference = (stimulation - exact) * (stimulation - exact);
+        double reference = exact * exact;
+        
+        #pragma omp atomic
+        quantizationDifference += difference;
+        
+        #pragma omp atomic
+        quantizationReference += reference;
+    }
+    
+    return stimulation;
+}
+
+void HiddenRegion::reportQuantization() {
+    
+    cout << "INT8 weights in region #" << regionNr << ": stimulation differs from float by "
+         << (quantizationReference > 0 ? 100 * sqrt(quantizationDifference / quantizationReference) : 0) << "% (relative RMS over every " << sampleStride << "th neuron)" << endl;
+    
+    quantizationDifference = quantizationReference = 0;
+}
+
+unsigned int HiddenRegion::getFrozenSynapseSize() const {
+    
+    if(quantizedFrozenWeights)
+        return sizeof(signed char) + sizeof(unsigned int);
+    
+    if(halfFrozenWeights)
+        return sizeof(bfloat16) + sizeof(unsigned int);
+    
+    return sizeof(float) + sizeof(const Neuron *);
+}
+
+void HiddenRegion::setupEfferentSynapses(Region & region) {
+    
+    unsigned int neurons = getNrOfNeurons();
+    unsigned int preSynapticNeurons = region.depth * region.verDimension * region.horDimension;
+    
+    efferentNeuron.assign(preSynapticNeurons, NULL);
+    efferentStart.assign(preSynapticNeurons + 1, 0);
+    vector<unsigned int> preSynaptic;
+    vector<float *> weights;
+    
+    for(unsigned int k = 0;k < neurons;k++)
+        for(unsigned int s = 0;s < getNrOfAfferentSynapses(k);s++) {
+            
+            const Neuron * n = frozen ? frozenPreSynaptic[frozenStart[k] + s] : neuron(k).afferentSynapses[s].preSynapticNeuron;
+            
+            if(n->region != &region) {
+                
+                cerr << "Push propagation and gated learning need region #" << regionNr << " to read only region #" << region.regionNr << endl;
+                cerr.flush();
+                exit(EXIT_FAILURE);
+            }
+            
+            unsigned int p = (n->depth * region.verDimension + n->row) * region.horDimension + n->col;
+            
+            efferentNeuron[p] = n;
+            efferentStart[p+1]++;
+            preSynaptic.push_back(p);
+            weights.push_back(frozen ? const_cast<float *>(&frozenWeight[frozenStart[k] + s]) : &neuron(k).afferentSynapses[s].weight);
+        }
+    
+    for(unsigned int p = 0;p < preSynapticNeurons;p++)
+        efferentStart[p+1] += efferentStart[p];
+    
+    // Afferent synapses are visited in order of postsynaptic neuron, so each list is too
+    vector<unsigned long long> next(efferentStart.begin(), efferentStart.end() - 1);
+    efferents.resize(preSynaptic.size());
+    
+    unsigned long long s = 0;
+    
+    for(unsigned int k = 0;k < neurons;k++)
+        for(unsigned int i = 0;i < getNrOfAfferentSynapses(k);i++, s++) {
+            
+            Efferent e = {weights[s], k};
+            efferents[next[preSynaptic[s]]++] = e;
+        }
+    
+    pushedStimulation.resize(neurons);
+    activePreSynaptic.reserve(preSynapticNeurons);
+    activeFiringRate.reserve(preSynapticNeurons);
+    learningPreSynaptic.reserve(preSynapticNeurons);
+    learningFiringRate.reserve(preSynapticNeurons);
+    learningStep.resize(neurons);
+    normChange.resize(neurons);
+    pushedSynapses = 0;
+    pushableSynapses = 0;
+}
+
+void HiddenRegion::findActivePreSynaptic() {
+    
+    activePreSynaptic.clear();
+    activeFiringRate.clear();
+    
+    for(unsigned int p = 0;p < efferentNeuron.size();p++) {
+        
+        if(efferentNeuron[p] == NULL)
+            continue;
+        
+        float firingRate = efferentNeuron[p]->firingRate;
+        
+        if(fabs(firingRate) > pushEpsilon) {
+            activePreSynaptic.push_back(p);
+            activeFiringRate.push_back(firingRate);
+        }
+    }
+}
+
+void HiddenRegion::pushStimulation(unsigned int first, unsigned int last) {
+    
+    unsigned long long pushable = 0, pushed = 0;
+    
+    for(unsigned int k = first;k < last;k++) {
+        pushedStimulation[k] = 0;
+        pushable += getNrOfAfferentSynapses(k);
+    }
+    
+    // Only presynaptic neurons firing above epsilon, into neurons of this range only
+    for(unsigned int a = 0;a < activePreSynaptic.size();a++) {
+        
+        unsigned int p = activePreSynaptic[a];
+        float firingRate = activeFiringRate[a];
+        
+        // Most lists of topographic connectivity miss the range entirely
+        if(efferents[efferentStart[p]].postSynaptic >= last || efferents[efferentStart[p+1] - 1].postSynaptic < first)
+            continue;
+        
+        // First efferent synapse into this range
+        unsigned long long low = efferentStart[p], high = efferentStart[p+1];
+        
+        while(low < high) {
+            
+            unsigned long long middle = (low + high) / 2;
+            
+            if(efferents[middle].postSynaptic < first)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        
+        unsigned long long e = low;
+        
+        for(;e < efferentStart[p+1] && efferents[e].postSynaptic < last;e++)
+            pushedStimulation[efferents[e].postSynaptic] += *efferents[e].weight * firingRate;
+        
+        pushed += e - low;
+    }
+    
+    #pragma omp atomic
+    pushedSynapses += pushed;
+    
+    #pragma omp atomic
+    pushableSynapses += pushable;
+}
+
+void HiddenRegion::findLearningPreSynaptic() {
+    
+    efferentLearning = false;
+    
+    if(!learnsEfferent())
+        return;
+    
+    learningPreSynaptic.clear();
+    learningFiringRate.clear();
+    
+    unsigned long long efferentSynapses = 0, afferentSynapses = 0;
+    
+    // Same gates as applyGatedLearningRule()
+    for(unsigned int p = 0;p < efferentNeuron.size();p++) {
+        
+        if(efferentNeuron[p] == NULL)
+            continue;
+        
+        float firingRate = efferentNeuron[p]->firingRate;
+        
+        if(rule == COVARIANCE_PRESYNAPTIC_TRACE_RULE ? firingRate > covarianceThreshold : fabs(firingRate) > plasticityThreshold) {
+            learningPreSynaptic.push_back(p);
+            learningFiringRate.push_back(firingRate);
+            efferentSynapses += efferentStart[p+1] - efferentStart[p];
+        }
+    }
+    
+    // Otherwise visiting the afferent synapses of neurons that learn is cheaper
+    for(unsigned int k = 0;k < learnedLastStep.size();k++)
+        if(learnedLastStep[k])
+            afferentSynapses += getNrOfAfferentSynapses(k);
+    
+    efferentLearning = efferentSynapses < afferentSynapses;
+}
+
+void HiddenRegion::reportPushPropagation() {
+    
+    // Dropped firing rates are at most epsilon, times the weights they would have gone through
+    vector<float> weightSum(getNrOfNeurons(), 0);
+    float largestWeightSum = 0;
+    
+    for(unsigned long long e = 0;e < efferents.size();e++)
+        weightSum[efferents[e].postSynaptic] += fabs(*efferents[e].weight) * neuron(efferents[e].postSynaptic).weightScale;
+    
+    for(unsigned int k = 0;k < weightSum.size();k++)
+        largestWeightSum = weightSum[k] > largestWeightSum ? weightSum[k] : largestWeightSum;
+    
+    cout << "Push propagation into region #" << regionNr << ": "
+         << (pushableSynapses > 0 ? (100.0 * pushedSynapses) / pushableSynapses : 0) << "% of synapses carried signal, dropped stimulation <= "
+         << pushEpsilon * largestWeightSum << " per neuron and time step" << endl;
+}
+
 void HiddenRegion::setupFilters() {
 	
 	float nonCenterCumulativeSum = 0;
@@ -244,56 +839,13 @@ void HiddenRegion::setupFilters() {
     inhibitoryFilter[filterCenter][filterCenter] = 1-nonCenterCumulativeSum;
 }
 
-void HiddenRegion::computeNewFiringRate() {
+// HEAP: after threshold has been found
+void HiddenRegion::computeNewFiringRate(unsigned int first, unsigned int last) {
     
-    if(sparsenessRoutine == HEAP) {
-	
-        // Compute activation
-        computeNewActivation();
-        
-        // Do local inhibition
-        // Even if we do not run .inhibit(), the activation
-        // values will still have been copied through to 
-        // n->newInhibitedActivation by .computeNewActivation(),
-        // hence all future calculations that expect inhibited values
-        // will still work.
-        
-        if(lateralInteraction != NONE)
-            filter();
-        
-        // this value is written to once by each thread,
-        // but it is the same value is computed in all threads,
-        // so it does not matter
-        if(sparsenessRoutine != NOSPARSENESS)
-            threshold = findThreshold();
-        
-        /*
-        /// ****************************************************************
-        
-        // ADJUST threshold
-        float activationScaler = 0.256315005; // 0.556315005 <== do rough. 0.456315005 some neurons fired, 0.356315005 still not enough.
-        float averageActivation = 0;
-        
-        for(int d = 0;d < depth;d++)
-            for(int i = 0;i < verDimension; i++)
-                for(int j = 0;j < horDimension; j++)
-                    averageActivation += Neurons[d][i][j].newInhibitedActivation;
-        
-        averageActivation /= verDimension*horDimension*depth;
-        
-        threshold /= (averageActivation/activationScaler);
-        
-        //cout << "averageActivation: " << averageActivation << endl;
-        
-        /// ****************************************************************
-        */
-        
-        // Compute firing rate using contrast enhancement
-        for(int d = 0;d < depth;d++)
-        {
-            #pragma omp for nowait
-            for(int i = 0;i < verDimension; i++)
-                for(int j = 0;j < horDimension; j++) {
+                for(unsigned int k = first;k < last;k++) {
+                    int d, i, j;
+                    position(k, d, i, j);
+                    
 					Neurons[d][i][j].oldFiringRate = Neurons[d][i][j].firingRate;
                     //Neurons[d][i][j].newFiringRate = (1/(1+exp(-2*sigmoidSlope*(Neurons[d][i][j].newInhibitedActivation - threshold - sigmoidThreshold))));
 					
@@ -310,26 +862,47 @@ void HiddenRegion::computeNewFiringRate() {
 					
 									
 				}
-        }
-    }
-    else if(sparsenessRoutine == GLOBAL) {
-        
-        float cumulativeFiringRate = 0;
-        
-        for(int i = 0;i < verDimension; i++)
-            for(int j = 0;j < horDimension; j++)
-                cumulativeFiringRate += Neurons[0][i][j].firingRate;
-        
-         #pragma omp for nowait
-         for(int i = 0;i < verDimension; i++)
-         for(int j = 0;j < horDimension; j++) {
+}
+
+float HiddenRegion::findCumulativeFiringRate() {
+    
+    float cumulativeFiringRate = 0;
+    
+    for(int i = 0;i < verDimension; i++)
+        for(int j = 0;j < horDimension; j++)
+            cumulativeFiringRate += Neurons[0][i][j].firingRate;
+    
+    return cumulativeFiringRate;
+}
+
+// GLOBAL: first sheet only
+void HiddenRegion::computeGlobalFiringRate(unsigned int first, unsigned int last, float cumulativeFiringRate) {
+    
+         if(pushEpsilon >= 0)
+             pushStimulation(first, last);
+         
+         for(unsigned int k = first;k < last;k++) {
          
              // Presynaptic Stimulation
-             HiddenNeuron * n = &Neurons[0][i][j];
+             HiddenNeuron * n = &neuron(k);
              float stimulation = 0;
          
-             for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++)
-                stimulation += (*s).weight * (*s).preSynapticNeuron->firingRate;
+             if(pushEpsilon >= 0)
+                 stimulation = pushedStimulation[k];
+             else if(frozen && quantizedFrozenWeights)
+                 stimulation = quantizedStimulation(k);
+             else if(frozen && halfFrozenWeights)
+                 for(unsigned long long s = frozenStart[k];s < frozenStart[k+1];s++)
+                     stimulation += fromBfloat16(frozenHalfWeight[s]) * frozenInput[frozenPreSynapticIndex[s]];
+             else if(frozen)
+                 for(unsigned long long s = frozenStart[k];s < frozenStart[k+1];s++)
+                     stimulation += frozenWeight[s] * frozenPreSynaptic[s]->firingRate;
+             else
+                 for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++)
+                    stimulation += (*s).weight * (*s).preSynapticNeuron->firingRate;
+             
+             // SCALED weights, 1 otherwise
+             stimulation *= n->weightScale;
              
              // Save stimulation variable
              n->stimulation = stimulation;
@@ -351,7 +924,7 @@ void HiddenRegion::computeNewFiringRate() {
              
              // NEW (daniel): fast firing rate, slow membrane dynamics
              //
-             n->newActivation = n->activation + (stepSize/timeConstant) * (-n->activation + stimulation - n->newInhibitedActivation);
+             n->newActivation = n->activation + activationFactor * (-n->activation + stimulation - n->newInhibitedActivation);
 			 //n->myOldFiringRate = n->newFiringRate;													// dnavarro2015 Implementing anti-Hebbian learning rule 11 (Rolls and Stringer, 2001) 
 			 
 			 
@@ -359,21 +932,30 @@ void HiddenRegion::computeNewFiringRate() {
              n->newFiringRate = 1/(1+exp(-2*sigmoidSlope*(n->newActivation - sigmoidThreshold)));
              
          }
-         
-    }
 }
 
 // Save output in newActivation (also newInhibitedActivation)
-void HiddenRegion::computeNewActivation() {
+void HiddenRegion::computeNewActivation(unsigned int first, unsigned int last) {
 	
-	for(int d = 0;d < depth;d++)
-	{
-		#pragma omp for
-        for(int i = 0;i < verDimension; i++) {
-            for(int j = 0;j < horDimension; j++) {
-                HiddenNeuron * n = &Neurons[d][i][j];
+            if(pushEpsilon >= 0)
+                pushStimulation(first, last);
+    
+            for(unsigned int k = first;k < last;k++) {
+                HiddenNeuron * n = &neuron(k);
 				float stimulation = 0;
-
+                
+                // Pushed, or read through frozen weights, int8, bfloat16 or float, or Synapse objects
+                if(pushEpsilon >= 0)
+                    stimulation = pushedStimulation[k];
+                else if(frozen && quantizedFrozenWeights)
+                    stimulation = quantizedStimulation(k);
+                else if(frozen && halfFrozenWeights)
+                    for(unsigned long long s = frozenStart[k];s < frozenStart[k+1];s++)
+                        stimulation += fromBfloat16(frozenHalfWeight[s]) * frozenInput[frozenPreSynapticIndex[s]];
+                else if(frozen)
+                    for(unsigned long long s = frozenStart[k];s < frozenStart[k+1];s++)
+                        stimulation += frozenWeight[s] * frozenPreSynaptic[s]->firingRate;
+                else
 				for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++) {
                     // classic
                     stimulation += (*s).weight * (*s).preSynapticNeuron->firingRate;
@@ -394,11 +976,14 @@ void HiddenRegion::computeNewActivation() {
                      */
                     
                 }
+                
+                // SCALED weights, 1 otherwise
+                stimulation *= n->weightScale;
 				
 				float stimulationFactor = 2000;// discussed with Simon on Mon 13th 2015 ==> Monotonic gain fields + new learning rules -> firing rate dnavarro2015
                 
                 //old obsucated: n->newActivation = (1 - stepSize/timeConstant) * n->activation + (stepSize/timeConstant) * stimulation;
-                n->newActivation = n->activation + (stepSize/timeConstant) * (-n->activation + stimulationFactor * stimulation);
+                n->newActivation = n->activation + activationFactor * (-n->activation + stimulationFactor * stimulation);
                 
                 n->stimulation = stimulation;
 				
@@ -406,20 +991,19 @@ void HiddenRegion::computeNewActivation() {
     			// turned on in parameter file
     			n->newInhibitedActivation = n->newActivation;
             }
-        }
-	}
 }
 
-// CLASSIC
-void HiddenRegion::filter() {
+// CLASSIC, first sheet only
+void HiddenRegion::filter(unsigned int first, unsigned int last) {
 
 	int n_i, n_j;		 // neuron being inspected by filter
 	float convolutionResult;
 	
-	// Choose neuron to center filter on
-	#pragma omp for
-	for(int i = 0;i < verDimension;i++)
-        for(int j = 0;j < horDimension;j++) {
+        for(unsigned int k = first;k < last;k++) {
+            
+            // Choose neuron to center filter on
+            int d, i, j;
+            position(k, d, i, j);
 			
             convolutionResult = 0;
 			
@@ -487,19 +1071,18 @@ float HiddenRegion::findThreshold() {
 	return top;
 }
 
-void HiddenRegion::applyLearningRule() {
-    
-    if(learningRate == 0)
-        return;
+void HiddenRegion::applyLearningRule(unsigned int first, unsigned int last) {
 	
+    if(plasticityThreshold >= 0 || weightNormalization == SCALED) {
+        applyGatedLearningRule(first, last);
+        return;
+    }
+    
 	// int timeStep = 0;
 	
-    for(int d = 0; d < depth;d++)
-		#pragma omp for nowait
-        for(int i = 0; i < verDimension;i++)
-            for(int j = 0; j < horDimension;j++) {
+            for(unsigned int k = first;k < last;k++) {
 				
-                HiddenNeuron * n = &Neurons[d][i][j];
+                HiddenNeuron * n = &neuron(k);
                 float norm = 0; //, dw;
 				
 				for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++) {
@@ -523,7 +1106,7 @@ void HiddenRegion::applyLearningRule() {
                     float beta = 0.2;// 1.8
 					
 					// dnavarro2015 Clipping synaptic weitghts to zero 
-					float deltaW;
+					float deltaW = 0;
 					
                     // Add to cumulative norm value
 					norm += oldWeight * oldWeight;	
@@ -626,7 +1209,7 @@ void HiddenRegion::applyLearningRule() {
                 
                 // Update trace for this neuron
 				//obfuscated form: n->newTrace = (1 - stepSize/traceTimeConstant)*n->trace + (stepSize/traceTimeConstant)*n->firingRate;
-                n->newTrace = n->trace + (stepSize/traceTimeConstant)*(-n->trace + n->firingRate);
+                n->newTrace = n->trace + traceFactor*(-n->trace + n->firingRate);
                 n->trace = n->newTrace;
 				n->addMyDelayedTrace(n->trace);				// dnavarro2015 Implementing anti-Hebbian learning rule 10 (Rolls and Stringer, 2001) 
 				n->addMyDelayedFiringRate(n->firingRate);   // dnavarro2015 Implementing anti-Hebbian learning rule 11 (Rolls and Stringer, 2001)
@@ -640,26 +1223,782 @@ void HiddenRegion::applyLearningRule() {
                 
                 // Add SquareValues and PRINT RMS!!!!!!!!!!!!!!! <-- here
             }
+}
+
+// Same rules as above, but a rule only changes a weight in proportion to the
+// presynaptic firing rate and a postsynaptic factor. Neurons whose factor is at
+// most plasticityThreshold are skipped, in others only synapses whose
+// presynaptic firing rate is above it are updated (COVARIANCE has its own).
+// A negative threshold gates nothing, which is how SCALED normalization learns.
+// A threshold of 0 is not bit-identical to no gating: CLASSIC neurons that did
+// not learn are not normalised again, so weights differ by rounding, about 1e-6,
+// and with COVARIANCE firing rates by up to 7e-3 after three epochs.
+void HiddenRegion::applyGatedLearningRule(unsigned int first, unsigned int last) {
+    
+    if(efferentLearning) {
+        applyEfferentLearningRule(first, last);
+        return;
+    }
+    
+    bool scaled = weightNormalization == SCALED;
+    unsigned long long neurons = 0, synapses = 0, learned = 0;
+    
+    for(unsigned int k = first;k < last;k++) {
+        
+        HiddenNeuron * n = &neuron(k);
+        float post = 0;
+        
+        switch (rule) {
+            case HEBB_RULE:
+                post = n->firingRate;
+                break;
+            case TRACE_RULE:
+                post = n->getMyDelayedTrace(n->timeStep, 15);
+                break;
+            case COVARIANCE_PRESYNAPTIC_TRACE_RULE:
+                post = n->trace;
+                break;
+        }
+        
+        bool learns = fabs(post) > plasticityThreshold;
+        
+        // Costs a square root, so a SCALED neuron is normalised every step
+        if(scaled) {
+            
+            double normSquared = n->rawNormSquared;
+            
+            if(learns)
+                learned += applyScaledLearningRule(n, post);
+            
+            n->rescale(normSquared);
+        }
+        
+        // A neuron that stops learning is normalised once more, with the norm of its updated weights
+        else if(learns || learnedLastStep[k]) {
+            
+            float norm = 0;
+            
+            for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++) {
+                
+                norm += (*s).weight * (*s).weight;
+                
+                if(!learns)
+                    continue;
+                
+                float preSynaptic = (*s).preSynapticNeuron->firingRate;
+                
+                switch (rule) {
+                        
+                    case HEBB_RULE:
+                    case TRACE_RULE:
+                        
+                        if(fabs(preSynaptic) <= plasticityThreshold)
+                            continue;
+                        
+                        (*s).weight += stepSize * (learningRate * post * preSynaptic);
+                        
+                        if (rule == TRACE_RULE && (*s).weight < 0) { cout << "No... Bad, bad NEGATIVE SYNAPTIC: " << (*s).weight << endl; exit(EXIT_FAILURE); }
+                        
+                        break;
+                        
+                    case COVARIANCE_PRESYNAPTIC_TRACE_RULE:
+                        
+                        if(preSynaptic <= covarianceThreshold)
+                            continue;
+                        
+                        (*s).weight += stepSize * (learningRate * post);
+                        break;
+                }
+                
+                learned++;
+            }
+            
+            if(weightNormalization == CLASSIC)
+                n->normalize(norm);
+        }
+        
+        learnedLastStep[k] = learns;
+        
+        if(learns) {
+            neurons++;
+            synapses += n->afferentSynapses.size();
+        }
+        
+        // Update trace for this neuron, as above
+        n->newTrace = n->trace + traceFactor*(-n->trace + n->firingRate);
+        n->trace = n->newTrace;
+        n->addMyDelayedTrace(n->trace);
+        n->addMyDelayedFiringRate(n->firingRate);
+    }
+    
+    #pragma omp atomic
+    learningNeurons += last - first;
+    
+    #pragma omp atomic
+    learnedNeurons += neurons;
+    
+    #pragma omp atomic
+    learningSynapses += synapses;
+    
+    #pragma omp atomic
+    learnedSynapses += learned;
+}
 
+// CLASSIC normalization reads every weight of a neuron that learns, otherwise
+// only synapses from presynaptic neurons that pass the gate need to be visited
+bool HiddenRegion::learnsEfferent() const {
+    
+    return plasticityThreshold >= 0 && weightNormalization != CLASSIC && !efferentStart.empty();
 }
 
-void HiddenRegion::doTimeStep(bool save) {
+// As applyGatedLearningRule(), with the same arithmetic for each weight, but
+// through the efferent synapses of learningPreSynaptic into [first, last).
+// SCALED norms sum their changes in presynaptic instead of afferent order.
+void HiddenRegion::applyEfferentLearningRule(unsigned int first, unsigned int last) {
+    
+    bool scaled = weightNormalization == SCALED;
+    bool covariance = rule == COVARIANCE_PRESYNAPTIC_TRACE_RULE;
+    unsigned long long neurons = 0, synapses = 0, learned = 0;
+    
+    for(unsigned int k = first;k < last;k++) {
+        
+        HiddenNeuron * n = &neuron(k);
+        float post = 0;
+        
+        switch (rule) {
+            case HEBB_RULE:
+                post = n->firingRate;
+                break;
+            case TRACE_RULE:
+                post = n->getMyDelayedTrace(n->timeStep, 15);
+                break;
+            case COVARIANCE_PRESYNAPTIC_TRACE_RULE:
+                post = n->trace;
+                break;
+        }
+        
+        learnedLastStep[k] = fabs(post) > plasticityThreshold;
+        normChange[k] = 0;
+        
+        if(scaled)
+            learningStep[k] = stepSize * (learningRate * post) * (1 / n->weightScale);
+        else
+            learningStep[k] = learningRate * post;
+        
+        if(learnedLastStep[k]) {
+            neurons++;
+            synapses += n->afferentSynapses.size();
+        }
+    }
+    
+    for(unsigned int a = 0;a < learningPreSynaptic.size();a++) {
+        
+        unsigned int p = learningPreSynaptic[a];
+        float preSynaptic = learningFiringRate[a];
+        
+        if(efferents[efferentStart[p]].postSynaptic >= last || efferents[efferentStart[p+1] - 1].postSynaptic < first)
+            continue;
+        
+        // First efferent synapse into this range
+        unsigned long long low = efferentStart[p], high = efferentStart[p+1];
+        
+        while(low < high) {
+            
+            unsigned long long middle = (low + high) / 2;
+            
+            if(efferents[middle].postSynaptic < first)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        
+        for(unsigned long long e = low;e < efferentStart[p+1] && efferents[e].postSynaptic < last;e++) {
+            
+            unsigned int k = efferents[e].postSynaptic;
+            
+            if(!learnedLastStep[k])
+                continue;
+            
+            float & weight = *efferents[e].weight;
+            float oldWeight = weight;
+            
+            if(scaled)
+                weight += covariance ? learningStep[k] : learningStep[k] * preSynaptic;
+            else
+                weight += stepSize * (covariance ? learningStep[k] : learningStep[k] * preSynaptic);
+            
+            if(scaled)
+                normChange[k] += (weight - oldWeight) * (weight + oldWeight);
+            
+            if (rule == TRACE_RULE && weight < 0) { cout << "No... Bad, bad NEGATIVE SYNAPTIC: " << weight << endl; exit(EXIT_FAILURE); }
+            
+            learned++;
+        }
+    }
+    
+    for(unsigned int k = first;k < last;k++) {
+        
+        HiddenNeuron * n = &neuron(k);
+        
+        if(scaled) {
+            
+            double normSquared = n->rawNormSquared;
+            n->rawNormSquared += normChange[k];
+            n->rescale(normSquared);
+        }
+        
+        // Update trace for this neuron, as above
+        n->newTrace = n->trace + traceFactor*(-n->trace + n->firingRate);
+        n->trace = n->newTrace;
+        n->addMyDelayedTrace(n->trace);
+        n->addMyDelayedFiringRate(n->firingRate);
+    }
+    
+    #pragma omp atomic
+    learningNeurons += last - first;
+    
+    #pragma omp atomic
+    learnedNeurons += neurons;
+    
+    #pragma omp atomic
+    learningSynapses += synapses;
+    
+    #pragma omp atomic
+    learnedSynapses += learned;
+}
+
+// SCALED learning of one neuron, a weight change dw is dw/weightScale in
+// Synapse::weight and rawNormSquared follows it, normalisation then only
+// sets the scale, see HiddenNeuron::rescale()
+unsigned long long HiddenRegion::applyScaledLearningRule(HiddenNeuron * n, float post) {
+    
+    float toRaw = 1 / n->weightScale;
+    double normChange = 0;
+    unsigned long long learned = 0;
+    
+    if(rule == COVARIANCE_PRESYNAPTIC_TRACE_RULE) {
+        
+        float deltaW = stepSize * (learningRate * post) * toRaw;
+        
+        for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++) {
+            
+            if((*s).preSynapticNeuron->firingRate <= covarianceThreshold)
+                continue;
+            
+            float oldWeight = (*s).weight;
+            (*s).weight += deltaW;
+            normChange += ((*s).weight - oldWeight) * ((*s).weight + oldWeight);
+            learned++;
+        }
+        
+    } else {
+        
+        float rate = stepSize * (learningRate * post) * toRaw;
+        
+        for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++) {
+            
+            float preSynaptic = (*s).preSynapticNeuron->firingRate;
+            
+            if(fabs(preSynaptic) <= plasticityThreshold)
+                continue;
+            
+            float oldWeight = (*s).weight;
+            (*s).weight += rate * preSynaptic;
+            normChange += ((*s).weight - oldWeight) * ((*s).weight + oldWeight);
+            
+            if (rule == TRACE_RULE && (*s).weight < 0) { cout << "No... Bad, bad NEGATIVE SYNAPTIC: " << (*s).weight << endl; exit(EXIT_FAILURE); }
+            
+            learned++;
+        }
+    }
+    
+    n->rawNormSquared += normChange;
+    
+    return learned;
+}
+
+void HiddenRegion::setupAccumulatedLearning(Region & region) {
+    
+    unsigned int neurons = getNrOfNeurons();
+    
+    preSynapticVerDimension = region.verDimension;
+    preSynapticHorDimension = region.horDimension;
+    accumulatedNeuron.resize(region.depth * region.verDimension * region.horDimension);
+    
+    for(int d = 0;d < region.depth;d++)
+        for(int i = 0;i < region.verDimension;i++)
+            for(int j = 0;j < region.horDimension;j++)
+                accumulatedNeuron[(d * region.verDimension + i) * region.horDimension + j] = region.getNeuron(d, i, j);
+    
+    sampleStart.assign(1, 0);
+    
+    for(unsigned int k = 0;k < neurons;k++) {
+        
+        for(std::vector<Synapse>::iterator s = neuron(k).afferentSynapses.begin(); s != neuron(k).afferentSynapses.end();s++)
+            if((*s).preSynapticNeuron->region != &region) {
+                
+                cerr << "Learning every trainAtTimeStepMultiple steps needs region #" << regionNr << " to read only region #" << region.regionNr << endl;
+                cerr.flush();
+                exit(EXIT_FAILURE);
+            }
+        
+        if(k % sampleStride == 0)
+            sampleStart.push_back(sampleStart.back() + neuron(k).afferentSynapses.size());
+    }
+    
+    preSynapticSum.assign(accumulatedNeuron.size(), 0);
+    postSynapticSum.assign(neurons, 0);
+    sampleSum.assign(sampleStart.back(), 0);
+    sampledDifference = sampledChange = 0;
+}
+
+// Per step only the sums and the trace: every presynaptic neuron adds its firing
+// rate (COVARIANCE: whether it is above covarianceThreshold), every neuron its
+// postsynaptic factor. Presynaptic neurons are split over threads in proportion
+// to [first, last), so each is summed once when all of the region is.
+void HiddenRegion::accumulateLearning(unsigned int first, unsigned int last, bool restart) {
+    
+    unsigned long long neurons = getNrOfNeurons();
+    unsigned long long preSynapticNeurons = accumulatedNeuron.size();
+    
+    for(unsigned long long p = first * preSynapticNeurons / neurons;p < last * preSynapticNeurons / neurons;p++) {
+        
+        float firingRate = accumulatedNeuron[p]->firingRate;
+        float x = rule == COVARIANCE_PRESYNAPTIC_TRACE_RULE ? (firingRate > covarianceThreshold) : firingRate;
+        
+        preSynapticSum[p] = restart ? x : preSynapticSum[p] + x;
+    }
+    
+    for(unsigned int k = first;k < last;k++) {
+        
+        HiddenNeuron * n = &neuron(k);
+        float post = 0;
+        
+        switch (rule) {
+            case HEBB_RULE:
+                post = n->firingRate;
+                break;
+            case TRACE_RULE:
+                post = n->getMyDelayedTrace(n->timeStep, 15);
+                break;
+            case COVARIANCE_PRESYNAPTIC_TRACE_RULE:
+                post = n->trace;
+                break;
+        }
+        
+        postSynapticSum[k] = restart ? post : postSynapticSum[k] + post;
+        
+        // What per-step learning would add to the weights of a sampled neuron
+        if(k % sampleStride == 0) {
+            
+            float * sum = &sampleSum[sampleStart[k / sampleStride]];
+            
+            for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++, sum++) {
+                
+                float firingRate = (*s).preSynapticNeuron->firingRate;
+                float x = rule == COVARIANCE_PRESYNAPTIC_TRACE_RULE ? (firingRate > covarianceThreshold) : firingRate;
+                
+                *sum = restart ? post * x : *sum + post * x;
+            }
+        }
+        
+        // Update trace for this neuron, as applyLearningRule()
+        n->newTrace = n->trace + traceFactor*(-n->trace + n->firingRate);
+        n->trace = n->newTrace;
+        n->addMyDelayedTrace(n->trace);
+        n->addMyDelayedFiringRate(n->firingRate);
+    }
+}
+
+// One weight change for the accumulated steps: the sum over steps of postsynaptic
+// factor times presynaptic rate is taken as the product of their sums over steps,
+// which is exact when either is constant over the steps. Normalisation is once.
+void HiddenRegion::applyAccumulatedLearning(unsigned int first, unsigned int last, unsigned int steps) {
+    
+    bool scaled = weightNormalization == SCALED;
+    double difference = 0, change = 0;
+    
+    for(unsigned int k = first;k < last;k++) {
+        
+        HiddenNeuron * n = &neuron(k);
+        float rate = stepSize * (learningRate * postSynapticSum[k] / steps);
+        float toRaw = 1 / n->weightScale;
+        float norm = 0;
+        double normSquared = n->rawNormSquared, normChange = 0;
+        float * sum = k % sampleStride == 0 ? &sampleSum[sampleStart[k / sampleStride]] : NULL;
+        
+        for(std::vector<Synapse>::iterator s = n->afferentSynapses.begin(); s != n->afferentSynapses.end();s++) {
+            
+            const Neuron * pre = (*s).preSynapticNeuron;
+            float deltaW = rate * preSynapticSum[(pre->depth * preSynapticVerDimension + pre->row) * preSynapticHorDimension + pre->col];
+            float oldWeight = (*s).weight;
+            
+            norm += oldWeight * oldWeight;
+            (*s).weight += deltaW * toRaw;
+            
+            if(scaled)
+                normChange += ((*s).weight - oldWeight) * ((*s).weight + oldWeight);
+            
+            if (rule == TRACE_RULE && (*s).weight < 0) { cout << "No... Bad, bad NEGATIVE SYNAPTIC: " << (*s).weight << endl; exit(EXIT_FAILURE); }
+            
+            if(sum != NULL) {
+                
+                double exact = stepSize * (learningRate * *sum++);
+                difference += (deltaW - exact) * (deltaW - exact);
+                change += exact * exact;
+            }
+        }
+        
+        if(scaled) {
+            n->rawNormSquared += normChange;
+            n->rescale(normSquared);
+        } else if(weightNormalization == CLASSIC)
+            n->normalize(norm);
+    }
+    
+    #pragma omp atomic
+    sampledDifference += difference;
+    
+    #pragma omp atomic
+    sampledChange += change;
+}
+
+void HiddenRegion::reportAccumulatedLearning() {
+    
+    cout << "Learning every " << trainAtTimeStepMultiple << " time steps in region #" << regionNr << ": batched weight changes differ from per-step ones by "
+         << (sampledChange > 0 ? 100 * sqrt(sampledDifference / sampledChange) : 0) << "% (relative RMS over every " << sampleStride << "th neuron, before normalisation)" << endl;
+    
+    sampledDifference = sampledChange = 0;
+}
+
+void HiddenRegion::setupWeightScales() {
+    
+    for(unsigned int k = 0;k < getNrOfNeurons();k++)
+        neuron(k).setupWeightScale();
+}
+
+void HiddenRegion::reportGatedLearning() {
+    
+    cout << "Gated learning in region #" << regionNr << ": "
+         << (learningNeurons > 0 ? (100.0 * learnedNeurons) / learningNeurons : 0) << "% of neurons learned, "
+         << (learningSynapses > 0 ? (100.0 * learnedSynapses) / learningSynapses : 0) << "% of their synapses changed" << endl;
+    
+    learningNeurons = learnedNeurons = 0;
+    learningSynapses = learnedSynapses = 0;
+}
+
+void HiddenRegion::pruneSynapses(float threshold, u_short keep) {
+    
+    unsigned long long before = 0, after = 0;
+    unsigned int prunedNeurons = 0;
+    vector<float> strength, ranked;
+    
+    for(unsigned int k = 0;k < getNrOfNeurons();k++) {
+        
+        HiddenNeuron & n = neuron(k);
+        vector<Synapse> & synapses = n.afferentSynapses;
+        
+        before += synapses.size();
+        
+        if(synapses.empty())
+            continue;
+        
+        strength.resize(synapses.size());
+        
+        for(unsigned int s = 0;s < synapses.size();s++)
+            strength[s] = fabs(synapses[s].weight * n.weightScale);
+        
+        // Strongest synapse always passes the threshold
+        float bound = std::min(threshold, *std::max_element(strength.begin(), strength.end()));
+        
+        // The keep strongest are those above the keep'th strength, and the first of those equal to it
+        bool ranking = keep > 0 && keep < synapses.size();
+        float kth = 0;
+        unsigned int ties = 0;
+        
+        if(ranking) {
+            
+            ranked = strength;
+            std::nth_element(ranked.begin(), ranked.begin() + keep - 1, ranked.end(), std::greater<float>());
+            kth = ranked[keep - 1];
+            ties = keep;
+            
+            for(unsigned int s = 0;s < strength.size();s++)
+                ties -= strength[s] > kth ? 1 : 0;
+        }
+        
+        unsigned int kept = 0;
+        
+        for(unsigned int s = 0;s < synapses.size();s++) {
+            
+            bool keeps = strength[s] >= bound;
+            
+            if(ranking && keeps && strength[s] <= kth) {
+                
+                keeps = strength[s] == kth && ties > 0;
+                ties -= keeps ? 1 : 0;
+            }
+            
+            if(keeps)
+                synapses[kept++] = synapses[s];
+        }
+        
+        after += kept;
+        
+        if(kept == synapses.size())
+            continue;
+        
+        synapses.erase(synapses.begin() + kept, synapses.end());
+        prunedNeurons++;
+        
+        if(weightNormalization == CLASSIC)
+            n.normalize();
+        else if(weightNormalization == SCALED) {
+            
+            n.applyWeightScale();
+            n.normalize();
+            n.setupWeightScale();
+        }
+    }
+    
+    // Slots are handed out in neuron order, so survivors only move down
+    // and the layout matches what loadState() rebuilds from a checkpoint
+    if(before != after && singleSynapseBufferSize > 0) {
+        
+        bool half = !halfSynapseHistoryBuffer.empty();
+        unsigned long long slot = 0;
+        
+        for(unsigned int k = 0;k < getNrOfNeurons();k++) {
+            
+            HiddenNeuron & n = neuron(k);
+            
+            if(!n.saveSynapseHistory)
+                continue;
+            
+            for(std::vector<Synapse>::iterator s = n.afferentSynapses.begin();s != n.afferentSynapses.end();s++) {
+                
+                if(half) {
+                    
+                    bfloat16 * to = &halfSynapseHistoryBuffer[slot];
+                    std::copy((*s).halfWeightHistory, (*s).halfWeightHistory + singleSynapseBufferSize, to);
+                    (*s).halfWeightHistory = to;
+                    
+                } else {
+                    
+                    float * to = &synapseHistoryBuffer[slot];
+                    std::copy((*s).weightHistory, (*s).weightHistory + singleSynapseBufferSize, to);
+                    (*s).weightHistory = to;
+                }
+                
+                slot += singleSynapseBufferSize;
+            }
+        }
+        
+        synapseHistoryCounter = slot;
+    }
+    
+    cout << "Pruned region #" << regionNr << ": " << before - after << " of " << before << " synapses ("
+         << (before > 0 ? (100.0 * (before - after)) / before : 0) << "%) in " << prunedNeurons << " neurons, "
+         << after << " left" << endl;
+}
+
+// Presynaptic region first, then Neurons[d][i][j] iteration order
+static bool precedes(const Synapse & a, const Synapse & b) {
+    
+    const Neuron * x = a.preSynapticNeuron;
+    const Neuron * y = b.preSynapticNeuron;
+    
+    if(x->region->regionNr != y->region->regionNr)
+        return x->region->regionNr < y->region->regionNr;
+    
+    return (x->depth * x->region->verDimension + x->row) * x->region->horDimension + x->col <
+           (y->depth * y->region->verDimension + y->row) * y->region->horDimension + y->col;
+}
+
+void HiddenRegion::sortAfferentSynapses() {
+    
+    for(unsigned int k = 0;k < getNrOfNeurons();k++)
+        std::stable_sort(neuron(k).afferentSynapses.begin(), neuron(k).afferentSynapses.end(), precedes);
+    
+    // Slots in synapse order, as loadState() hands them out
+    bool half = !halfSynapseHistoryBuffer.empty();
+    synapseHistoryCounter = 0;
+    
+    for(unsigned int k = 0;k < getNrOfNeurons();k++) {
+        
+        HiddenNeuron & n = neuron(k);
+        
+        if(!n.saveSynapseHistory)
+            continue;
+        
+        for(std::vector<Synapse>::iterator s = n.afferentSynapses.begin();s != n.afferentSynapses.end();s++) {
+            
+            if(half)
+                (*s).halfWeightHistory = getHalfSynapseHistorySlot();
+            else
+                (*s).weightHistory = getSynapseHistorySlot();
+        }
+    }
+}
+
+void HiddenRegion::doTimeStep(unsigned int first, unsigned int last, bool save) {
+    
+    for(unsigned int k = first;k < last;k++) {
+        
+        neuron(k).doTimeStep(save && !idle);
+        
+        if(save && idle)
+            neuron(k).saveState(true);
+    }
+}
+
+// State is unchanged, but history keeps one entry per saved step of the network
+void HiddenRegion::holdTimeStep(unsigned int first, unsigned int last, bool save) {
+    
+    if(save)
+        for(unsigned int k = first;k < last;k++)
+            neuron(k).saveState(idle);
+}
+
+void HiddenRegion::saveRegionState() {
+    
+    sparsityPercentileValue[regionHistoryCounter] = idle ? std::numeric_limits<float>::quiet_NaN() : threshold;
+    regionHistoryCounter++;
+}
+
+void HiddenRegion::computeThreshold() {
+    
+    threshold = findThreshold();
+}
+
+void HiddenRegion::computeNewFiringRateTasks() {
+    
+    unsigned int sheetSize = verDimension * horDimension;
+    
+    if(gathersInput())
+        gatherInput();
+    
+    if(pushEpsilon >= 0)
+        findActivePreSynaptic();
+    
+    if(sparsenessRoutine == HEAP) {
+        
+        for(unsigned int first = 0;first < depth * sheetSize;first += horDimension) {
+            #pragma omp task
+            computeNewActivation(first, first + horDimension);
+        }
+        
+        #pragma omp taskwait
+        
+        if(lateralInteraction != NONE) {
+            
+            for(unsigned int first = 0;first < sheetSize;first += horDimension) {
+                #pragma omp task
+                filter(first, first + horDimension);
+            }
+            
+            #pragma omp taskwait
+        }
+        
+        threshold = findThreshold();
+        
+        for(unsigned int first = 0;first < depth * sheetSize;first += horDimension) {
+            #pragma omp task
+            computeNewFiringRate(first, first + horDimension);
+        }
+        
+        #pragma omp taskwait
+    }
+    else if(sparsenessRoutine == GLOBAL) {
+        
+        float cumulativeFiringRate = findCumulativeFiringRate();
+        
+        for(unsigned int first = 0;first < sheetSize;first += horDimension) {
+            #pragma omp task
+            computeGlobalFiringRate(first, first + horDimension, cumulativeFiringRate);
+        }
+        
+        #pragma omp taskwait
+    }
+}
+
+void HiddenRegion::applyLearningRuleTasks() {
+    
+    if(learningRate == 0)
+        return;
+    
+    findLearningPreSynaptic();
+    
+    for(unsigned int first = 0;first < getNrOfNeurons();first += horDimension) {
+        #pragma omp task
+        applyLearningRule(first, first + horDimension);
+    }
+    
+    #pragma omp taskwait
+}
+
+void HiddenRegion::accumulateLearningTasks(unsigned int accumulatedSteps, bool apply) {
+    
+    if(learningRate == 0)
+        return;
+    
+    for(unsigned int first = 0;first < getNrOfNeurons();first += horDimension) {
+        #pragma omp task
+        accumulateLearning(first, first + horDimension, accumulatedSteps == 0);
+    }
+    
+    #pragma omp taskwait
+    
+    if(!apply)
+        return;
+    
+    for(unsigned int first = 0;first < getNrOfNeurons();first += horDimension) {
+        #pragma omp task
+        applyAccumulatedLearning(first, first + horDimension, accumulatedSteps + 1);
+    }
+    
+    #pragma omp taskwait
+}
+
+void HiddenRegion::doTimeStepTasks(bool save) {
+    
+    for(unsigned int first = 0;first < getNrOfNeurons();first += horDimension) {
+        #pragma omp task
+        doTimeStep(first, first + horDimension, save);
+    }
+    
+    #pragma omp taskwait
+    
+    // Save region level data
+    if(save)
+        saveRegionState();
+}
+
+void HiddenRegion::holdTimeStepTasks(bool save) {
+    
+    if(!save)
+        return;
+    
+    for(unsigned int first = 0;first < getNrOfNeurons();first += horDimension) {
+        #pragma omp task
+        holdTimeStep(first, first + horDimension, save);
+    }
+    
+    #pragma omp taskwait
+    
+    saveRegionState();
+}
+
+void HiddenRegion::saveState() {
 	
-    // Update/Save neuron level data
 	for(int d = 0;d < depth;d++)
 		#pragma omp for
 		for(int i = 0;i < verDimension;i++)
     		for(int j = 0;j < horDimension;j++)
-               Neurons[d][i][j].doTimeStep(save);
+               Neurons[d][i][j].saveState(idle);
 	
-    // Save region level data
-	#pragma omp single	
-	{	
-		if(save) {
-			sparsityPercentileValue[regionHistoryCounter] = threshold;
-			regionHistoryCounter++;
-		}
-	}
+	#pragma omp single
+	saveRegionState();
 }
 
 void HiddenRegion::resetTrace() {
@@ -700,7 +2039,7 @@ void HiddenRegion::setupAfferentSynapses(Region & region, WEIGHTNORMALIZATION we
                     
                 postSynapticNeuron.setupAfferentSynapses(region, connectivity, initialWeight, rngController);
     			
-    			if(weightNormalization == CLASSIC)
+    			if(weightNormalization != NONORMALIZATION)
                     postSynapticNeuron.normalize();
             }  
 }
@@ -715,16 +2054,42 @@ void HiddenRegion::outputRegion(BinaryWrite & file) {
 		file << sparsityPercentileValue[t];
 }
 
-// dnavarro2016 convergence returns all afferent synapses
-vector<vector<Synapse>> HiddenRegion::getAllAfferentSyanpsesForCurrentEpoch() {
-    vector<vector<Synapse>> epoch_synapses;
+void HiddenRegion::takeWeightSnapshot() {
+    
+    previousEpochWeights.clear();
     
     for(int d = 0;d < depth;d++)
         for(int i = 0;i < verDimension;i++)
             for(int j = 0;j < horDimension;j++)
-                epoch_synapses.push_back(Neurons[d][i][j].afferentSynapses);
+                for(std::vector<Synapse>::iterator s = Neurons[d][i][j].afferentSynapses.begin(); s != Neurons[d][i][j].afferentSynapses.end();s++)
+                    previousEpochWeights.push_back((*s).weight * Neurons[d][i][j].weightScale);
+}
+
+float HiddenRegion::computeWeightChange() {
+    
+    double sum = 0;
+    unsigned long long int k = 0;
+    
+    // Compare and update reference in the same pass
+    for(int d = 0;d < depth;d++)
+        for(int i = 0;i < verDimension;i++)
+            for(int j = 0;j < horDimension;j++)
+                for(std::vector<Synapse>::iterator s = Neurons[d][i][j].afferentSynapses.begin(); s != Neurons[d][i][j].afferentSynapses.end();s++) {
+                    
+                    if(k == previousEpochWeights.size()) {
+                        
+                        cerr << "No weight snapshot to compare with in region #" << regionNr << endl;
+                        exit(EXIT_FAILURE);
+                    }
+                    
+                    float weight = (*s).weight * Neurons[d][i][j].weightScale;
+                    double diff = weight - previousEpochWeights[k];
+                    sum += diff * diff;
+                    previousEpochWeights[k] = weight;
+                    k++;
+                }
     
-    return epoch_synapses;
+    return k > 0 ? static_cast<float>(sqrt(sum/k)) : 0;
 }
 
 void HiddenRegion::outputNeurons(BinaryWrite & file, DATA data) {
@@ -745,6 +2110,63 @@ void HiddenRegion::outputSingleCells(BinaryWrite & file) {
                     Neurons[d][i][j].output(file, WEIGHT_AND_NEURON_HISTORY);          
 }
 
+void HiddenRegion::outputState(BinaryWrite & file) {
+    
+    // Region level variables
+    file << threshold << regionHistoryCounter << synapseHistoryCounter;
+    
+    // History buffers, neurons hold pointers into these
+    file.writeBuffer(sparsityPercentileValue);
+    file.writeBuffer(activationBuffer);
+    file.writeBuffer(inhibitedActivationHistoryBuffer);
+    file.writeBuffer(firingRateBuffer);
+    file.writeBuffer(traceBuffer);
+    file.writeBuffer(stimulationBuffer);
+    file.writeBuffer(effectiveTraceBuffer);
+    file.writeBuffer(synapseHistoryBuffer);
+    file.writeBuffer(halfSynapseHistoryBuffer);
+    file.writeBuffer(previousEpochWeights);
+    
+    for(int d = 0;d < depth;d++)
+        for(int i = 0;i < verDimension;i++)
+            for(int j = 0;j < horDimension;j++)
+                Neurons[d][i][j].outputState(file);
+}
+
+void HiddenRegion::loadState(BinaryRead & file, const vector<Region *> & regions) {
+    
+    unsigned long long int savedSynapseHistoryCounter;
+    
+    file >> threshold >> regionHistoryCounter >> savedSynapseHistoryCounter;
+    
+    // Buffers cannot be resized, parameter file must be the same
+    // as the one used when checkpoint was made
+    file.readBuffer(sparsityPercentileValue, true);
+    file.readBuffer(activationBuffer, true);
+    file.readBuffer(inhibitedActivationHistoryBuffer, true);
+    file.readBuffer(firingRateBuffer, true);
+    file.readBuffer(traceBuffer, true);
+    file.readBuffer(stimulationBuffer, true);
+    file.readBuffer(effectiveTraceBuffer, true);
+    file.readBuffer(synapseHistoryBuffer, true);
+    file.readBuffer(halfSynapseHistoryBuffer, true);
+    file.readBuffer(previousEpochWeights, false);
+    
+    // Neurons rebuild their synapses, so hand out history slots from scratch
+    synapseHistoryCounter = 0;
+    
+    for(int d = 0;d < depth;d++)
+        for(int i = 0;i < verDimension;i++)
+            for(int j = 0;j < horDimension;j++)
+                Neurons[d][i][j].loadState(file, regions);
+    
+    if(synapseHistoryCounter != savedSynapseHistoryCounter) {
+        
+        cerr << "Synapse history layout of region #" << regionNr << " does not match checkpoint." << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
 float * HiddenRegion::getSynapseHistorySlot() {
     
     // Get the present first unused slot
@@ -767,3 +2189,20 @@ float * HiddenRegion::getSynapseHistorySlot() {
     // Return slot
     return bufferSlot;
 }
+
+// Same slots as getSynapseHistorySlot(), in halfSynapseHistoryBuffer
+bfloat16 * HiddenRegion::getHalfSynapseHistorySlot() {
+    
+    bfloat16 * bufferSlot = &(halfSynapseHistoryBuffer[synapseHistoryCounter]);
+    
+    synapseHistoryCounter += singleSynapseBufferSize;
+    
+    unsigned long long size = halfSynapseHistoryBuffer.size();
+    if(size < synapseHistoryCounter) {
+        
+        cerr << "***>> Could not allocate sufficient synapse history buffer slots, buffer size = " << size << ", failed to get next slot brining buffer to size = " << synapseHistoryCounter << endl;
+        exit(EXIT_FAILURE);
+    }
+    
+    return bufferSlot;
+}
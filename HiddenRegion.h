@@ -11,11 +11,13 @@
 // Forward declarations
 // class Param; forward declaration is not succicient since we need Param enums.
 class BinaryWrite;
+class BinaryRead;
 
 // Includes
 #include "Region.h"
 #include "HiddenNeuron.h"
 #include "Param.h"
+#include "RegionMemory.h"
 #include <vector>
 #include <queue>
 #include <functional>
@@ -29,6 +31,10 @@ using std::greater;
   
 class HiddenRegion : public Region { 
     
+    // Trains interleaved replicas of this region
+    friend class EnsembleRegion;
+    friend class Ensemble;
+    
     public:
 
         // Neurons[depth][rows][col]
@@ -39,13 +45,14 @@ class HiddenRegion : public Region {
         // to avoid memory fragmentation. Perfect respect of 
         // would put the first five in HiddenNeuron class, and
         // the last five in Synapse class.
-        vector<float> activationBuffer;
-        vector<float> inhibitedActivationHistoryBuffer;
-        vector<float> firingRateBuffer;
-        vector<float> traceBuffer;
-        vector<float> stimulationBuffer;
-        vector<float> synapseHistoryBuffer;
-        vector<float> effectiveTraceBuffer;
+        RegionBuffer activationBuffer;
+        RegionBuffer inhibitedActivationHistoryBuffer;
+        RegionBuffer firingRateBuffer;
+        RegionBuffer traceBuffer;
+        RegionBuffer stimulationBuffer;
+        RegionBuffer synapseHistoryBuffer;
+        HalfRegionBuffer halfSynapseHistoryBuffer;  // instead of synapseHistoryBuffer, p.weightPrecision == BF16
+        RegionBuffer effectiveTraceBuffer;
 
 		// Init - instead of ctor
         void init(u_short regionNr, Param & p, bool isTraining, unsigned long int outputtedTimeStepsPerEpoch, u_short samplingRate, u_short desiredFanIn);
@@ -53,14 +60,104 @@ class HiddenRegion : public Region {
         // Destructor
         ~HiddenRegion();
     
-    	// Computes new firing rate by computing activation and doing competition
-    	void computeNewFiringRate();
+        // Neuron range kernels, neuron k is Neurons[d][i][j] with
+        // k = (d * verDimension + i) * horDimension + j. Network splits each
+        // phase over all regions (Network::setupPartition()), ranges of one
+        // phase must not overlap and phases are separated by barriers
+		void computeNewActivation(unsigned int first, unsigned int last);     // HEAP: classic weighted sum of presynaptic firingrates
+		void filter(unsigned int first, unsigned int last);                   // HEAP: first sheet only
+		void computeThreshold();                                              // HEAP: after activation and filter of all neurons
+		void computeNewFiringRate(unsigned int first, unsigned int last);     // HEAP: after threshold
+		void computeGlobalFiringRate(unsigned int first, unsigned int last, float cumulativeFiringRate); // GLOBAL: first sheet only
+		float findCumulativeFiringRate();
+        void applyLearningRule(unsigned int first, unsigned int last);      // gated when p.plasticityThreshold >= 0, or SCALED
+        void setupWeightScales();                                           // SCALED norms of current weights
+        void accumulateLearning(unsigned int first, unsigned int last, bool restart); // p.trainAtTimeStepMultiple > 1
+        void applyAccumulatedLearning(unsigned int first, unsigned int last, unsigned int steps); // after all of accumulateLearning()
+        void doTimeStep(unsigned int first, unsigned int last, bool saveState);
+        void saveRegionState();                                               // region level data, when doTimeStep() saves
+        void holdTimeStep(unsigned int first, unsigned int last, bool saveState); // p.multiRate, step the region skips
     
-        // Update weights of afferent synapses
-        void applyLearningRule();
-    	
-    	// Housekeeping - calls same routine on neurons
-    	void doTimeStep(bool saveState);
+        // Same as above for whole region, but rows are tasks and each call waits
+        // for its own tasks, so they can be called from a task (Network::runObjectAsTasks())
+        void computeNewFiringRateTasks();
+        void applyLearningRuleTasks();
+        void accumulateLearningTasks(unsigned int accumulatedSteps, bool apply);  // accumulatedSteps before this step
+        void doTimeStepTasks(bool saveState);
+        void holdTimeStepTasks(bool saveState);
+    
+        // Save current state to history, as doTimeStep(true) does after the step
+        void saveState();
+    
+        // Layer-wise training: region is not simulated, frozen below a replayed
+        // layer or idle above the trained one. It is still stepped, but saved
+        // history of its neurons and its threshold is NaN, synapse history is kept
+        void setIdle(bool idle) { this->idle = idle; }
+    
+        unsigned int getNrOfNeurons();
+        HiddenNeuron & neuron(unsigned int k);                                // neuron k in range kernel numbering
+    
+        // First touch, by the thread that runs these neurons in Network::setupPartition()
+        void placeHistoryBuffers(unsigned int first, unsigned int last);
+        void placeSynapses(unsigned int first, unsigned int last);              // also fills frozen synapses
+    
+        // Testing: afferent weights are copied into read-only arrays by the next
+        // placeSynapses(), which releases the Synapse objects. A frozen region
+        // can only be run, it is neither trained nor saved
+        void freezeSynapses(Region & region);                                 // region is the one read, for INT8
+    
+        // Frozen weights of source, which must outlive this region, presynaptic
+        // neurons are the same neurons of regions (0 = input) of this network
+        void shareFrozenSynapses(const HiddenRegion & source, const vector<Region *> & regions);
+        bool isFrozen() const { return frozen; }
+        unsigned int getFrozenSynapseSize() const;                            // bytes of weight and presynaptic neuron
+        unsigned int getNrOfAfferentSynapses(unsigned int k);                 // of neuron k, frozen or not
+    
+        // Push propagation (p.pushEpsilon >= 0), and gated learning without
+        // CLASSIC normalization: afferent synapses, frozen or not, transposed
+        // to presynaptic neurons of region. Must be called again when synapses
+        // move, i.e. after placeSynapses(), pruning or freezing
+        void setupEfferentSynapses(Region & region);
+    
+        // Presynaptic neurons firing above p.pushEpsilon, once per time step
+        // before the stimulation of any range is pushed
+        void findActivePreSynaptic();
+    
+        // Share of synapses that carried signal since setupEfferentSynapses(),
+        // and bound on the stimulation dropped from any neuron per time step
+        void reportPushPropagation();
+    
+        // Presynaptic neurons gated learning updates synapses of, once per time
+        // step before any range learns, when it learns through efferent synapses
+        void findLearningPreSynaptic();
+    
+        // Share of neurons and of their synapses that learned since the last call
+        void reportGatedLearning();
+
+        // Drops afferent synapses with |weight| below threshold and, when keep > 0,
+        // all but the keep strongest of each neuron. A neuron keeps at least its
+        // strongest synapse, and is normalised again when it lost any. Synapse
+        // history of survivors moves to the slots a fresh build would give them.
+        // Anything that holds on to synapses must be set up again afterwards
+        void pruneSynapses(float threshold, u_short keep);
+
+        // p.sortSynapses: afferent synapses of each neuron ordered by presynaptic
+        // region and neuron, so gathers of presynaptic firing rates run forward.
+        // History slots are handed out again, only before any history is saved
+        void sortAfferentSynapses();
+    
+        // INT8 and BF16 frozen weights: firing rates of the region read, before
+        // stimulation in every step. Then the difference of int8 and float stimulation since
+        bool isQuantized() const { return frozen && quantizedFrozenWeights; }
+        bool gathersInput() const { return frozen && (quantizedFrozenWeights || halfFrozenWeights); }
+        void gatherInput();
+        void reportQuantization();
+    
+        // Learning every p.trainAtTimeStepMultiple steps: sums of presynaptic
+        // neurons of region, which must be the only one read, start afresh.
+        // Then the difference of batched and per-step weight changes since
+        void setupAccumulatedLearning(Region & region);
+        void reportAccumulatedLearning();
     	
     	// Build
     	void setupAfferentSynapses(Region & region, 
@@ -71,11 +168,18 @@ class HiddenRegion : public Region {
 
     	// Output routines	
         void outputRegion(BinaryWrite & sparsityPercentileValueFile);
-        // dnavarro2016 convergence
-        vector<vector<Synapse>> getAllAfferentSyanpsesForCurrentEpoch();
         void outputNeurons(BinaryWrite & file, DATA data);
         void outputSingleCells(BinaryWrite & file);
     
+        // Weight convergence: RMS change of all afferent weights since
+        // last call (or snapshot), and the current weights become the new reference
+        void takeWeightSnapshot();
+        float computeWeightChange();
+    
+        // Checkpointing
+        void outputState(BinaryWrite & file);
+        void loadState(BinaryRead & file, const vector<Region *> & regions);
+    
 		void resetTrace();
 		void clearState(bool resetTrace);
 		
@@ -84,6 +188,7 @@ class HiddenRegion : public Region {
     
         // Synapse history buffer
         float * getSynapseHistorySlot();
+        bfloat16 * getHalfSynapseHistorySlot();
 		
     private:
 
@@ -117,8 +222,10 @@ class HiddenRegion : public Region {
 		float eta;										// duplicate of p.etas[regionNr-1]
 		float timeConstant;								// duplicate of p.timeConstants[regionNr-1]
         float covarianceThreshold;
-		double stepSize;
+		double stepSize;                                // p.stepSize times p.stepMultiples[regionNr-1]
 		float traceTimeConstant;
+        double activationFactor;                        // share of the way to steady state per step, stepSize/timeConstant for EULER
+        double traceFactor;                             // same for trace
         float globalInhibitoryConstant;
         float externalStimulation;
     
@@ -139,16 +246,139 @@ class HiddenRegion : public Region {
         // Lateral Interaction
 		u_short filterCenter;
 		void setupFilters();
-		void filter();
-		void computeNewActivation();					// classic weighted sum of presynaptic firingrates
+    
+        // Position of neuron k in range kernel numbering
+        void position(unsigned int k, int & d, int & i, int & j);
         u_short wrap(int x, u_short d);
         
+        // Frozen afferent synapses of neuron k are [frozenStart[k], frozenStart[k+1]),
+        // weight and presynaptic neuron only, 12 bytes instead of a Synapse.
+        // Weights are in frozenWeights, or of the region they are shared with.
+        // With p.weightPrecision == BF16 they are bfloat16 in frozenHalfWeights
+        // instead, and presynaptic neurons are indices into frozenInput, the firing
+        // rates of frozenInputRegion made by gatherInput(), 6 bytes. Push
+        // propagation keeps float weights, efferent synapses point at them
+        bool idle;
+        bool frozen;
+        bool halfFrozenWeights;
+        vector<unsigned long long> frozenStart;
+        RegionBuffer frozenWeights;
+        const float * frozenWeight;
+        HalfRegionBuffer frozenHalfWeights;
+        const bfloat16 * frozenHalfWeight;
+        vector<const Neuron *, RegionAllocator<const Neuron *> > frozenPreSynaptic;
+    
+        // With p.weightPrecision == INT8 a frozen synapse is an int8 weight, times
+        // the scale of its neuron, and the index of its presynaptic neuron in
+        // quantizedInput, 5 bytes. quantizedInput holds the firing rates of
+        // frozenInputRegion as 0..127 times inputScale, made by gatherInput().
+        // frozenDenseStart[k] is the first index when neuron k reads consecutive
+        // neurons, so a plain dot product, -1 otherwise. Every sampleStride-th
+        // neuron also keeps its float weights, see reportQuantization()
+        bool quantizedFrozenWeights;
+        const Region * frozenInputRegion;
+        vector<const Neuron *> frozenInputNeuron;
+        vector<unsigned char, RegionAllocator<unsigned char> > quantizedInput;
+        vector<float> frozenInput;
+        float inputScale;
+        vector<signed char, RegionAllocator<signed char> > frozenQuantizedWeights;
+        const signed char * frozenQuantizedWeight;
+        vector<unsigned int, RegionAllocator<unsigned int> > frozenPreSynapticIndices;
+        const unsigned int * frozenPreSynapticIndex;
+        vector<float> frozenQuantizedScale;
+        vector<long long> frozenDenseStart;
+        vector<unsigned long long> quantizationSampleStart;
+        vector<float> quantizationSampleWeight;
+        double quantizationDifference, quantizationReference;
+        void setupFrozenInput(Region & region);
+        void placeQuantizedSynapses(unsigned int k);
+        float quantizedStimulation(unsigned int k);
+    
+        // Efferent synapses of presynaptic neuron p are [efferentStart[p], efferentStart[p+1]),
+        // in order of postsynaptic neuron, so the synapses into neurons [first, last)
+        // are a contiguous piece of each list. Presynaptic neurons are numbered as
+        // neurons here, efferentNeuron[p] is NULL when p has no efferent synapses.
+        // activePreSynaptic holds those firing above epsilon and their firing rates
+        struct Efferent {
+            float * weight;                 // only written by learning, frozen regions do not learn
+            unsigned int postSynaptic;
+        };
+        float pushEpsilon;
+        vector<const Neuron *> efferentNeuron;
+        vector<unsigned long long> efferentStart;
+        vector<Efferent> efferents;
+        vector<unsigned int> activePreSynaptic;
+        vector<float> activeFiringRate;
+        RegionBuffer pushedStimulation;
+        unsigned long long pushedSynapses;
+        unsigned long long pushableSynapses;
+        void pushStimulation(unsigned int first, unsigned int last);      // into pushedStimulation[first, last)
+    
+        // Gated learning (p.plasticityThreshold >= 0), see applyGatedLearningRule(),
+        // a neuron that learned last step was normalised with its norm before
+        // the update, so it is normalised once more when it stops learning.
+        // Without CLASSIC normalization synapses are updated through the efferent
+        // lists of learningPreSynaptic, with the weight change of each neuron
+        // before the presynaptic factor in learningStep, in steps where fewer
+        // efferent synapses pass the gate than neurons that learned last step
+        // have afferent ones (efferentLearning), see applyEfferentLearningRule()
+        float plasticityThreshold;
+        vector<char> learnedLastStep;
+        unsigned long long learningNeurons, learnedNeurons;
+        unsigned long long learningSynapses, learnedSynapses;
+        vector<unsigned int> learningPreSynaptic;
+        vector<float> learningFiringRate;
+        vector<float> learningStep;
+        vector<double> normChange;
+        bool efferentLearning;
+        bool learnsEfferent() const;
+        void applyGatedLearningRule(unsigned int first, unsigned int last);
+        void applyEfferentLearningRule(unsigned int first, unsigned int last);
+        unsigned long long applyScaledLearningRule(HiddenNeuron * n, float post);
+    
+        // Learning every p.trainAtTimeStepMultiple steps, see accumulateLearning().
+        // Presynaptic neurons are numbered as neurons of their region, a sum is
+        // of firing rates, or for COVARIANCE of steps above covarianceThreshold.
+        // Every sampleStride-th neuron also sums exact per-step weight changes,
+        // which give the difference reported by reportAccumulatedLearning()
+        u_short trainAtTimeStepMultiple;
+        unsigned int preSynapticVerDimension, preSynapticHorDimension;
+        vector<const Neuron *> accumulatedNeuron;
+        RegionBuffer preSynapticSum;
+        RegionBuffer postSynapticSum;
+        static const unsigned int sampleStride = 64;
+        vector<unsigned long long> sampleStart;
+        vector<float> sampleSum;
+        double sampledDifference, sampledChange;
+    
+        // Afferent weights at end of last epoch, in neuron/synapse order
+        vector<float> previousEpochWeights;
+    
         // Synapse history pointer
         unsigned long long int synapseHistoryCounter;
         unsigned long long int singleSynapseBufferSize;
 };
 
 
+inline unsigned int HiddenRegion::getNrOfNeurons() {
+    return depth * verDimension * horDimension;
+}
+
+inline HiddenNeuron & HiddenRegion::neuron(unsigned int k) {
+    return Neurons[k / (verDimension * horDimension)][(k / horDimension) % verDimension][k % horDimension];
+}
+
+inline unsigned int HiddenRegion::getNrOfAfferentSynapses(unsigned int k) {
+    return frozen ? frozenStart[k+1] - frozenStart[k] : neuron(k).afferentSynapses.size();
+}
+
+inline void HiddenRegion::position(unsigned int k, int & d, int & i, int & j) {
+    
+    d = k / (verDimension * horDimension);
+    i = (k / horDimension) % verDimension;
+    j = k % horDimension;
+}
+
 inline u_short HiddenRegion::wrap(int x, u_short d) {
     
 	// One cannot trust result of (x % b) with negative
@@ -132,6 +132,22 @@ void InputNeuron::setFiringRate(const vector<float> & sample) {
     this->newFiringRate = this->firingRate;
 }
 
+bool InputNeuron::respondsAs(const InputNeuron & other) const {
+    
+    if(responseFunction != other.responseFunction ||
+       horVisualPreference != other.horVisualPreference ||
+       horEyePositionPreference != other.horEyePositionPreference ||
+       horEyePositionSigmoidSlope != other.horEyePositionSigmoidSlope ||
+       horVisualSigma != other.horVisualSigma)
+        return false;
+    
+    // Second peak is only set up for double gaussians
+    if(responseFunction == MULTIMODAL_DOUBLEGAUSS_MODULATION)
+        return horEyePositionPreference2 == other.horEyePositionPreference2 && peak2Magnitude == other.peak2Magnitude;
+    
+    return true;
+}
+
 float InputNeuron::computeRetinalComponent(const vector<float> & sample) {
     
     float component = 0;
@@ -55,6 +55,9 @@ class InputNeuron : public Neuron {
     
         void setFiringRate(const vector<float> & sample);
     
+        // Same firing rate for any sample
+        bool respondsAs(const InputNeuron & other) const;
+    
 };
 
 #endif // INPUTNEURON_H
@@ -18,6 +18,7 @@
 #include <iomanip>
 #include <cstdlib>
 #include <cstring>
+#include <climits>
 #include "Utilities.h"
 
 #include <vector>
@@ -38,6 +39,53 @@ void InputRegion::init(Param & p, const char * dataFile, gsl_rng * rngController
 
     // No call to region.init()
     
+    this->data = &loadedData;
+    this->frames = NULL;
+    
+    setupPreferences(p);
+    
+    // Load data if it is provided, otherwise there are no time steps
+	if(dataFile != NULL)
+        loadDataFile(dataFile);
+    else
+        this->nrOfObjects = 0;
+    
+    computeTimeSteps(p.stepSize, p.outputAtTimeStepMultiple);
+    
+    setupNeurons(p, rngController);
+}
+
+void InputRegion::init(Param & p, const InputRegion & source, gsl_rng * rngController) {
+    
+    this->data = source.data;
+    this->frames = NULL;
+    
+    setupPreferences(p);
+    
+    // Same check as when reading data file
+    if(source.horVisualFieldSize != this->horVisualFieldSize || source.horEyePositionFieldSize != this->horEyePositionFieldSize) {
+        
+        cerr << "Visual field or eye movement field is not the same as in shared input:" << source.horVisualFieldSize << "!=" << this->horVisualFieldSize << " || " <<  source.horEyePositionFieldSize << " != " << this->horEyePositionFieldSize << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    // Header of data file
+    this->samplingRate = source.samplingRate;
+    this->numberOfSimultanousObjects = source.numberOfSimultanousObjects;
+    this->interSampleTime = source.interSampleTime;
+    this->nrOfObjects = source.nrOfObjects;
+    this->stimuliSamplesInObject = source.stimuliSamplesInObject;
+    this->objectDuration = source.objectDuration;
+    
+    // Step size may differ
+    computeTimeSteps(p.stepSize, p.outputAtTimeStepMultiple);
+    
+    setupNeurons(p, rngController);
+}
+
+void InputRegion::setupPreferences(Param & p) {
+    
     // Compute and populate preference vectors
     centerDistance(horVisualPreferences, p.horVisualFieldSize, p.visualPreferenceDistance);
     centerDistance(horEyePreferences, p.horEyePositionFieldSize, p.eyePositionPrefrerenceDistance);
@@ -59,10 +107,9 @@ void InputRegion::init(Param & p, const char * dataFile, gsl_rng * rngController
     this->horDimension = this->horEyeDimension;
     this->horVisualFieldSize = p.horVisualFieldSize;
     this->horEyePositionFieldSize = p.horEyePositionFieldSize;
-    
-    // Load data if it is provided
-	if(dataFile != NULL)
-        loadDataFile(dataFile, p.stepSize, p.outputAtTimeStepMultiple);
+}
+
+void InputRegion::setupNeurons(Param & p, gsl_rng * rngController) {
     
     // Space for sample
     sample.resize(1 + numberOfSimultanousObjects); // Do not put above loadDataFile
@@ -87,7 +134,8 @@ void InputRegion::init(Param & p, const char * dataFile, gsl_rng * rngController
 
 InputRegion::~InputRegion() {
     Neurons.clear();
-	data.clear();
+	loadedData.clear();
+    computedFrames.clear();
 }
 
 /*
@@ -121,16 +169,13 @@ void InputRegion::centerDistance(vector<float> & v, float width, float distance)
     //cerr << "\n\n";
 }
 
-void InputRegion::loadDataFile(const char * dataFile, float stepSize, u_short outputAtTimeStepMultiple) {
+void InputRegion::loadDataFile(const char * dataFile) {
     
     // Open file
     BinaryRead file(dataFile);
 
     // Initialize som variables we will be working with
     this->nrOfObjects = 0;
-    this->outputtedTimeStepsPerEpoch = 0;
-    this->timeStepsPerEpoch = 0;
-    this->epochDuration = 0;
     
     bool readAFullSample = false;
     bool readHeader = false;
@@ -168,7 +213,7 @@ void InputRegion::loadDataFile(const char * dataFile, float stepSize, u_short ou
                 cout << "Loaded object " << nrOfObjects << endl;
                 
                 // Save sample vector
-                data.push_back(objectData);
+                loadedData.push_back(objectData);
                 
                 // Clear sample variable
                 objectData.clear();
@@ -180,23 +225,6 @@ void InputRegion::loadDataFile(const char * dataFile, float stepSize, u_short ou
                 double duration = interSampleTime * objectSamples;
                 this->objectDuration.push_back(duration);
                 
-                // Increase epoch duration
-                epochDuration += duration;
-                
-                // Save number of timesteps in object
-                unsigned long int timeStepsInObject = (unsigned)(duration / stepSize);
-                this->timeStepsInObject.push_back(timeStepsInObject);
-                
-                // Increase total duration of epoch
-                this->timeStepsPerEpoch += timeStepsInObject;
-                
-                // Save number timesteps in object that will be outputted
-                unsigned long int outputtedTimeSteps = timeStepsInObject / outputAtTimeStepMultiple;
-                this->outputtedTimeStepsInObject.push_back(outputtedTimeSteps);
-                 
-                //Increase total number of outputted timestepds
-                outputtedTimeStepsPerEpoch += outputtedTimeSteps;
-                
                 // Increase number of objects
                 nrOfObjects++;
                 
@@ -248,6 +276,116 @@ void InputRegion::loadDataFile(const char * dataFile, float stepSize, u_short ou
     }
 }
 
+bool InputRegion::checkDataFile(const char * dataFile, string & problem) const {
+    
+    ifstream file(dataFile, std::ios_base::in | std::ios_base::binary);
+    ostringstream reason;
+    
+    if(!file) {
+        
+        reason << "unable to open data file " << dataFile << ": " << strerror(errno);
+        problem = reason.str();
+        return false;
+    }
+    
+    // Header, as loadDataFile() reads it
+    u_short rate, objects;
+    float v, e;
+    
+    if(!file.read(reinterpret_cast<char*>(&rate), sizeof(rate)) || !file.read(reinterpret_cast<char*>(&objects), sizeof(objects)) ||
+       !file.read(reinterpret_cast<char*>(&v), sizeof(v)) || !file.read(reinterpret_cast<char*>(&e), sizeof(e))) {
+        
+        problem = "unable to read header of data file";
+        return false;
+    }
+    
+    if(rate == 0) {
+        
+        problem = "sampling rate of data file is 0";
+        return false;
+    }
+    
+    if(v != horVisualFieldSize || e != horEyePositionFieldSize) {
+        
+        reason << "visual field or eye movement field is not the same as in data file: " << v << " != " << horVisualFieldSize << " || " << e << " != " << horEyePositionFieldSize;
+        problem = reason.str();
+        return false;
+    }
+    
+    double sampleTime = (float)1/rate;
+    unsigned long samples = 0, nrOfObjects = 0;
+    
+    while(file.read(reinterpret_cast<char*>(&e), sizeof(e))) {
+        
+        if(!std::isnan(e)) {
+            
+            for(int i = 0;i < objects;i++)
+                if(!file.read(reinterpret_cast<char*>(&v), sizeof(v))) {
+                    
+                    problem = "data file ends inside a sample";
+                    return false;
+                }
+            
+            samples++;
+            continue;
+        }
+        
+        // Last time step of the object must be inside the data, as in linearInterpolate()
+        unsigned long int steps = (unsigned)(sampleTime * samples / stepSize);
+        
+        if(steps > 0 && (unsigned long long)(int)floor((double)((steps - 1) * stepSize) * rate) >= samples) {
+            
+            reason << "time steps of object #" << nrOfObjects << " are outside of its data";
+            problem = reason.str();
+            return false;
+        }
+        
+        nrOfObjects++;
+        samples = 0;
+    }
+    
+    if(nrOfObjects == 0 || nrOfObjects > USHRT_MAX) {
+        
+        reason << "data file has " << nrOfObjects << " objects";
+        problem = reason.str();
+        return false;
+    }
+    
+    return true;
+}
+
+void InputRegion::computeTimeSteps(float stepSize, u_short outputAtTimeStepMultiple) {
+    
+    this->stepSize = stepSize;
+    this->outputtedTimeStepsPerEpoch = 0;
+    this->timeStepsPerEpoch = 0;
+    this->epochDuration = 0;
+    this->timeStepsInObject.clear();
+    this->outputtedTimeStepsInObject.clear();
+    
+    for(u_short o = 0;o < nrOfObjects;o++) {
+        
+        double duration = objectDuration[o];
+        
+        // Increase epoch duration
+        epochDuration += duration;
+        
+        // Save number of timesteps in object
+        unsigned long int timeStepsInObject = (unsigned)(duration / stepSize);
+        this->timeStepsInObject.push_back(timeStepsInObject);
+        
+        // Increase total duration of epoch
+        this->timeStepsPerEpoch += timeStepsInObject;
+        
+        // Save number timesteps in object that will be outputted
+        unsigned long int outputtedTimeSteps = timeStepsInObject / outputAtTimeStepMultiple;
+        this->outputtedTimeStepsInObject.push_back(outputtedTimeSteps);
+        
+        //Increase total number of outputted timestepds
+        outputtedTimeStepsPerEpoch += outputtedTimeSteps;
+    }
+}
+
 /*
 // Normalized scheme!
 void InputRegion::setFiringRate(u_short object, float time) {
@@ -286,7 +424,19 @@ void InputRegion::setFiringRate(u_short object, float time) {
 #include <fstream>
 
 // Classic
-void InputRegion::setFiringRate(u_short object, double time) {
+void InputRegion::setFiringRate(u_short object, unsigned long int timeStep) {
+    
+    if(frames != NULL) {
+        
+        for(int d = 0;d < depth;d++)
+            #pragma omp for
+            for(int i = 0;i < horVisualDimension;i++)
+                setFiringRate(object, timeStep, d, i);
+        
+        return;
+    }
+    
+    double time = timeStep * stepSize;
     
     /*
     #pragma omp single
@@ -332,8 +482,101 @@ void InputRegion::setFiringRate(u_short object, double time) {
 	for(int d = 0;d < depth;d++)
         #pragma omp for // we moved pragma one step in because SMI model has so small depth
 		for(int i = 0;i < horVisualDimension;i++)
-			for(int j = 0;j < horEyeDimension;j++)
-				Neurons[d][i][j].setFiringRate(sample);
+			setFiringRate(object, timeStep, d, i);
+}
+
+void InputRegion::setFiringRate(u_short object, unsigned long int timeStep, int d, int i) {
+    
+    if(frames != NULL) {
+        
+        const float * frame = &(*frames)[object][timeStep * depth * horVisualDimension * horEyeDimension];
+        
+        for(int j = 0;j < horEyeDimension;j++) {
+            
+            float firingRate = frame[(d * horVisualDimension + i) * horEyeDimension + j];
+            
+            Neurons[d][i][j].firingRate = firingRate;
+            Neurons[d][i][j].newFiringRate = firingRate;
+        }
+        
+    } else
+        for(int j = 0;j < horEyeDimension;j++)
+            Neurons[d][i][j].setFiringRate(sample);
+}
+
+void InputRegion::setFiringRateTasks(u_short object, unsigned long int timeStep) {
+    
+    if(frames == NULL) {
+        
+        double time = timeStep * stepSize;
+        linearInterpolate(object, time);
+    }
+    
+    for(int d = 0;d < depth;d++)
+        for(int i = 0;i < horVisualDimension;i++) {
+            #pragma omp task
+            setFiringRate(object, timeStep, d, i);
+        }
+    
+    #pragma omp taskwait
+}
+
+bool InputRegion::respondsAs(const InputRegion & other) const {
+    
+    if(data != other.data || stepSize != other.stepSize || depth != other.depth || horVisualDimension != other.horVisualDimension || horEyeDimension != other.horEyeDimension)
+        return false;
+    
+    for(int d = 0;d < depth;d++)
+        for(int i = 0;i < horVisualDimension;i++)
+            for(int j = 0;j < horEyeDimension;j++)
+                if(!Neurons[d][i][j].respondsAs(other.Neurons[d][i][j]))
+                    return false;
+    
+    return true;
+}
+
+void InputRegion::precomputeFrames() {
+    
+    unsigned long int frameSize = depth * horVisualDimension * horEyeDimension;
+    
+    computedFrames.resize(nrOfObjects);
+    
+    for(u_short o = 0;o < nrOfObjects;o++) {
+        
+        computedFrames[o].resize(timeStepsInObject[o] * frameSize);
+        
+        for(unsigned long int t = 0;t < timeStepsInObject[o];t++) {
+            
+            // Same time as in setFiringRate()
+            linearInterpolate(o, t * stepSize);
+            
+            float * frame = &computedFrames[o][t * frameSize];
+            
+            for(int d = 0;d < depth;d++)
+                for(int i = 0;i < horVisualDimension;i++)
+                    for(int j = 0;j < horEyeDimension;j++) {
+                        
+                        Neurons[d][i][j].setFiringRate(sample);
+                        frame[(d * horVisualDimension + i) * horEyeDimension + j] = Neurons[d][i][j].firingRate;
+                    }
+        }
+    }
+    
+    frames = &computedFrames;
+    
+    cout << "Precomputed " << timeStepsPerEpoch << " input frames (" << (timeStepsPerEpoch * frameSize * sizeof(float)) / (1024*1024) << " MB)." << endl;
+}
+
+void InputRegion::useFramesOf(const InputRegion & other) {
+    
+    if(other.frames == NULL || !respondsAs(other)) {
+        
+        cerr << "Input frames can only be shared among identical input regions." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    frames = other.frames;
 }
 
 void InputRegion::linearInterpolate(u_short object, double time) {
@@ -342,12 +585,12 @@ void InputRegion::linearInterpolate(u_short object, double time) {
     unsigned long long sampleIndex = (int)floor(time * samplingRate); 
     
     // Test that there is one more data point
-    if(!(data[object].size() > sampleIndex)) {
+    if(!((*data)[object].size() > sampleIndex)) {
         
-        cerr << "Time is outside of recorded data: time=" << time << ", sampleIndex=" << sampleIndex << ", size=" << data[object].size() << endl;
+        cerr << "Time is outside of recorded data: time=" << time << ", sampleIndex=" << sampleIndex << ", size=" << (*data)[object].size() << endl;
         cerr.flush();
         exit(EXIT_FAILURE);
-        //sampleIndex = data[object].size() - 1; // JUST PUT IN LAST SAMPLE
+        //sampleIndex = (*data)[object].size() - 1; // JUST PUT IN LAST SAMPLE
     }
     
     // Time between 
@@ -362,17 +605,17 @@ void InputRegion::linearInterpolate(u_short object, double time) {
     // Interpolate for each data point in sample
     for(unsigned i = 0;i < sample.size();i++){
         
-        if(data[object].size() == sampleIndex + 1) {
+        if((*data)[object].size() == sampleIndex + 1) {
             
             // if we are on last sample, just use it, no interpolation possible
-            val = data[object][sampleIndex][i];
+            val = (*data)[object][sampleIndex][i];
             
         } else { 
             
             // use linear interpolation otherwise,
-            double dy = data[object][sampleIndex + 1][i] - data[object][sampleIndex][i];
+            double dy = (*data)[object][sampleIndex + 1][i] - (*data)[object][sampleIndex][i];
             double slope = dy/interSampleTime;
-            double intercept = data[object][sampleIndex][i];
+            double intercept = (*data)[object][sampleIndex][i];
             
             val = intercept + slope * interSampleOverflow;
         }
@@ -26,14 +26,33 @@ using std::string;
 class InputRegion : public Region {
 	
 	private:
-		vector<vector<vector<float> > > data; // data[object][sample][0 1 .... numberOfSimultanousObjects]
+        // data[object][sample][0 1 .... numberOfSimultanousObjects], points to
+        // loadedData, or to the data of the region this one was initialized from
+		const vector<vector<vector<float> > > * data;
+		vector<vector<vector<float> > > loadedData;
+    
+        // Optional precomputed firing rates, frames[object][timeStep * #neurons + neuron],
+        // points to computedFrames, or to those of a region with identical input neurons
+        const vector<vector<float> > * frames;
+        vector<vector<float> > computedFrames;
     
         vector<float> sample;
         vector<u_short> stimuliSamplesInObject;
         vector<double> objectDuration;
+        float stepSize;
+    
+        // Shared part of init()
+        void setupPreferences(Param & p);
+        void setupNeurons(Param & p, gsl_rng * rngController);
         
         // Load file names from file list
-        void loadDataFile(const char * dataFile, float stepSize, u_short outputAtTimeStepMultiple);
+        void loadDataFile(const char * dataFile);
+    
+        // Derive time step counts from object durations
+        void computeTimeSteps(float stepSize, u_short outputAtTimeStepMultiple);
+    
+        // Row i of sheet d, interpolated sample must be ready
+        void setFiringRate(u_short object, unsigned long int timeStep, int d, int i);
     
         // Get data by interpolating from loaded data
         void linearInterpolate(u_short object, double time);
@@ -73,9 +92,24 @@ class InputRegion : public Region {
         
 		// Init
 		void init(Param & p, const char * dataFile, gsl_rng * rngController);
+    
+        // Init without rereading data file, data of source is shared and must outlive this region
+        void init(Param & p, const InputRegion & source, gsl_rng * rngController);
+
+        // Checks dataFile as init() would read it with the parameters of this region,
+        // false and the reason if it would end the process, see Server
+        bool checkDataFile(const char * dataFile, string & problem) const;
 
-		// Load switch content from buffer
-        void setFiringRate(u_short object, double time);
+		// Load switch content from buffer, or copy it from precomputed frame
+        void setFiringRate(u_short object, unsigned long int timeStep);
+    
+        // Same, with rows as tasks, returns when they are done (Network::runObjectAsTasks())
+        void setFiringRateTasks(u_short object, unsigned long int timeStep);
+    
+        // Precomputed frames, only worth it when shared by several networks (sweep)
+        bool respondsAs(const InputRegion & other) const;
+        void precomputeFrames();
+        void useFramesOf(const InputRegion & other);
 	
         Neuron * getNeuron(u_short depth, u_short row, u_short col);
 };
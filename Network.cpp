@@ -11,6 +11,7 @@
 #include "InputRegion.h"
 #include "BinaryRead.h"
 #include "BinaryWrite.h"
+#include "Synapse.h"
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
@@ -20,6 +21,9 @@
 #include <cmath>
 #include <iomanip>
 #include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <algorithm>
 #include "Utilities.h"
 
 #ifdef OMP_ENABLE
@@ -29,6 +33,10 @@
 #define U_SHORT_1 static_cast<u_short>(1)
 #define U_SHORT_0 static_cast<u_short>(0)
 
+// Checkpoint file identification
+#define CHECKPOINT_MAGIC 0x534D4943 // "SMIC"
+#define CHECKPOINT_VERSION static_cast<u_short>(5)
+
 using std::cerr;
 using std::cout;
 using std::cin;
@@ -39,13 +47,61 @@ using std::stringstream;
 using std::setw;
 using std::left;
 
+// Thread number and team size, without OpenMP there is one thread
+static int threadNumber() {
+#ifdef OMP_ENABLE
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+static int teamSize() {
+#ifdef OMP_ENABLE
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+static int maxThreads() {
+#ifdef OMP_ENABLE
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Set by signal handler, only polled between time steps in runContinous()
+static volatile sig_atomic_t checkpointRequested = 0;
+
+// Training runs in progress, handlers stay installed until the last one of a sweep is done
+static int trainingRuns = 0;
+
+static void requestCheckpoint(int) {
+    checkpointRequested = 1;
+}
+
 // Do not use this constructor if you intend to train later, use the one
 // below, if constructors where named then this amgibuity could have been
 // avoided
 Network::Network(const char * parameterFile, bool verbose) :
 verbose(verbose),
 p(parameterFile, false),
-ESPathway(p.dimensions.size()) {
+resuming(false),
+startEpoch(0),
+startObject(0),
+startTimeStep(0),
+partitionThreads(0),
+trainedLayer(-1),
+recordingLayer(false),
+replayingLayer(false),
+layerCached(false),
+ESPathway(p.dimensions.size()),
+interrupted(false),
+checkpointDue(false),
+converged(false),
+epochsCompleted(0) {
     
     // Seed random number generator
     rngController = gsl_rng_alloc(gsl_rng_taus);	// Setup GSL RNG with seed
@@ -75,13 +131,84 @@ ESPathway(p.dimensions.size()) {
     for(u_short i = 1;i < ESPathway.size();i++)
         ESPathway[i].setupAfferentSynapses(ESPathway[i - 1], p.weightNormalization, p.connectivities[i - 1], p.initialWeight, rngController);
     
+    if(p.sortSynapses)
+        for(u_short i = 0;i < ESPathway.size();i++)
+            ESPathway[i].sortAfferentSynapses();
+    
     gsl_rng_free(rngController);
 }
 
-Network::Network(const char * dataFile, const char * parameterFile, bool verbose, const char * inputWeightFile, bool isTraining) :
+Network::Network(const char * dataFile, const char * parameterFile, bool verbose, const char * inputWeightFile, bool isTraining, const libconfig::Setting * overrides) :
+verbose(verbose),
+p(parameterFile, isTraining, overrides),
+resuming(false),
+startEpoch(0),
+startObject(0),
+startTimeStep(0),
+partitionThreads(0),
+trainedLayer(-1),
+recordingLayer(false),
+replayingLayer(false),
+layerCached(false),
+ESPathway(p.dimensions.size()),
+interrupted(false),
+checkpointDue(false),
+converged(false),
+epochsCompleted(0) {
+    
+    // Seed random number generator
+    rngController = gsl_rng_alloc(gsl_rng_taus);
+    gsl_rng_set(rngController, p.seed);
+    
+    area7a.init(p, dataFile, rngController);
+    
+    loadNetwork(inputWeightFile, isTraining);
+}
+
+Network::Network(const InputRegion & sharedInput, const char * parameterFile, bool verbose, const char * inputWeightFile, bool isTraining, const libconfig::Setting * overrides) :
 verbose(verbose),
-p(parameterFile, isTraining),
-ESPathway(p.dimensions.size()) {
+p(parameterFile, isTraining, overrides),
+resuming(false),
+startEpoch(0),
+startObject(0),
+startTimeStep(0),
+partitionThreads(0),
+trainedLayer(-1),
+recordingLayer(false),
+replayingLayer(false),
+layerCached(false),
+ESPathway(p.dimensions.size()),
+interrupted(false),
+checkpointDue(false),
+converged(false),
+epochsCompleted(0) {
+    
+    // Seed random number generator
+    rngController = gsl_rng_alloc(gsl_rng_taus);
+    gsl_rng_set(rngController, p.seed);
+    
+    area7a.init(p, sharedInput, rngController);
+    
+    loadNetwork(inputWeightFile, isTraining);
+}
+
+Network::Network(const char * dataFile, const Network & trained) :
+verbose(trained.verbose),
+p(trained.p),
+resuming(false),
+startEpoch(0),
+startObject(0),
+startTimeStep(0),
+partitionThreads(0),
+trainedLayer(-1),
+recordingLayer(false),
+replayingLayer(false),
+layerCached(false),
+ESPathway(p.dimensions.size()),
+interrupted(false),
+checkpointDue(false),
+converged(false),
+epochsCompleted(0) {
     
     // Seed random number generator
     rngController = gsl_rng_alloc(gsl_rng_taus);
@@ -89,6 +216,41 @@ ESPathway(p.dimensions.size()) {
     
     area7a.init(p, dataFile, rngController);
     
+    initRegions(false);
+    
+    vector<Region *> regions;
+    regions.push_back(&area7a);
+    for(u_short k = 0;k < ESPathway.size();k++)
+        regions.push_back(&ESPathway[k]);
+    
+    for(u_short k = 0;k < ESPathway.size();k++)
+        ESPathway[k].shareFrozenSynapses(trained.ESPathway[k], regions);
+    
+    setupPartition(maxThreads());
+    placeRegionMemory();
+}
+
+void Network::initRegions(bool isTraining) {
+    
+    for(u_short i = 0;i < ESPathway.size();i++) {
+        
+        
+        Region & r = (i == 0) ? static_cast<Region&>(area7a) : static_cast<Region&>(ESPathway[i-1]);
+        u_short desiredFanIn = r.depth * r.verDimension * r.horDimension; // 2 * = both signs, (((i == 0) ? 2 : 1) *
+        
+        if(p.connectivities[i] == SPARSE)
+            desiredFanIn *= p.fanInCountPercentage[i];
+        else if(p.connectivities[i] == SPARSE_BIASED)
+            desiredFanIn *= (p.fanInCountPercentage[i]/r.verDimension);
+        
+        cout << "Layer " << i+1 << " desiredFanIn: " << desiredFanIn << " << AS READ FROM PARAMTER FILE, MAY NOT HOLD!!!" << endl;
+        
+        ESPathway[i].init(i+1, p, isTraining, area7a.outputtedTimeStepsPerEpoch, area7a.samplingRate, desiredFanIn);
+    }
+}
+
+void Network::loadNetwork(const char * inputWeightFile, bool isTraining) {
+    
     BinaryRead weightFile(inputWeightFile);
     
     // Read number of regions and list of dimensions
@@ -124,22 +286,7 @@ ESPathway(p.dimensions.size()) {
         exit(EXIT_FAILURE);
     }
     
-    // Init regions
-    for(u_short i = 0;i < ESPathway.size();i++) {
-        
-        
-        Region & r = (i == 0) ? static_cast<Region&>(area7a) : static_cast<Region&>(ESPathway[i-1]);
-        u_short desiredFanIn = r.depth * r.verDimension * r.horDimension; // 2 * = both signs, (((i == 0) ? 2 : 1) *
-        
-        if(p.connectivities[i] == SPARSE)
-            desiredFanIn *= p.fanInCountPercentage[i];
-        else if(p.connectivities[i] == SPARSE_BIASED)
-            desiredFanIn *= (p.fanInCountPercentage[i]/r.verDimension);
-        
-        cout << "Layer " << i+1 << " desiredFanIn: " << desiredFanIn << " << AS READ FROM PARAMTER FILE, MAY NOT HOLD!!!" << endl;
-        
-        ESPathway[i].init(i+1, p, isTraining, area7a.outputtedTimeStepsPerEpoch, area7a.samplingRate, desiredFanIn);
-    }
+    initRegions(isTraining);
     
     try {
         
@@ -209,6 +356,15 @@ ESPathway(p.dimensions.size()) {
     }
     
     weightFile.close();
+    
+    // Before partition, which places synapses in this order
+    if(p.sortSynapses)
+        for(u_short k = 0;k < ESPathway.size();k++)
+            ESPathway[k].sortAfferentSynapses();
+    
+    // Synapses were read by this thread, move them to the threads that update them
+    setupPartition(maxThreads());
+    placeRegionMemory();
 }
 
 Network::~Network() {
@@ -254,64 +410,263 @@ u_short Network::runContinous(const char * outputDirectory, bool isTraining, boo
     
     const u_short nrOfEpochs = isTraining ? p.nrOfEpochs : 1;
     
+    // Testing never changes weights
+    if(!isTraining)
+        freezeWeights();
+    
+    bool layerwise = isTraining && p.layerwise;
+    
+    if(layerwise)
+        checkLayers();
+    
+    setupPushPropagation();
+    
+    if(isTraining)
+        setupGatedLearning();
+    
+    if(isTraining && p.trainAtTimeStepMultiple > 1)
+        setupAccumulatedLearning();
+    
     cout << "*** EPOCH DURATION = " << area7a.epochDuration << "s" << endl;
     cout << "*** STEP SIZE = " << p.stepSize << "s" << endl;
     
+    // Checkpoint on preemption, the signal is only acted upon
+    // at the end of a time step
+    string checkpointFile(outputDirectory);
+    checkpointFile.append("Checkpoint.dat");
+    time_t lastCheckpoint = time(NULL);
+    
+    if(isTraining) {
+        
+#pragma omp critical(checkpointSignals)
+        {
+            if(trainingRuns++ == 0) {
+                checkpointRequested = 0;
+                signal(SIGTERM, requestCheckpoint);
+                signal(SIGINT, requestCheckpoint);
+            }
+        }
+    }
+    
+    interrupted = false;
+    converged = false;
+    epochsCompleted = startEpoch;
+    
+    if((options.profiling || options.counting || options.tracing) && options.taskScheduling)
+        cout << "Profiling and tracing are not supported with task scheduling, no profile or trace is written." << endl;
+    
+    profile.enabled = (options.profiling || options.counting) && !options.taskScheduling;
+    counters.enabled = options.counting && profile.enabled;
+    profile.counters = counters.enabled ? &counters : NULL;
+    trace.enabled = options.tracing && !options.taskScheduling;
+    trace.stepInterval = options.traceInterval;
+    trace.maxSpans = options.traceMaxSpans;
+    profile.trace = trace.enabled ? &trace : NULL;
+    
+    // Reference for weight change in first epoch, comes from checkpoint when resuming
+    if(isTraining && !resuming)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            ESPathway[k].takeWeightSnapshot();
+    
+    // SCALED norms are kept up to date from here on, also by checkpoints
+    if(isTraining && !resuming && p.weightNormalization == SCALED)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            ESPathway[k].setupWeightScales();
+    
+    if(!options.telemetryFile.empty()) {
+        
+        // Steps of resumed epoch that were done before the checkpoint
+        unsigned long long doneSteps = 0;
+        
+        if(resuming) {
+            
+            for(u_short o = 0;o < startObject;o++)
+                doneSteps += area7a.timeStepsInObject[o];
+            
+            doneSteps += startTimeStep;
+        }
+        
+        telemetry.start(options.telemetryFile, options.telemetryInterval, outputDirectory,
+                        static_cast<unsigned long long>(nrOfEpochs - startEpoch) * area7a.timeStepsPerEpoch, doneSteps,
+                        synapseUpdatesPerTimeStep(isTraining), nrOfEpochs, area7a.nrOfObjects);
+    }
+    
 #pragma omp parallel
     {
-            for(u_short e = 0; e < nrOfEpochs;e++) {
+            bindThread();
+        
+            // Team may differ from the one the network was loaded with
+#pragma omp single
+            {
+                if(partitionThreads != teamSize())
+                    setupPartition(teamSize());
+                
+                if(profile.enabled)
+                    setupProfile(teamSize());
+                
+                if(trace.enabled)
+                    trace.init(ESPathway.size(), teamSize());
+                
+                if(counters.enabled)
+                    counters.init(teamSize());
+            }
+        
+            // Counters only count the thread that opens them
+            counters.openThread();
+        
+            for(u_short e = startEpoch; e < nrOfEpochs && !interrupted && !converged;e++) {
+            
+            // Resumed epoch continues with the restored state
+            bool resumedEpoch = resuming && e == startEpoch;
             
             // We cannot continue without resetting old values from
             // the last time step in the last epoch.
-            for(unsigned k = 0;k < ESPathway.size();k++)
-                ESPathway[k].clearState(true);
+            if(!resumedEpoch)
+                for(unsigned k = 0;k < ESPathway.size();k++)
+                    ESPathway[k].clearState(true);
             
+            if(layerwise) {
+                
 #pragma omp single
+                setupLayer(e, resumedEpoch);
+            }
+            
+            // Thread 0 only, no barrier
+#pragma omp master
             {
                 cout << ">> epoch #" << e << endl;
+                profile.startEpoch();
                 
                 if(xgrid)
                     cout << "<xgrid>{control = statusUpdate; percentDone = " << static_cast<int>(((float)(e+1)*100)/nrOfEpochs) << "; }</xgrid>";
             }
             
             // For object/timestep
-            for(u_short o = 0; o < area7a.nrOfObjects;o++) {
+            for(u_short o = (resumedEpoch ? startObject : 0); o < area7a.nrOfObjects;o++) {
+                
+                unsigned long int firstTimeStep = (resumedEpoch && o == startObject ? startTimeStep : 0);
                 
-                for(unsigned long int t = 0; t < area7a.timeStepsInObject[o];t++) {
+                profile.skip();
+                
+#pragma omp master
+                telemetry.setPosition(e, o);
+                
+                if(options.taskScheduling) {
                     
-                    //#pragma omp single
-                    //{
-                    //    cout << ">> step #" << t << endl;
-                    //}
+                    // One thread generates the tasks, the implicit barrier waits for all of them
+#pragma omp single
+                    runObjectAsTasks(e, o, firstTimeStep, isTraining, checkpointFile, lastCheckpoint);
                     
-                    //#pragma omp single // Due to normalization of inputs we have to let one cell do write back
-                    //{
-                    area7a.setFiringRate(o, t * p.stepSize);
-                    //}
+#pragma omp master
+                    telemetry.addSteps(area7a.timeStepsInObject[o] - firstTimeStep);
                     
-                    // Compute new firing rates
-                    for(unsigned k = 0; k < ESPathway.size();k++)
-                        ESPathway[k].computeNewFiringRate();
+                } else {
                     
-                    // We need barrier due to nowait in computeNewFiringRate()
-#pragma omp barrier
+                    // Steps summed since weights last changed, p.trainAtTimeStepMultiple > 1
+                    unsigned int accumulatedSteps = 0;
                     
-                    // Do learning
-                    if(isTraining) {
-                        for(unsigned k = 0; k < ESPathway.size();k++)
-                            ESPathway[k].applyLearningRule();
+                    for(unsigned long int t = firstTimeStep; t < area7a.timeStepsInObject[o];t++) {
+                    
+                        //#pragma omp single
+                        //{
+                        //    cout << ">> step #" << t << endl;
+                        //}
+                    
+                        trace.startStep();
+                    
+                        //#pragma omp single // Due to normalization of inputs we have to let one cell do write back
+                        //{
+                        {
+                            PhaseTimer timer(profile, PH_INPUT, 0);
+                            
+                            if(replayingLayer)
+                                cacheLayer(o, t);
+                            else
+                                area7a.setFiringRate(o, t);
+                            
+                            if(recordingLayer)
+                                cacheLayer(o, t);
+                        }
+                        //}
                         
-                    }
+                        // Replayed firing rates are read by all threads
+                        if(replayingLayer) {
+#pragma omp barrier
+                        }
+                        
+                        profile.mark(PH_INPUT);
+                    
+                        // Compute new firing rates
+                        computeNewFiringRates(t);
                     
-                    // We need barrier due to nowait in applyLearningRule()
+                        // Do learning, or sum until weights change, at the latest on last step of object
+                        if(isTraining && p.trainAtTimeStepMultiple > 1) {
+                            
+                            accumulateLearning(accumulatedSteps == 0);
+                            accumulatedSteps++;
+                            
+                            if(accumulatedSteps == p.trainAtTimeStepMultiple || t + 1 == area7a.timeStepsInObject[o]) {
+                                
+                                // Presynaptic sums are made by all threads
+                                {
+                                    TraceSpan wait(trace, "wait sums");
 #pragma omp barrier
-                    // Make time step for each region, and save data if we are on appropriate time step
-                    bool save = ((t+1) % p.outputAtTimeStepMultiple) == 0;
-                    for(unsigned k = 0;k < ESPathway.size();k++)
-                        ESPathway[k].doTimeStep(save);
+                                }
+                                
+                                applyAccumulatedLearning(accumulatedSteps);
+                                accumulatedSteps = 0;
+                            }
+                            
+                        } else if(isTraining)
+                            applyLearningRules(t);
+                    
+                        // We need barrier as applyLearningRules() ends without one
+                        {
+                            TraceSpan wait(trace, "wait learning");
+#pragma omp barrier
+                        }
+                        
+                        if(isTraining)
+                            profile.mark(PH_LEARNING);
+                    
+                        // Make time step for each region, and save data if we are on appropriate time step
+                        bool save = ((t+1) % p.outputAtTimeStepMultiple) == 0;
+                        // Safe point when no sums are pending: all regions have completed time step t
+                        // at the barrier of doTimeSteps(), which also decides on a checkpoint
+                        doTimeSteps(save, t, isTraining && accumulatedSteps == 0, lastCheckpoint);
+                        profile.mark(save ? PH_HISTORY_SAVE : PH_TIME_STEP);
+                        
+#pragma omp master
+                        telemetry.addSteps(1);
+                    
+                        if(checkpointDue) {
+                        
+                            TraceSpan wait(trace, "wait checkpoint");
+                            
+#pragma omp single
+                            {
+                                PhaseTimer timer(profile, PH_SNAPSHOT, profile.networkSlot(), true);
+                                
+                                cout << "Saving checkpoint: epoch #" << e << ", object #" << o << ", step #" << t+1 << endl;
+                                outputCheckpoint(checkpointFile.c_str(), e, o, t+1);
+                                lastCheckpoint = time(NULL);
+                                
+                                // All threads see this after the implicit barrier
+                                interrupted = (checkpointRequested != 0);
+                            }
+                        
+                            profile.skip();
+                        
+                            if(interrupted)
+                                break;
+                        }
+                    }
                 }
                 
-#pragma omp single
+                if(interrupted)
+                    break;
+                
+#pragma omp master
                 {
                     cout << ">Completed Periode nr." << o+1 << endl;
                 }
@@ -355,121 +710,866 @@ u_short Network::runContinous(const char * outputDirectory, bool isTraining, boo
             }
             
             // Save network after EPOCHS
-            if(isTraining && p.saveNetwork && (e+1) % p.saveNetworkAtEpochMultiple == 0) {
+            if(isTraining && !interrupted && p.saveNetwork && (e+1) % p.saveNetworkAtEpochMultiple == 0) {
                 
 #pragma omp single
                 {
+                    PhaseTimer timer(profile, PH_SNAPSHOT, profile.networkSlot(), true);
+                    
                     cout << "Saving: TrainedNetwork_e" << e+1 << ".txt" << endl;
                     
                     stringstream ss;
                     ss << outputDirectory << "TrainedNetwork_e" << e+1 << ".txt";
                     string name = ss.str();
                     outputFinalNetwork(name.c_str());
+                }
+            }
+            
+            // Weight convergence
+            if(isTraining && !interrupted) {
+                
+#pragma omp single
+                {
+                    PhaseTimer timer(profile, PH_SNAPSHOT, profile.networkSlot(), true);
                     
-                    // dnavarro2016 convergence
-                    //cout << "Epoch " << e << " - Synapse History Buffer Size: " << ESPathway[0].synapseHistoryBuffer.size() << endl << endl << endl;
-                    cout << "Loading previous epoch's synapses..." << endl << endl;
-                    vector<vector<Synapse>> old_synapses = previous_epoch_synapses;
-                    
-                    cout << "Previous synapses successfully loaded." << endl << "Loading current epoch synapses..." << endl << endl;
-                    outputConvergence(); // TO DO update method's name to something like getMyCurrentSynapses()
+                    bool allBelowTolerance = p.convergenceTolerance > 0;
+                    float largestChange = 0;
                     
-                    cout << "Current synapes successfully loaded." << endl << "Calculating RMS......";
-                    //CALCULATE RMS here:
-                    float rms = 0;
-                    float number_of_synapses = 0;
+                    cout << "RMS weight change in epoch #" << e << ":";
                     
-                    if (e > 0) {
-                        /*for (std::vector<vector<Synapse>>::iterator r = old_synapses.begin(); r != old_synapses.end(); r++) {
-                            for (std::vector<Synapse>::iterator s = (*r).begin(); s != (*r).end();s++) {
-                                
-                            }
-                        } */
-                        for(int i=0; i<old_synapses.size(); i++) {
-                            for(int j=0; j<old_synapses.at(i).size(); j++) {
-                                rms += (old_synapses.at(i).at(j).weight - previous_epoch_synapses.at(i).at(j).weight)*(old_synapses.at(i).at(j).weight - previous_epoch_synapses.at(i).at(j).weight);
-                                number_of_synapses++;
-                                
-                            }
-                            
-                        }
-                        rms /= number_of_synapses;
+                    for(unsigned k = 0;k < ESPathway.size();k++) {
                         
+                        float rms = ESPathway[k].computeWeightChange();
+                        allBelowTolerance = allBelowTolerance && rms < p.convergenceTolerance;
+                        largestChange = rms > largestChange ? rms : largestChange;
+                        
+                        cout << " region #" << k+1 << " = " << rms;
                     }
-                    cout << " Done." << endl << endl;
-                    cout << "Average RMS Deviation for epoch " << e << ": " << sqrt(rms) << " - yaaay!" << endl << endl;
-                    // dnavarro2016 convergence Ends here :)
                     
+                    cout << endl;
+                    
+                    telemetry.setConvergence(largestChange);
+                    epochsCompleted = e+1;
+                    
+                    // All threads see this after the implicit barrier
+                    if(allBelowTolerance) {
+                        
+                        cout << "Weights converged (tolerance = " << p.convergenceTolerance << "), stopping after " << epochsCompleted << " epochs." << endl;
+                        converged = true;
+                    }
+                }
+            }
+            
+            // Pruning, not after the last epoch, whose weights are final
+            if(isTraining && !interrupted && !converged && e+1 < nrOfEpochs && (p.pruneThreshold > 0 || p.pruneKeep > 0)) {
+                
+#pragma omp single
+                {
+                    PhaseTimer timer(profile, PH_SNAPSHOT, profile.networkSlot(), true);
+                    pruneSynapses();
                 }
             }
+            
+            if(profile.enabled) {
+                
+#pragma omp single
+                profile.endEpoch(e);
+            }
         }
+        
+            counters.closeThread();
     }
     
-    cout << "Saving history..." << endl;
-    outputHistory(outputDirectory, isTraining);
-    return nrOfEpochs;
-}
-
-void Network::outputHistory(const char * outputDirectory, bool isTraining) {
+    if(p.pushEpsilon >= 0)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            ESPathway[k].reportPushPropagation();
     
-    if(isTraining) { // Output neuronal and synaptic training data
-        
-        if(p.saveSingleCells)
-            outputSingleUnits(outputDirectory);
+    if(isTraining && p.plasticityThreshold >= 0)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            if(p.learningRates[k] != 0)
+                ESPathway[k].reportGatedLearning();
+    
+    if(isTraining && p.trainAtTimeStepMultiple > 1)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            if(p.learningRates[k] != 0)
+                ESPathway[k].reportAccumulatedLearning();
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        if(ESPathway[k].isQuantized())
+            ESPathway[k].reportQuantization();
+    
+    // All regions simulated and learning again
+    if(layerwise) {
         
-        if(p.saveAllNeuronsAndSynapsesInRegion)
-            outputSynapticHistory(outputDirectory);
+        trainedLayer = -1;
+        recordingLayer = replayingLayer = layerCached = false;
+        vector<RegionBuffer>().swap(layerCache);
+        setupPartition(partitionThreads);
     }
     
-    // Output region data
-    outputRegionHistory(outputDirectory, isTraining);
+    if(isTraining) {
+        
+#pragma omp critical(checkpointSignals)
+        {
+            if(--trainingRuns == 0) {
+                signal(SIGTERM, SIG_DFL);
+                signal(SIGINT, SIG_DFL);
+            }
+        }
+    }
     
-    // Output neuronal data
+    resuming = false;
     
-    // Do a small check to see that
-    // we have anything to save, saves us from dumping
-    // empty files
-    if(!isTraining || p.saveAllNeuronsAndSynapsesInRegion || p.saveAllNeuronsInRegion) {
+    // History is in the checkpoint, and is written when training completes
+    if(interrupted) {
         
-        outputNeuronHistoryData(outputDirectory, isTraining, FIRING_RATE);
-        outputNeuronHistoryData(outputDirectory, isTraining, ACTIVATION);
-        outputNeuronHistoryData(outputDirectory, isTraining, INHIBITED_ACTIVATION);
-        outputNeuronHistoryData(outputDirectory, isTraining, TRACE);
-        outputNeuronHistoryData(outputDirectory, isTraining, STIMULATION);
-        outputNeuronHistoryData(outputDirectory, isTraining, EFFECTIVE_TRACE);
+        profile.write(outputDirectory);
+        trace.write(outputDirectory);
+        telemetry.stop("interrupted");
+        
+        cout << "Training interrupted, resume with: --resume " << checkpointFile << endl;
+        return nrOfEpochs;
+    }
+    
+    cout << "Saving history..." << endl;
+    
+    {
+        PhaseTimer timer(profile, PH_OUTPUT, profile.networkSlot(), true);
+        outputHistory(outputDirectory, isTraining);
     }
+    
+    profile.write(outputDirectory);
+    trace.write(outputDirectory);
+    telemetry.stop(converged ? "converged" : "done");
+    return isTraining ? epochsCompleted : nrOfEpochs;
 }
 
-void Network::openHistoryFile(BinaryWrite & file, const char * outputDirectory, const char * filename, bool isTraining, OUTPUT_FILE fileType) {
+void Network::setupPartition(int threads) {
     
-    string s(outputDirectory);
-    s.append(filename);
+    vector<unsigned int> stimulated(ESPathway.size()), filtered(ESPathway.size()), rated(ESPathway.size()), learning(ESPathway.size()), all(ESPathway.size());
     
-    file.openFile(s);
+    // Number of neurons in each phase, neurons are numbered sheet by sheet
+    for(unsigned k = 0;k < ESPathway.size();k++) {
+        
+        unsigned int sheet = ESPathway[k].verDimension * ESPathway[k].horDimension;
+        unsigned int neurons = ESPathway[k].getNrOfNeurons();
+        
+        bool simulated = isSimulated(k);
+        ESPathway[k].setIdle(!simulated);
+        
+        stimulated[k] = !simulated ? 0 : (p.sparsenessRoutine == HEAP) ? neurons : (p.sparsenessRoutine == GLOBAL ? sheet : 0);
+        filtered[k] = (simulated && p.sparsenessRoutine == HEAP && p.lateralInteraction != NONE) ? sheet : 0;
+        rated[k] = (simulated && p.sparsenessRoutine == HEAP) ? neurons : 0;
+        learning[k] = isLearning(k) ? neurons : 0;
+        all[k] = neurons;
+    }
     
-    // Header
-    file << (isTraining ? p.nrOfEpochs : U_SHORT_1);
-    file << p.numberOfLayers;
-    file << area7a.nrOfObjects;
+    splitNeurons(stimulationPartition, stimulated, true, threads);
+    splitNeurons(filterPartition, filtered, false, threads);
+    splitNeurons(firingRatePartition, rated, false, threads);
+    splitNeurons(learningPartition, learning, true, threads);
+    splitNeurons(timeStepPartition, all, false, threads);
     
-    // Iterate and output size of each
-    for(u_short o = 0; o < area7a.nrOfObjects;o++)
-        file << area7a.outputtedTimeStepsInObject[o];
+    partitionThreads = threads;
+}
+
+// Neurons [0, count[k]) of each region k are cut into one contiguous piece per
+// thread, in (region, neuron) order, so every thread gets about the same cost.
+// Neuron cost is 1, plus its number of afferent synapses when bySynapses.
+void Network::splitNeurons(Partition & partition, const vector<unsigned int> & count, bool bySynapses, int threads) {
     
-    // Input layer dimensions
-    file << area7a.horVisualDimension;
-    file << area7a.horEyeDimension;
-    file << area7a.depth;
-    file << U_SHORT_0; // Never present
+    double total = 0;
     
-    // Hidden layer description
-    for(u_short k = 0;k < ESPathway.size();k++) {
-        
-        u_short isPresent = 0;
-        
-        switch (fileType) {
-                
-            case OF_REGIONAL:
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        for(unsigned int n = 0;n < count[k];n++)
+            total += 1 + (bySynapses ? ESPathway[k].getNrOfAfferentSynapses(n) : 0);
+    
+    partition.assign(threads, vector<NeuronRange>());
+    
+    double cumulative = 0;
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        for(unsigned int n = 0;n < count[k];n++) {
+            
+            double cost = 1 + (bySynapses ? ESPathway[k].getNrOfAfferentSynapses(n) : 0);
+            
+            // Thread whose share holds the middle of this neuron
+            int t = std::min(threads - 1, static_cast<int>((cumulative + cost/2) * threads / total));
+            cumulative += cost;
+            
+            vector<NeuronRange> & ranges = partition[t];
+            
+            if(!ranges.empty() && ranges.back().region == k && ranges.back().last == n)
+                ranges.back().last++;
+            else {
+                NeuronRange range = {static_cast<u_short>(k), n, n + 1};
+                ranges.push_back(range);
+            }
+        }
+}
+
+void Network::placeRegionMemory() {
+    
+    // Synapses are read by activation and learning, history by time step
+    Partition synapsePartition;
+    vector<unsigned int> all(ESPathway.size());
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        all[k] = ESPathway[k].getNrOfNeurons();
+    
+    splitNeurons(synapsePartition, all, true, partitionThreads);
+    
+#pragma omp parallel
+    {
+        bindThread();
+        
+        // Every range must be touched, even if the team is smaller
+        for(int t = threadNumber();t < partitionThreads;t += teamSize()) {
+            
+            for(unsigned r = 0;r < synapsePartition[t].size();r++) {
+                const NeuronRange & range = synapsePartition[t][r];
+                ESPathway[range.region].placeSynapses(range.first, range.last);
+            }
+            
+            for(unsigned r = 0;r < timeStepPartition[t].size();r++) {
+                const NeuronRange & range = timeStepPartition[t][r];
+                ESPathway[range.region].placeHistoryBuffers(range.first, range.last);
+            }
+        }
+    }
+}
+
+void Network::freezeWeights() {
+    
+    // Frozen before, or weights shared with a frozen network
+    if(!ESPathway.empty() && ESPathway[0].isFrozen())
+        return;
+    
+    unsigned long long synapses = 0, frozenBytes = 0;
+    
+    for(unsigned k = 0;k < ESPathway.size();k++) {
+        
+        ESPathway[k].freezeSynapses(k == 0 ? static_cast<Region &>(area7a) : static_cast<Region &>(ESPathway[k-1]));
+        
+        unsigned long long regionSynapses = 0;
+        
+        for(unsigned int n = 0;n < ESPathway[k].getNrOfNeurons();n++)
+            regionSynapses += ESPathway[k].getNrOfAfferentSynapses(n);
+        
+        synapses += regionSynapses;
+        frozenBytes += regionSynapses * ESPathway[k].getFrozenSynapseSize();
+    }
+    
+    // Frozen synapses are written by the threads of the coming run
+    setupPartition(maxThreads());
+    placeRegionMemory();
+    
+    cout << "Frozen weights: " << synapses << " synapses in " << frozenBytes / (1024.0*1024.0)
+         << " MB instead of " << synapses * sizeof(Synapse) / (1024.0*1024.0) << " MB" << endl;
+    
+    if(p.pushEpsilon >= 0 && p.weightPrecision != FP32)
+        cout << "Push propagation reads float weights, weightPrecision " << (p.weightPrecision == BF16 ? "BF16" : "INT8") << " is not used for frozen weights" << endl;
+}
+
+void Network::setupPushPropagation() {
+    
+    if(p.pushEpsilon < 0)
+        return;
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        ESPathway[k].setupEfferentSynapses(k == 0 ? static_cast<Region &>(area7a) : static_cast<Region &>(ESPathway[k-1]));
+}
+
+void Network::pruneSynapses() {
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        if(isLearning(k))
+            ESPathway[k].pruneSynapses(p.pruneThreshold, p.pruneKeep);
+    
+    // Everything set up from the synapses before
+    setupPushPropagation();
+    setupGatedLearning();
+    
+    if(p.trainAtTimeStepMultiple > 1)
+        setupAccumulatedLearning();
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        if(isLearning(k))
+            ESPathway[k].takeWeightSnapshot();
+    
+    setupPartition(teamSize());
+    
+    if(profile.enabled)
+        setupProfileWork(teamSize());
+}
+
+void Network::setupGatedLearning() {
+    
+    // CLASSIC normalization reads all weights of a neuron anyway, and push propagation set them up
+    if(p.plasticityThreshold < 0 || p.weightNormalization == CLASSIC || p.pushEpsilon >= 0)
+        return;
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        if(p.learningRates[k] != 0)
+            ESPathway[k].setupEfferentSynapses(k == 0 ? static_cast<Region &>(area7a) : static_cast<Region &>(ESPathway[k-1]));
+}
+
+void Network::setupAccumulatedLearning() {
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        ESPathway[k].setupAccumulatedLearning(k == 0 ? static_cast<Region &>(area7a) : static_cast<Region &>(ESPathway[k-1]));
+}
+
+void Network::setupProfile(int threads) {
+    
+    profile.init(ESPathway.size(), threads);
+    setupProfileWork(threads);
+}
+
+void Network::setupProfileWork(int threads) {
+    
+    // Bytes are estimates of what each call reads and writes
+    unsigned long long inputNeurons = area7a.depth * area7a.verDimension * area7a.horDimension;
+    profile.setWork(PH_INPUT, 0, 0, inputNeurons * 2 * sizeof(float));
+    
+    for(unsigned k = 0;k < ESPathway.size();k++) {
+        
+        HiddenRegion & region = ESPathway[k];
+        u_short slot = k + 1;
+        
+        unsigned long long neurons = region.getNrOfNeurons();
+        unsigned long long sheet = region.verDimension * region.horDimension;
+        unsigned long long synapses = 0, sheetSynapses = 0, savedNeurons = 0, savedSynapses = 0;
+        
+        for(unsigned int n = 0;n < neurons;n++) {
+            
+            HiddenNeuron & neuron = region.neuron(n);
+            
+            synapses += region.getNrOfAfferentSynapses(n);
+            sheetSynapses += (n < sheet) ? region.getNrOfAfferentSynapses(n) : 0;
+            savedNeurons += neuron.savesNeuronHistory() ? 1 : 0;
+            savedSynapses += neuron.saveSynapseHistory ? region.getNrOfAfferentSynapses(n) : 0;
+        }
+        
+        // Synapse is read with the presynaptic firing rate
+        unsigned long long synapseRead = (region.isFrozen() ? region.getFrozenSynapseSize() : sizeof(Synapse)) + sizeof(float);
+        unsigned long long timeStep = neurons * 12 * sizeof(float);
+        
+        if(p.sparsenessRoutine == HEAP) {
+            
+            profile.setWork(PH_STIMULATION, slot, synapses, synapses * synapseRead + neurons * 4 * sizeof(float));
+            
+            if(p.lateralInteraction != NONE)
+                profile.setWork(PH_FILTER, slot, 0, sheet * (p.filterWidth[k] * p.filterWidth[k] + 1) * sizeof(float));
+            
+            // Every thread finds the threshold
+            profile.setWork(PH_THRESHOLD, slot, 0, neurons * threads * sizeof(float));
+            profile.setWork(PH_FIRING_RATE, slot, 0, neurons * 3 * sizeof(float));
+            
+        } else if(p.sparsenessRoutine == GLOBAL)
+            profile.setWork(PH_STIMULATION, slot, sheetSynapses, sheetSynapses * synapseRead + sheet * 6 * sizeof(float));
+        
+        if(p.learningRates[k] != 0)
+            profile.setWork(PH_LEARNING, slot, synapses, synapses * (synapseRead + sizeof(float)) + neurons * 8 * sizeof(float));
+        
+        profile.setWork(PH_TIME_STEP, slot, 0, timeStep);
+        profile.setWork(PH_HISTORY_SAVE, slot, savedSynapses, timeStep + savedNeurons * 6 * sizeof(float) + savedSynapses * (sizeof(float) + (p.weightPrecision == BF16 ? sizeof(bfloat16) : sizeof(float))));
+    }
+}
+
+// Stimulation and learning go through afferent synapses, see setupPartition()
+unsigned long long Network::synapseUpdatesPerTimeStep(bool isTraining) {
+    
+    unsigned long long updates = 0;
+    
+    for(unsigned k = 0;k < ESPathway.size();k++) {
+        
+        HiddenRegion & region = ESPathway[k];
+        unsigned int sheet = region.verDimension * region.horDimension;
+        unsigned int stimulated = (p.sparsenessRoutine == HEAP) ? region.getNrOfNeurons() : (p.sparsenessRoutine == GLOBAL ? sheet : 0);
+        bool learning = isTraining && p.learningRates[k] != 0;
+        
+        for(unsigned int n = 0;n < region.getNrOfNeurons();n++) {
+            
+            unsigned long long synapses = region.getNrOfAfferentSynapses(n);
+            updates += (n < stimulated ? synapses : 0) + (learning ? synapses : 0);
+        }
+    }
+    
+    return updates;
+}
+
+// Layer trained in epoch, layer k learns in epochs[k] epochs after those of the layers below
+int Network::layerOfEpoch(u_short epoch) {
+    
+    unsigned int lastEpoch = 0;
+    
+    for(unsigned k = 0;k < ESPathway.size();k++) {
+        
+        lastEpoch += p.epochs[k];
+        
+        if(epoch < lastEpoch)
+            return k;
+    }
+    
+    return ESPathway.size() - 1;
+}
+
+// Frozen regions are only cached if region k reads nothing but region k-1
+void Network::checkLayers() {
+    
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        for(unsigned int n = 0;n < ESPathway[k].getNrOfNeurons();n++) {
+            
+            const vector<Synapse> & synapses = ESPathway[k].neuron(n).afferentSynapses;
+            
+            for(unsigned s = 0;s < synapses.size();s++)
+                if(synapses[s].preSynapticNeuron->region->regionNr != k) {
+                    
+                    cerr << "Layer-wise training needs a feedforward network, region #" << k+1
+                         << " has a synapse from region #" << synapses[s].preSynapticNeuron->region->regionNr << endl;
+                    cerr.flush();
+                    exit(EXIT_FAILURE);
+                }
+        }
+}
+
+// Each epoch starts from cleared state, and frozen regions compute the same
+// firing rates every epoch, so the input of the trained region is recorded in
+// the first full epoch of a layer and replayed in the others. Called by one thread.
+void Network::setupLayer(u_short epoch, bool resumedEpoch) {
+    
+    int layer = layerOfEpoch(epoch);
+    
+    // Restored by loadCheckpoint(), frozen regions may not have been simulated before the checkpoint
+    if(resumedEpoch && layer == trainedLayer) {
+        setupPartition(teamSize());
+        return;
+    }
+    
+    // Previous epoch recorded every time step of every object
+    layerCached = layerCached || recordingLayer;
+    
+    if(layer != trainedLayer) {
+        
+        trainedLayer = layer;
+        layerCached = false;
+        vector<RegionBuffer>().swap(layerCache);
+        
+        cout << "Training layer #" << layer+1 << ", lower layers are frozen, history of layers not simulated is NaN" << endl;
+        
+        if(layer > 0) {
+            
+            unsigned int neurons = ESPathway[layer - 1].getNrOfNeurons();
+            unsigned long long floats = 0;
+            
+            layerCache.resize(area7a.nrOfObjects);
+            
+            for(u_short o = 0;o < area7a.nrOfObjects;o++) {
+                layerCache[o].resize(area7a.timeStepsInObject[o] * neurons);
+                floats += layerCache[o].size();
+            }
+            
+            cout << "Caching firing rates of layer #" << layer << ": " << floats * sizeof(float) / (1024.0*1024.0) << " MB" << endl;
+        }
+    }
+    
+    // A resumed epoch of a checkpoint without layers misses time steps before the checkpoint
+    recordingLayer = layer > 0 && !layerCached && !resumedEpoch;
+    replayingLayer = layer > 0 && layerCached;
+    
+    setupPartition(teamSize());
+}
+
+// Regions computing firing rates, all but the trained one and those below it are idle
+bool Network::isSimulated(unsigned k) {
+    
+    if(trainedLayer < 0)
+        return true;
+    
+    return k <= static_cast<unsigned>(trainedLayer) && (!replayingLayer || k == static_cast<unsigned>(trainedLayer));
+}
+
+bool Network::isLearning(unsigned k) {
+    
+    return p.learningRates[k] != 0 && (trainedLayer < 0 || k == static_cast<unsigned>(trainedLayer));
+}
+
+// Region k advances on every p.stepMultiples[k]-th step of an object, starting with the first
+bool Network::isStepped(unsigned k, unsigned long int timeStep) {
+    
+    return timeStep % p.stepMultiples[k] == 0;
+}
+
+// Neurons of the region below the trained one in the time step partition of the calling thread
+void Network::cacheLayer(u_short object, unsigned long int timeStep) {
+    
+    int thread = threadNumber();
+    
+    for(unsigned r = 0;r < timeStepPartition[thread].size();r++) {
+        
+        const NeuronRange & range = timeStepPartition[thread][r];
+        
+        if(range.region == trainedLayer - 1)
+            cacheLayer(object, timeStep, range.first, range.last);
+    }
+}
+
+// Replays, or records, firing rates of neurons [first, last) of the region below the trained one
+void Network::cacheLayer(u_short object, unsigned long int timeStep, unsigned int first, unsigned int last) {
+    
+    HiddenRegion & region = ESPathway[trainedLayer - 1];
+    float * cached = &layerCache[object][timeStep * region.getNrOfNeurons()];
+    
+    if(replayingLayer)
+        for(unsigned int n = first;n < last;n++)
+            region.neuron(n).firingRate = cached[n];
+    else
+        for(unsigned int n = first;n < last;n++)
+            cached[n] = region.neuron(n).firingRate;
+}
+
+void Network::computeNewFiringRates(unsigned long int timeStep) {
+    
+    int thread = threadNumber();
+    
+    // INT8 and BF16 frozen weights read gathered firing rates, a region per thread
+    if(p.weightPrecision != FP32) {
+        
+#pragma omp for schedule(static, 1)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            if(ESPathway[k].gathersInput() && isSimulated(k) && isStepped(k, timeStep)) {
+                PhaseTimer timer(profile, PH_STIMULATION, k + 1);
+                ESPathway[k].gatherInput();
+            }
+    }
+    
+    // Push propagation reads the presynaptic neurons that fire, found once per region
+    if(p.pushEpsilon >= 0) {
+        
+#pragma omp for schedule(static, 1)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            if(isSimulated(k) && isStepped(k, timeStep)) {
+                PhaseTimer timer(profile, PH_STIMULATION, k + 1);
+                ESPathway[k].findActivePreSynaptic();
+            }
+    }
+    
+    // Activation, GLOBAL computes firing rate right away
+    for(unsigned r = 0;r < stimulationPartition[thread].size();r++) {
+        
+        const NeuronRange & range = stimulationPartition[thread][r];
+        HiddenRegion & region = ESPathway[range.region];
+        
+        if(!isStepped(range.region, timeStep))
+            continue;
+        PhaseTimer timer(profile, PH_STIMULATION, range.region + 1);
+        
+        if(p.sparsenessRoutine == HEAP)
+            region.computeNewActivation(range.first, range.last);
+        else
+            region.computeGlobalFiringRate(range.first, range.last, region.findCumulativeFiringRate());
+    }
+    
+    // Do local inhibition
+    // Even if we do not run .filter(), the activation
+    // values will still have been copied through to
+    // n->newInhibitedActivation by .computeNewActivation(),
+    // hence all future calculations that expect inhibited values
+    // will still work.
+    {
+        TraceSpan wait(trace, "wait stimulation");
+#pragma omp barrier
+    }
+    
+    profile.mark(PH_STIMULATION);
+    
+    if(p.sparsenessRoutine != HEAP)
+        return;
+    
+    if(p.lateralInteraction != NONE) {
+        
+        for(unsigned r = 0;r < filterPartition[thread].size();r++) {
+            const NeuronRange & range = filterPartition[thread][r];
+            
+            if(!isStepped(range.region, timeStep))
+                continue;
+            
+            PhaseTimer timer(profile, PH_FILTER, range.region + 1);
+            ESPathway[range.region].filter(range.first, range.last);
+        }
+        
+        {
+            TraceSpan wait(trace, "wait filter");
+#pragma omp barrier
+        }
+        
+        profile.mark(PH_FILTER);
+    }
+    
+    // this value is written to once by each thread,
+    // but it is the same value is computed in all threads,
+    // so it does not matter
+    for(unsigned k = 0;k < ESPathway.size();k++)
+        if(isSimulated(k) && isStepped(k, timeStep)) {
+            PhaseTimer timer(profile, PH_THRESHOLD, k + 1);
+            ESPathway[k].computeThreshold();
+        }
+    
+    profile.mark(PH_THRESHOLD);
+    
+    // Compute firing rate using contrast enhancement
+    for(unsigned r = 0;r < firingRatePartition[thread].size();r++) {
+        const NeuronRange & range = firingRatePartition[thread][r];
+        
+        if(!isStepped(range.region, timeStep))
+            continue;
+        
+        PhaseTimer timer(profile, PH_FIRING_RATE, range.region + 1);
+        ESPathway[range.region].computeNewFiringRate(range.first, range.last);
+    }
+    
+    {
+        TraceSpan wait(trace, "wait firing rate");
+#pragma omp barrier
+    }
+    
+    profile.mark(PH_FIRING_RATE);
+}
+
+void Network::applyLearningRules(unsigned long int timeStep) {
+    
+    int thread = threadNumber();
+    
+    // Gated learning finds the presynaptic neurons that pass the gate, once per region
+    if(p.plasticityThreshold >= 0) {
+        
+#pragma omp for schedule(static, 1)
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            if(isLearning(k) && isStepped(k, timeStep)) {
+                PhaseTimer timer(profile, PH_LEARNING, k + 1);
+                ESPathway[k].findLearningPreSynaptic();
+            }
+    }
+    
+    for(unsigned r = 0;r < learningPartition[thread].size();r++) {
+        
+        const NeuronRange & range = learningPartition[thread][r];
+        
+        if(!isStepped(range.region, timeStep))
+            continue;
+        
+        PhaseTimer timer(profile, PH_LEARNING, range.region + 1);
+        ESPathway[range.region].applyLearningRule(range.first, range.last);
+    }
+}
+
+void Network::accumulateLearning(bool restart) {
+    
+    int thread = threadNumber();
+    
+    for(unsigned r = 0;r < learningPartition[thread].size();r++) {
+        const NeuronRange & range = learningPartition[thread][r];
+        PhaseTimer timer(profile, PH_LEARNING, range.region + 1);
+        ESPathway[range.region].accumulateLearning(range.first, range.last, restart);
+    }
+}
+
+void Network::applyAccumulatedLearning(unsigned int steps) {
+    
+    int thread = threadNumber();
+    
+    for(unsigned r = 0;r < learningPartition[thread].size();r++) {
+        const NeuronRange & range = learningPartition[thread][r];
+        PhaseTimer timer(profile, PH_LEARNING, range.region + 1);
+        ESPathway[range.region].applyAccumulatedLearning(range.first, range.last, steps);
+    }
+}
+
+bool Network::isCheckpointDue(time_t lastCheckpoint) {
+    
+    return checkpointRequested || (p.checkpointInterval > 0 && difftime(time(NULL), lastCheckpoint) >= p.checkpointInterval);
+}
+
+void Network::doTimeSteps(bool save, unsigned long int timeStep, bool safePoint, time_t lastCheckpoint) {
+    
+    int thread = threadNumber();
+    
+    // Update/Save neuron level data, regions not stepped only save
+    for(unsigned r = 0;r < timeStepPartition[thread].size();r++) {
+        
+        const NeuronRange & range = timeStepPartition[thread][r];
+        PhaseTimer timer(profile, save ? PH_HISTORY_SAVE : PH_TIME_STEP, range.region + 1);
+        
+        if(isStepped(range.region, timeStep))
+            ESPathway[range.region].doTimeStep(range.first, range.last, save);
+        else
+            ESPathway[range.region].holdTimeStep(range.first, range.last, save);
+    }
+    
+    // Save region level data, the implicit barrier ends the time step
+    TraceSpan wait(trace, "wait time step");
+    
+#pragma omp single
+    {
+        if(save)
+            for(unsigned k = 0;k < ESPathway.size();k++)
+                ESPathway[k].saveRegionState();
+        
+        checkpointDue = safePoint && isCheckpointDue(lastCheckpoint);
+    }
+}
+
+// Same work as the time step loop in runContinous(), but the phases of each
+// region are tasks ordered only by what they read and write: region k reads
+// firing rates of layer k (0 = input) and its own state, and a time step
+// replaces firing rates of layer k+1 only once everybody has read them.
+// So regions, and successive time steps of different regions, overlap.
+void Network::runObjectAsTasks(u_short epoch, u_short object, unsigned long int firstTimeStep, bool isTraining, const string & checkpointFile, time_t & lastCheckpoint) {
+    
+    // Only the addresses are used, in depend clauses, which compilers do not count as a use
+    vector<char> layers(ESPathway.size() + 1), states(ESPathway.size());
+    char * layer = &layers[0];
+    char * state = &states[0];
+    (void)layer;
+    (void)state;
+    
+    // Steps summed since weights last changed, p.trainAtTimeStepMultiple > 1
+    unsigned int accumulatedSteps = 0;
+    
+    for(unsigned long int t = firstTimeStep; t < area7a.timeStepsInObject[object];t++) {
+        
+        // Layer-wise training replays the input of the trained region, see setupLayer()
+        if(replayingLayer) {
+#pragma omp task depend(out: layer[trainedLayer:1])
+            cacheLayer(object, t, 0, ESPathway[trainedLayer - 1].getNrOfNeurons());
+        } else {
+#pragma omp task depend(out: layer[0:1])
+            area7a.setFiringRateTasks(object, t);
+        }
+        
+        if(recordingLayer) {
+#pragma omp task depend(in: layer[trainedLayer:1])
+            cacheLayer(object, t, 0, ESPathway[trainedLayer - 1].getNrOfNeurons());
+        }
+        
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            if(isSimulated(k) && isStepped(k, t)) {
+#pragma omp task depend(in: layer[k:1]) depend(inout: state[k:1])
+                ESPathway[k].computeNewFiringRateTasks();
+            }
+        
+        if(isTraining && p.trainAtTimeStepMultiple > 1) {
+            
+            bool apply = accumulatedSteps + 1 == p.trainAtTimeStepMultiple || t + 1 == area7a.timeStepsInObject[object];
+            
+            for(unsigned k = 0;k < ESPathway.size();k++)
+                if(isLearning(k)) {
+#pragma omp task depend(in: layer[k:1], layer[k+1:1]) depend(inout: state[k:1])
+                    ESPathway[k].accumulateLearningTasks(accumulatedSteps, apply);
+                }
+            
+            accumulatedSteps = apply ? 0 : accumulatedSteps + 1;
+            
+        } else if(isTraining)
+            for(unsigned k = 0;k < ESPathway.size();k++)
+                if(isLearning(k) && isStepped(k, t)) {
+#pragma omp task depend(in: layer[k:1], layer[k+1:1]) depend(inout: state[k:1])
+                    ESPathway[k].applyLearningRuleTasks();
+                }
+        
+        bool save = ((t+1) % p.outputAtTimeStepMultiple) == 0;
+        
+        for(unsigned k = 0;k < ESPathway.size();k++)
+            if(isStepped(k, t)) {
+#pragma omp task depend(out: layer[k+1:1]) depend(inout: state[k:1])
+                ESPathway[k].doTimeStepTasks(save);
+            } else if(save) {
+#pragma omp task depend(in: layer[k+1:1]) depend(inout: state[k:1])
+                ESPathway[k].holdTimeStepTasks(save);
+            }
+        
+        // Safe point only when needed, and no sums are pending
+        if(isTraining && accumulatedSteps == 0) {
+            
+            if(isCheckpointDue(lastCheckpoint)) {
+                
+#pragma omp taskwait
+                
+                cout << "Saving checkpoint: epoch #" << epoch << ", object #" << object << ", step #" << t+1 << endl;
+                outputCheckpoint(checkpointFile.c_str(), epoch, object, t+1);
+                lastCheckpoint = time(NULL);
+                
+                // All threads see this after the implicit barrier
+                interrupted = (checkpointRequested != 0);
+                
+                if(interrupted)
+                    break;
+            }
+        }
+    }
+}
+
+void Network::outputHistory(const char * outputDirectory, bool isTraining) {
+    
+    if(isTraining) { // Output neuronal and synaptic training data
+        
+        if(p.saveSingleCells)
+            outputSingleUnits(outputDirectory);
+        
+        if(p.saveAllNeuronsAndSynapsesInRegion)
+            outputSynapticHistory(outputDirectory);
+    }
+    
+    // Output region data
+    outputRegionHistory(outputDirectory, isTraining);
+    
+    // Output neuronal data
+    
+    // Do a small check to see that
+    // we have anything to save, saves us from dumping
+    // empty files
+    if(!isTraining || p.saveAllNeuronsAndSynapsesInRegion || p.saveAllNeuronsInRegion) {
+        
+        DATA recorded[] = {FIRING_RATE, ACTIVATION, INHIBITED_ACTIVATION, TRACE, STIMULATION, EFFECTIVE_TRACE};
+        
+        for(unsigned d = 0;d < sizeof(recorded)/sizeof(recorded[0]);d++)
+            if(options.recordedData & (1 << recorded[d]))
+                outputNeuronHistoryData(outputDirectory, isTraining, recorded[d]);
+    }
+}
+
+void Network::openHistoryFile(BinaryWrite & file, const char * outputDirectory, const char * filename, bool isTraining, OUTPUT_FILE fileType) {
+    
+    string s(outputDirectory);
+    s.append(filename);
+    
+    file.exitOnFailure = !options.throwOutputErrors;
+    file.openFile(s);
+    
+    // Header
+    file << (isTraining ? epochsCompleted : U_SHORT_1); // less than p.nrOfEpochs if weights converged
+    file << p.numberOfLayers;
+    file << area7a.nrOfObjects;
+    
+    // Iterate and output size of each
+    for(u_short o = 0; o < area7a.nrOfObjects;o++)
+        file << area7a.outputtedTimeStepsInObject[o];
+    
+    // Input layer dimensions
+    file << area7a.horVisualDimension;
+    file << area7a.horEyeDimension;
+    file << area7a.depth;
+    file << U_SHORT_0; // Never present
+    
+    // Hidden layer description
+    for(u_short k = 0;k < ESPathway.size();k++) {
+        
+        u_short isPresent = 0;
+        
+        switch (fileType) {
+                
+            case OF_REGIONAL:
                 isPresent = 1;
                 break;
             case OF_REGION_NEURONAL:
@@ -581,18 +1681,6 @@ void Network::outputSynapticHistory(const char * outputDirectory) {
 }
 
 
-// dnavarro2016 convergence
-int Network::outputConvergence() {
-    vector<float> total_square_synapses(2);
-    
-    int remove_this_return_value = -1989;
-    for(u_short k = 0;k < ESPathway.size();k++) {
-        previous_epoch_synapses = ESPathway[k].getAllAfferentSyanpsesForCurrentEpoch();
-    }
-    
-    return remove_this_return_value;
-}
-
 void Network::outputFinalNetwork(const char * outputWeightFile) {
     
     BinaryWrite file(outputWeightFile);
@@ -620,3 +1708,147 @@ void Network::outputFinalNetwork(const char * outputWeightFile) {
     
     file.close();
 }
+
+
+void Network::outputCheckpoint(const char * checkpointFile, u_short epoch, u_short object, unsigned long int timeStep) {
+    
+    // Write to temporary file and rename, so a kill during
+    // writing never destroys the last good checkpoint
+    string tmpFile(checkpointFile);
+    tmpFile.append(".tmp");
+    
+    BinaryWrite file(tmpFile);
+    
+    // Header
+    file << static_cast<unsigned int>(CHECKPOINT_MAGIC) << CHECKPOINT_VERSION;
+    file << p.numberOfLayers;
+    file << area7a.horVisualDimension << area7a.horEyeDimension << area7a.depth;
+    
+    for(u_short k = 0;k < ESPathway.size();k++)
+        file << ESPathway[k].verDimension << ESPathway[k].horDimension << ESPathway[k].depth;
+    
+    // Position, the next step to run
+    file << epoch << object << timeStep;
+    
+    // RNG
+    unsigned long long rngSize = gsl_rng_size(rngController);
+    const char * rngState = static_cast<const char *>(gsl_rng_state(rngController));
+    file << rngSize;
+    for(unsigned long long i = 0;i < rngSize;i++)
+        file << rngState[i];
+    
+    // Regions, incl. neuron state and synapses
+    for(u_short k = 0;k < ESPathway.size();k++)
+        ESPathway[k].outputState(file);
+    
+    // Layer-wise training schedule and firing rates cached so far, see setupLayer()
+    file << trainedLayer << recordingLayer << replayingLayer << layerCached;
+    file << static_cast<unsigned long long>(layerCache.size());
+    
+    for(unsigned o = 0;o < layerCache.size();o++)
+        file.writeBuffer(layerCache[o]);
+    
+    file.close();
+    
+    if(rename(tmpFile.c_str(), checkpointFile) != 0) {
+        
+        cerr << "Unable to move checkpoint into place: error = " << strerror(errno) << ", file = " << checkpointFile << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+}
+
+void Network::loadCheckpoint(const char * checkpointFile) {
+    
+    BinaryRead file(checkpointFile);
+    
+    try {
+        
+        unsigned int magic;
+        u_short version, numberOfLayers, verDimension, horDimension, depth;
+        
+        file >> magic >> version;
+        
+        if(magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+            
+            cerr << "Not a checkpoint file, or unsupported version: " << checkpointFile << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+        
+        // Architecture must match parameter file
+        file >> numberOfLayers >> verDimension >> horDimension >> depth;
+        
+        bool matches = (numberOfLayers == p.numberOfLayers &&
+                        verDimension == area7a.horVisualDimension &&
+                        horDimension == area7a.horEyeDimension &&
+                        depth == area7a.depth);
+        
+        for(u_short k = 0;matches && k < ESPathway.size();k++) {
+            
+            file >> verDimension >> horDimension >> depth;
+            matches = (verDimension == ESPathway[k].verDimension && horDimension == ESPathway[k].horDimension && depth == ESPathway[k].depth);
+        }
+        
+        if(!matches) {
+            
+            cerr << "Checkpoint does not match the network in the parameter file: " << checkpointFile << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+        
+        file >> startEpoch >> startObject >> startTimeStep;
+        
+        // RNG
+        unsigned long long rngSize;
+        file >> rngSize;
+        
+        if(rngSize != gsl_rng_size(rngController)) {
+            
+            cerr << "RNG state size in checkpoint does not match." << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+        
+        char * rngState = static_cast<char *>(gsl_rng_state(rngController));
+        for(unsigned long long i = 0;i < rngSize;i++)
+            file >> rngState[i];
+        
+        // Presynaptic lookup
+        vector<Region *> regions;
+        regions.push_back(&area7a);
+        for(u_short k = 0;k < ESPathway.size();k++)
+            regions.push_back(&ESPathway[k]);
+        
+        for(u_short k = 0;k < ESPathway.size();k++)
+            ESPathway[k].loadState(file, regions);
+        
+        unsigned long long cachedObjects;
+        file >> trainedLayer >> recordingLayer >> replayingLayer >> layerCached;
+        file >> cachedObjects;
+        
+        layerCache.resize(cachedObjects);
+        
+        for(unsigned o = 0;o < layerCache.size();o++)
+            file.readBuffer(layerCache[o], false);
+        
+        // Checkpoint of layer-wise training resumed without it
+        if(!p.layerwise) {
+            trainedLayer = -1;
+            recordingLayer = replayingLayer = layerCached = false;
+            vector<RegionBuffer>().swap(layerCache);
+        }
+        
+    } catch(fstream::failure e) {
+        
+        cerr << "Failed while reading checkpoint: " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    file.close();
+    
+    resuming = true;
+    
+    cout << "Resuming from checkpoint: epoch #" << startEpoch << ", object #" << startObject << ", step #" << startTimeStep << endl;
+}
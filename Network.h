@@ -9,6 +9,7 @@
 #define NETWORK_H
 
 // Forward declarations
+namespace libconfig { class Setting; }
 class HiddenNeuron;
 class BinaryWrite;
 class HiddenRegion;
@@ -17,15 +18,74 @@ class InputRegion;
 // Includes
 #include "InputRegion.h"
 #include "Param.h"
+#include "Profile.h"
+#include "Telemetry.h"
+#include "RegionMemory.h"
 #include <vector>
+#include <string>
+#include <ctime>
 #include "Utilities.h"
 #include <gsl/gsl_cdf.h>
 #include <gsl/gsl_randist.h>
 
 using std::vector;
+using std::string;
+
+#define ALL_RECORDED_DATA ((1 << FIRING_RATE) | (1 << ACTIVATION) | (1 << INHIBITED_ACTIVATION) | (1 << TRACE) | (1 << STIMULATION) | (1 << EFFECTIVE_TRACE))
+
+// Options of runContinous() that do not change results
+struct RunOptions {
+    
+    // Run time steps as a task graph with per region dependencies
+    // instead of barriers between phases, see runObjectAsTasks()
+    bool taskScheduling;
+    
+    // Write Profile.json and Profile.csv with time per phase and region to
+    // the output directory (not with taskScheduling)
+    bool profiling;
+    
+    // Write Trace.json with a span per thread for every region phase and
+    // wait, of every traceInterval-th time step and at most traceMaxSpans
+    // spans per thread (not with taskScheduling)
+    bool tracing;
+    unsigned long traceInterval;
+    unsigned long traceMaxSpans;
+    
+    // Add hardware counters (cycles, instructions, last level cache and
+    // dTLB misses) of every phase and region to the profile, implies
+    // profiling, Linux only
+    bool counting;
+    
+    // Append a JSON line of progress to this file or FIFO every
+    // telemetryInterval seconds, none when empty, see Telemetry
+    string telemetryFile;
+    double telemetryInterval;
+    
+    // Neuron history files written, bit 1 << d for each DATA d from
+    // FIRING_RATE to EFFECTIVE_TRACE, all by default
+    unsigned recordedData;
+    
+    // History files that cannot be written throw std::runtime_error out of
+    // runContinous() instead of ending the process, see Server
+    bool throwOutputErrors;
+    
+    RunOptions() : taskScheduling(false), profiling(false), tracing(false), traceInterval(1), traceMaxSpans(200000), counting(false), telemetryInterval(10), recordedData(ALL_RECORDED_DATA), throwOutputErrors(false) {}
+};
+
+// Neurons [first, last) of ESPathway[region], numbered as in HiddenRegion
+struct NeuronRange {
+    u_short region;
+    unsigned int first, last;
+};
 
 class Network {
     
+    // Trains several networks in lock step
+    friend class Ensemble;
+    
+    // Times the phases of a time step one at a time (bench/)
+    friend class Benchmark;
+    
     private:
     
         // Output FILE types
@@ -44,7 +104,12 @@ class Network {
         void outputSingleUnits(const char * outputDirectory);
         void outputSynapticHistory(const char * outputDirectory);
     
+        // Time steps of one object, called by one thread of the team
+        void runObjectAsTasks(u_short epoch, u_short object, unsigned long int firstTimeStep, bool isTraining, const string & checkpointFile, time_t & lastCheckpoint);
+    
         // Utility functions
+        void initRegions(bool isTraining);
+        void loadNetwork(const char * inputWeightFile, bool isTraining);
         void buildESPathway();
         void setupAfferentSynapsesV2();
 		void setupAfferentSynapsesForV3AndAbove(u_short esPathwayIndex);
@@ -52,20 +117,110 @@ class Network {
 
 		bool verbose;
 		Param p;
+    
+        // Where runContinous() picks up, set by loadCheckpoint()
+        bool resuming;
+        u_short startEpoch;
+        u_short startObject;
+        unsigned long int startTimeStep;
+    
+        // Each phase of a time step is split over all regions at once into one
+        // list of neuron ranges per thread with about the same number of afferent
+        // synapses (neurons for phases without synapses), see setupPartition()
+        typedef vector<vector<NeuronRange> > Partition;
+        int partitionThreads;
+        Partition stimulationPartition;
+        Partition filterPartition;
+        Partition firingRatePartition;
+        Partition learningPartition;
+        Partition timeStepPartition;
+        void setupPartition(int threads);
+        void splitNeurons(Partition & partition, const vector<unsigned int> & count, bool bySynapses, int threads);
+        void placeRegionMemory();
+    
+        // Efferent synapses for p.pushEpsilon >= 0, once synapses stay where they are
+        void setupPushPropagation();
+    
+        // Efferent synapses for p.plasticityThreshold >= 0 without CLASSIC normalization
+        void setupGatedLearning();
+    
+        // Sums for p.trainAtTimeStepMultiple > 1, see HiddenRegion::accumulateLearning()
+        void setupAccumulatedLearning();
+
+        // p.pruneThreshold > 0 or p.pruneKeep > 0, learning regions after an epoch
+        void pruneSynapses();
+    
+        // Layer-wise training (p.layerwise): region trainedLayer alone learns,
+        // lower regions are frozen and higher ones idle. The firing rates it
+        // reads are recorded in the first epoch of the layer and replayed in
+        // later ones instead of simulating area7a and the lower regions again,
+        // -1 = all regions simulated and learning, see setupLayer(). Regions not
+        // simulated save NaN history (HiddenRegion::setIdle()). The cache is
+        // held in memory and written to checkpoints, so --resume continues
+        // recording or replaying it instead of recording the layer again
+        int trainedLayer;
+        bool recordingLayer;
+        bool replayingLayer;
+        bool layerCached;
+        vector<RegionBuffer> layerCache; // per object, time step by neuron of region below trainedLayer
+        int layerOfEpoch(u_short epoch);
+        void checkLayers();
+        void setupLayer(u_short epoch, bool resumedEpoch);
+        bool isSimulated(unsigned k);
+        bool isLearning(unsigned k);
+        bool isStepped(unsigned k, unsigned long int timeStep); // p.multiRate
+        void cacheLayer(u_short object, unsigned long int timeStep);
+        void cacheLayer(u_short object, unsigned long int timeStep, unsigned int first, unsigned int last);
+    
+        // Phase timing and timeline of last run, see Profile and Trace
+        Profile profile;
+        Trace trace;
+        PerfCounters counters;
+        void setupProfile(int threads);
+        void setupProfileWork(int threads); // again when synapses are pruned
+    
+        // Progress of last run, see Telemetry
+        Telemetry telemetry;
+        unsigned long long synapseUpdatesPerTimeStep(bool isTraining);
+    
+        // Phases of a time step, called by every thread of the team
+        void computeNewFiringRates(unsigned long int timeStep);
+        void applyLearningRules(unsigned long int timeStep);
+        void accumulateLearning(bool restart);
+        void applyAccumulatedLearning(unsigned int steps);
+        void doTimeSteps(bool save, unsigned long int timeStep, bool safePoint = false, time_t lastCheckpoint = 0);
 	
     public:
     	vector<HiddenRegion> ESPathway;
     	InputRegion area7a;
         gsl_rng * rngController;
     
-    // dnavarro2016 convergence
-    vector<vector<Synapse>> previous_epoch_synapses;
+        // Set when training stopped on SIGTERM/SIGINT after writing a checkpoint
+        bool interrupted;
+    
+        // Set by doTimeSteps() at a safe point when a checkpoint is requested or
+        // p.checkpointInterval passed, read by all threads after its barrier
+        bool checkpointDue;
+        bool isCheckpointDue(time_t lastCheckpoint);
+    
+        // Set when training stopped because weights converged (p.convergenceTolerance)
+        bool converged;
+        u_short epochsCompleted;
+    
+        // How runContinous() runs, from the command line
+        RunOptions options;
     	
 		// Build new network based on these parameters
 		Network(const char * parameterFile, bool verbose);
 	
-    	// Load network from weight file
-    	Network(const char * dataFile, const char * parameterFile, bool verbose, const char * inputWeightFile, bool isTraining);
+    	// Load network from weight file, overrides are merged into parameter file (sweep)
+    	Network(const char * dataFile, const char * parameterFile, bool verbose, const char * inputWeightFile, bool isTraining, const libconfig::Setting * overrides = NULL);
+    
+        // Load network from weight file, with input data shared with another network
+        Network(const InputRegion & sharedInput, const char * parameterFile, bool verbose, const char * inputWeightFile, bool isTraining, const libconfig::Setting * overrides = NULL);
+    
+        // Test network for data file, with the frozen weights of trained, which must outlive it
+        Network(const char * dataFile, const Network & trained);
     	    	
     	// Destructor, frees ESPathway and rngController
     	~Network();
@@ -76,11 +231,16 @@ class Network {
     	void run(const char * outputDirectory, bool isTraining, int numberOfThreads, bool xgrid);
 		u_short runContinous(const char * outputDirectory, bool isTraining, bool xgrid);
 	
-    	// Save final weights of network
-        // dnavarro2016 convergence
-        int outputConvergence();
+        // Testing only, done by runContinous() when not training, see HiddenRegion::freezeSynapses()
+        void freezeWeights();
     
+    	// Save final weights of network
         void outputFinalNetwork(const char * outputWeightFile);
+    
+        // Full training state, loadCheckpoint() must be called on a network
+        // loaded with the same parameter file, and before run()
+        void outputCheckpoint(const char * checkpointFile, u_short epoch, u_short object, unsigned long int timeStep);
+        void loadCheckpoint(const char * checkpointFile);
 };
 
 #endif // NETWORK_H
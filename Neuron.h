@@ -37,10 +37,9 @@ class Neuron {
 	
 		// Init
         void init(Region * region, u_short depth, u_short row, u_short col);
-                
-    private:
-        
-        //vector<const Synapse *> efferentLink;
+    
+        // Efferent synapses (push propagation) are kept in one array by the
+        // postsynaptic region, see HiddenRegion::setupEfferentSynapses()
 };
 
 #endif // NEURON_H
@@ -11,19 +11,96 @@
 #include <libconfig.h++>
 #include <cmath>
 #include <cfloat>
+#include <climits>
 
 using namespace libconfig;
 using std::cerr;
 using std::endl;
 using std::cout;
 
-Param::Param(const char * filename, bool isTraining) {
+// Copy value of source into empty target of same type
+static void assignSetting(Setting & target, const Setting & source) {
+    
+    switch (source.getType()) {
+            
+        case Setting::TypeInt:
+            target = static_cast<int>(source);
+            break;
+        case Setting::TypeInt64:
+            target = static_cast<long long>(source);
+            break;
+        case Setting::TypeFloat:
+            target = static_cast<double>(source);
+            break;
+        case Setting::TypeBoolean:
+            target = static_cast<bool>(source);
+            break;
+        case Setting::TypeString:
+            target = static_cast<const char *>(source);
+            break;
+        default:
+            
+            for(int i = 0;i < source.getLength();i++) {
+                
+                if(source.isGroup())
+                    assignSetting(target.add(source[i].getName(), source[i].getType()), source[i]);
+                else
+                    assignSetting(target.add(source[i].getType()), source[i]);
+            }
+            
+            break;
+    }
+}
+
+// Groups are merged by name, lists of groups (extrastriate) element by element,
+// everything else in source replaces what is in target
+static void mergeSettings(Setting & target, const Setting & source) {
+    
+    for(int i = 0;i < source.getLength();i++) {
+        
+        const Setting & s = source[i];
+        Setting * t = NULL;
+        
+        if(target.isGroup()) {
+            
+            if(target.exists(s.getName()))
+                t = &target[s.getName()];
+            
+        } else if(i < target.getLength())
+            t = &target[i];
+        
+        bool isListOfGroups = s.isList() && s.getLength() > 0 && s[0].isGroup();
+        
+        if(t != NULL && ((s.isGroup() && t->isGroup()) || (isListOfGroups && t->isList())))
+            mergeSettings(*t, s);
+        else if(target.isGroup()) {
+            
+            if(t != NULL)
+                target.remove(s.getName());
+            
+            assignSetting(target.add(s.getName(), s.getType()), s);
+            
+        } else if(t == NULL)
+            assignSetting(target.add(s.getType()), s);
+        else {
+            
+            cerr << "Only groups can be overridden inside a list, element #" << i << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+Param::Param(const char * filename, bool isTraining, const Setting * overrides) {
 
     Config cfg;
 
 	try
 	{
 		cfg.readFile(filename);
+        
+        if(overrides != NULL)
+            mergeSettings(cfg.getRoot(), *overrides);
 
 		int tmp;
         
@@ -35,6 +112,18 @@ Param::Param(const char * filename, bool isTraining) {
 		cfg.lookupValue("resetActivity", resetActivity);
 		cfg.lookupValue("outputAtTimeStepMultiple", tmp);
 		outputAtTimeStepMultiple = static_cast<u_short>(tmp);
+        
+        // Optional, old parameter files do not have it
+        tmp = 1;
+        cfg.lookupValue("trainAtTimeStepMultiple", tmp);
+        trainAtTimeStepMultiple = static_cast<u_short>(tmp);
+        
+        tmp = EULER;
+        cfg.lookupValue("integrator", tmp);
+        integrator = static_cast<INTEGRATOR>(tmp);
+        
+        multiRate = false;
+        cfg.lookupValue("multiRate", multiRate);
 		
 		// training
 		cfg.lookupValue("training.rule", tmp);
@@ -46,6 +135,26 @@ Param::Param(const char * filename, bool isTraining) {
 		saveNetworkAtEpochMultiple = static_cast<u_short>(tmp);
 		cfg.lookupValue("training.nrOfEpochs", tmp);
 		nrOfEpochs = static_cast<u_short>(tmp);
+        
+        // Optional, old parameter files do not have it
+        checkpointInterval = 0;
+        cfg.lookupValue("training.checkpointInterval", checkpointInterval);
+        
+        convergenceTolerance = 0;
+        cfg.lookupValue("training.convergenceTolerance", convergenceTolerance);
+        
+        layerwise = false;
+        cfg.lookupValue("training.layerwise", layerwise);
+        
+        plasticityThreshold = -1;
+        cfg.lookupValue("training.plasticityThreshold", plasticityThreshold);
+        
+        pruneThreshold = 0;
+        cfg.lookupValue("training.pruneThreshold", pruneThreshold);
+        
+        tmp = 0;
+        cfg.lookupValue("training.pruneKeep", tmp);
+        pruneKeep = static_cast<u_short>(tmp);
 		
 		// general        
 		cfg.lookupValue("feedback", tmp);
@@ -59,12 +168,24 @@ Param::Param(const char * filename, bool isTraining) {
 		
         cfg.lookupValue("weightVectorLength", weightVectorLength);
         
+        // Optional, old parameter files do not have it
+        tmp = FP32;
+        cfg.lookupValue("weightPrecision", tmp);
+        weightPrecision = static_cast<WEIGHTPRECISION>(tmp);
+        
 		cfg.lookupValue("sparsenessRoutine", tmp);
 		sparsenessRoutine = static_cast<SPARSENESSROUTINE>(tmp);
 		
 		cfg.lookupValue("lateralInteraction", tmp);
 		lateralInteraction = static_cast<LATERAL>(tmp);
         
+        // Optional, old parameter files do not have it
+        pushEpsilon = -1;
+        cfg.lookupValue("pushEpsilon", pushEpsilon);
+        
+        sortSynapses = false;
+        cfg.lookupValue("sortSynapses", sortSynapses);
+        
         // For some reason, no exception is generated when these are not in param file!!
         //cfg.lookupValue("blockageLeakTime", blockageLeakTime);
         //cfg.lookupValue("blockageRiseTime", blockageRiseTime);
@@ -219,6 +340,31 @@ Param::Param(const char * filename, bool isTraining) {
 	// add more exception support later, more cases, catch them all!
 }
 
+void Param::writeMerged(const char * filename, const Setting * overrides, const char * outputFile) {
+    
+    Config cfg;
+    
+    try {
+        
+        cfg.readFile(filename);
+        
+        if(overrides != NULL)
+            mergeSettings(cfg.getRoot(), *overrides);
+        
+        cfg.writeFile(outputFile);
+    }
+    catch(const FileIOException &fioex) {
+        cerr << "I/O error while writing parameter file: " << outputFile << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    catch(const ConfigException &cex) {
+        cerr << "Unable to merge parameter file: " << filename << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+}
+
 void Param::validate(bool isTraining) {
 
     // We start out with the global trace time constant as the upper bound
@@ -239,6 +385,70 @@ void Param::validate(bool isTraining) {
     
 	cout << "frac = " << stepSizeFraction << ", min_i {tau_i} = " << smallestTimeConstant << ", dt = " << stepSize << endl;
     
+    // A region takes as many base steps at once as its own and the trace time constant allow
+    stepMultiples.assign(timeConstants.size(), 1);
+    
+    if(multiRate) {
+        
+        if(trainAtTimeStepMultiple > 1) {
+            cerr << "multiRate cannot be combined with trainAtTimeStepMultiple > 1." << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+        
+        cout << "Multi-rate steps:";
+        
+        for(unsigned i = 0;i < timeConstants.size();i++) {
+            
+            float regionTimeConstant = timeConstants[i] < traceTimeConstant ? timeConstants[i] : traceTimeConstant;
+            stepMultiples[i] = static_cast<u_short>(regionTimeConstant / smallestTimeConstant);
+            cout << (i > 0 ? "," : "") << " region #" << i+1 << " every " << stepMultiples[i];
+        }
+        
+        cout << " step(s)" << endl;
+    }
+    
+    // Layers are trained one after the other, each for its own number of epochs
+    if(layerwise) {
+        
+        unsigned int totalEpochs = 0;
+        
+        for(unsigned i = 0;i < epochs.size();i++)
+            totalEpochs += epochs[i];
+        
+        if(totalEpochs > USHRT_MAX) {
+            cerr << "Layer-wise training has too many epochs: " << totalEpochs << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+        
+        nrOfEpochs = static_cast<u_short>(totalEpochs);
+        cout << "Layer-wise training, nrOfEpochs = " << nrOfEpochs << " summed over layers." << endl;
+        
+        if(convergenceTolerance > 0) {
+            cout << "convergenceTolerance is ignored in layer-wise training." << endl;
+            convergenceTolerance = 0;
+        }
+    }
+    
+    if(trainAtTimeStepMultiple < 1) {
+        cerr << "trainAtTimeStepMultiple must be at least 1." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    if(trainAtTimeStepMultiple > 1 && plasticityThreshold >= 0) {
+        cerr << "trainAtTimeStepMultiple > 1 cannot be combined with training.plasticityThreshold." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    if(pruneThreshold < 0) {
+        cerr << "training.pruneThreshold cannot be negative." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
 	if(nrOfEpochs < 1) {
 		cerr << "No training epochs, nrOfEpochs = 0." << endl;
 		cerr.flush();
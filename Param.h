@@ -9,10 +9,14 @@
 #define PARAM_H
 
 #include <vector>
+#include <cstddef>
 #include "Utilities.h"
 
 using std::vector;
 
+// Forward declarations
+namespace libconfig { class Setting; }
+
 // Read parameter file for full explanation
 enum FEEDBACK {   
     
@@ -37,7 +41,21 @@ enum SPARSENESSROUTINE   {
 enum WEIGHTNORMALIZATION {  
     
     NONORMALIZATION = 0,
-    CLASSIC = 1 
+    CLASSIC = 1,
+    SCALED = 2      // CLASSIC, with each neuron's weights kept as raw values times a scale factor
+};
+
+enum WEIGHTPRECISION {
+    
+    FP32 = 0,
+    BF16 = 1,       // frozen weights and synapse history, learning keeps float weights
+    INT8 = 2        // frozen weights with per-neuron scales, and firing rates they read, 7 bit
+};
+
+enum INTEGRATOR {
+    
+    EULER = 0,
+    EXPONENTIAL = 1     // exact for leaky activation and trace over a step, given their input
 };
 
 enum INPUT_ENCODING {
@@ -85,6 +103,10 @@ class Param  {
 		u_short seed;
 		u_short nrOfEpochs;
 		u_short outputAtTimeStepMultiple;
+		u_short trainAtTimeStepMultiple; // weights change every this many steps, from sums of the steps in between, 1 = every step
+        INTEGRATOR integrator;
+        bool multiRate; // region k advances every stepMultiples[k] steps, as its time constants allow
+        vector<u_short> stepMultiples; // set by validate(), all 1 without multiRate
 		u_short saveNetworkAtEpochMultiple;
 		float traceTimeConstant;
         float covarianceThreshold;
@@ -92,6 +114,12 @@ class Param  {
 		bool resetTrace;
 		bool resetActivity;
 		bool saveNetwork;
+        float checkpointInterval; // seconds between training checkpoints, 0 = only on SIGTERM/SIGINT
+        float convergenceTolerance; // stop when RMS weight change of every region is below this after an epoch, 0 = never
+        bool layerwise; // layer k alone learns for epochs[k] epochs, lowest first, then is frozen
+        float plasticityThreshold; // only neurons whose postsynaptic factor, and synapses whose presynaptic firing rate, is above this learn, < 0 = all, 0 is not bit-identical to it
+        float pruneThreshold; // after each epoch but the last, learning regions drop synapses whose |weight| is below this, 0 = never
+        u_short pruneKeep; // after each epoch but the last, learning regions keep only this many strongest synapses per neuron, 0 = all
     
         float weightVectorLength;
 
@@ -144,12 +172,21 @@ class Param  {
         vector<vector<vector<short> > > recordedSingleCells; // Should be bool, but STL is fucked up!
         
 		WEIGHTNORMALIZATION weightNormalization;
+        WEIGHTPRECISION weightPrecision;
 		SPARSENESSROUTINE sparsenessRoutine;
 		FEEDBACK feedback;
 		LEARNING_RULE rule;
 		INITIALWEIGHT initialWeight;
 		LATERAL lateralInteraction;
     
+        // Presynaptic firing rates above this are pushed through efferent
+        // synapses, the others are dropped, < 0 = every afferent synapse is read
+        float pushEpsilon;
+    
+        // Afferent synapses of each neuron are put in presynaptic region and
+        // neuron order after building and loading, false = order of the file
+        bool sortSynapses;
+    
         // Values derived from other parameters
         float stepSize;
         u_short numberOfLayers;
@@ -159,8 +196,11 @@ class Param  {
         bool saveAllNeuronsInRegion;
         bool saveSingleCells;
     
-    	// Constructor
-    	Param(const char * filename, bool isTraining);
+    	// Constructor, settings in overrides replace those in file
+    	Param(const char * filename, bool isTraining, const libconfig::Setting * overrides = NULL);
+    
+        // Writes the file with overrides merged, as the constructor reads it
+        static void writeMerged(const char * filename, const libconfig::Setting * overrides, const char * outputFile);
 
 	private:
 	
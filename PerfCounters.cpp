@@ -0,0 +1,196 @@
+/*
+ *  PerfCounters.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "PerfCounters.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+    #include <unistd.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <linux/perf_event.h>
+#endif
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+static int threadNumber() {
+#ifdef OMP_ENABLE
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+static int openCounter(COUNTER counter, int groupFd) {
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.disabled = groupFd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    switch(counter) {
+        case PC_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PC_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PC_LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PC_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+    }
+
+    // Calling thread on any cpu
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+#endif
+
+PerfCounters::PerfCounters() : warned(false), enabled(false) {
+
+    for(int c = 0;c < NR_OF_COUNTERS;c++)
+        available[c] = false;
+}
+
+void PerfCounters::init(int threads) {
+
+    ThreadCounters closed;
+
+    for(int c = 0;c < NR_OF_COUNTERS;c++) {
+        closed.fd[c] = -1;
+        closed.position[c] = -1;
+        available[c] = false;
+    }
+
+    closed.opened = 0;
+
+    this->threads.assign(threads, closed);
+}
+
+void PerfCounters::openThread() {
+
+    int thread = threadNumber();
+
+    if(!enabled || thread >= static_cast<int>(threads.size()))
+        return;
+
+    ThreadCounters & counters = threads[thread];
+
+#ifdef __linux__
+    // Cycles lead the group, a member the cpu lacks is left out
+    counters.fd[PC_CYCLES] = openCounter(PC_CYCLES, -1);
+
+    int error = errno;
+
+    if(counters.fd[PC_CYCLES] != -1) {
+
+        counters.position[PC_CYCLES] = counters.opened++;
+
+        for(int c = PC_CYCLES + 1;c < NR_OF_COUNTERS;c++) {
+
+            counters.fd[c] = openCounter(static_cast<COUNTER>(c), counters.fd[PC_CYCLES]);
+
+            if(counters.fd[c] != -1)
+                counters.position[c] = counters.opened++;
+        }
+
+        ioctl(counters.fd[PC_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(counters.fd[PC_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    #pragma omp critical
+    {
+        for(int c = 0;c < NR_OF_COUNTERS;c++)
+            available[c] = available[c] || counters.fd[c] != -1;
+
+        if(counters.fd[PC_CYCLES] == -1 && !warned) {
+
+            cout << "Hardware counters are unavailable (" << strerror(error) << "), see /proc/sys/kernel/perf_event_paranoid, profile has no counters." << endl;
+            warned = true;
+        }
+    }
+#else
+    #pragma omp critical
+    {
+        if(!warned) {
+
+            cout << "Hardware counters need Linux perf_event_open, profile has no counters." << endl;
+            warned = true;
+        }
+    }
+#endif
+}
+
+void PerfCounters::closeThread() {
+
+    int thread = threadNumber();
+
+    if(!enabled || thread >= static_cast<int>(threads.size()))
+        return;
+
+    ThreadCounters & counters = threads[thread];
+
+    // Members first, then leader
+    for(int c = NR_OF_COUNTERS - 1;c >= 0;c--) {
+
+#ifdef __linux__
+        if(counters.fd[c] != -1)
+            close(counters.fd[c]);
+#endif
+        counters.fd[c] = -1;
+        counters.position[c] = -1;
+    }
+
+    counters.opened = 0;
+}
+
+bool PerfCounters::read(unsigned long long values[NR_OF_COUNTERS]) {
+
+    int thread = threadNumber();
+
+    if(!enabled || thread >= static_cast<int>(threads.size()))
+        return false;
+
+    ThreadCounters & counters = threads[thread];
+
+    if(counters.fd[PC_CYCLES] == -1)
+        return false;
+
+#ifdef __linux__
+    // nr, then one value per member in order of opening
+    unsigned long long buffer[1 + NR_OF_COUNTERS];
+    ssize_t size = static_cast<ssize_t>((1 + counters.opened) * sizeof(unsigned long long));
+
+    if(::read(counters.fd[PC_CYCLES], buffer, size) != size)
+        return false;
+
+    for(int c = 0;c < NR_OF_COUNTERS;c++)
+        values[c] = counters.position[c] == -1 ? 0 : buffer[1 + counters.position[c]];
+
+    return true;
+#else
+    return false;
+#endif
+}
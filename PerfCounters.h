@@ -0,0 +1,65 @@
+/*
+ *  PerfCounters.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+// Includes
+#include <vector>
+#include "Utilities.h"
+
+using std::vector;
+
+enum COUNTER {
+    PC_CYCLES = 0,
+    PC_INSTRUCTIONS = 1,
+    PC_LLC_MISSES = 2,          // last level cache misses
+    PC_DTLB_MISSES = 3          // data TLB read misses
+};
+
+#define NR_OF_COUNTERS 4
+
+// Hardware counters of each thread through perf_event_open (Linux), read
+// around phases by PhaseTimer. Counters that cannot be opened, e.g. with
+// /proc/sys/kernel/perf_event_paranoid too high, in a VM, or on another
+// OS, are reported as unavailable and the run goes on without them.
+class PerfCounters {
+
+    private:
+
+        // Padded, so threads never write to the same cache line
+        struct ThreadCounters {
+            int fd[NR_OF_COUNTERS];         // -1 when not open, fd[PC_CYCLES] leads the group
+            int position[NR_OF_COUNTERS];   // in group read, -1 when not in group
+            int opened;
+            char padding[64];
+        };
+
+        vector<ThreadCounters> threads;
+        bool available[NR_OF_COUNTERS];
+        bool warned;
+
+    public:
+
+        bool enabled;
+
+        PerfCounters();
+
+        void init(int threads);
+
+        // Called by every thread of the team, counters count the calling thread only
+        void openThread();
+        void closeThread();
+
+        // Counter values of calling thread, false if it has none
+        bool read(unsigned long long values[NR_OF_COUNTERS]);
+
+        // Counted by at least one thread
+        bool isAvailable(COUNTER counter) { return available[counter]; }
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,507 @@
+/*
+ *  Profile.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Profile.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::setw;
+using std::ofstream;
+using std::stringstream;
+
+static const char * phaseNames[NR_OF_PHASES] = {"input", "stimulation", "filter", "threshold", "firing rate", "learning", "time step", "history save", "snapshot", "output"};
+
+const char * phaseName(PHASE phase) {
+    return phaseNames[phase];
+}
+
+static double now() {
+#ifdef OMP_ENABLE
+    return omp_get_wtime();
+#else
+    return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+static int threadNumber() {
+#ifdef OMP_ENABLE
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+// Rate per second, 0 when nothing was timed
+static double perSecond(double amount, double seconds) {
+    return seconds > 0 ? amount / seconds : 0;
+}
+
+// Share of the bytes a phase moves that came from memory, a cache line per
+// last level cache miss
+static const char * regime(double llcMisses, double bytes) {
+
+    if(bytes == 0)
+        return "-";
+
+    double share = llcMisses * 64 / bytes;
+
+    if(share < 0.1)
+        return "cache resident";
+    else if(share < 0.5)
+        return "partly cache resident";
+    else
+        return "memory bound";
+}
+
+Profile::Profile() : slots(0), threads(0), lastMark(0), epochStart(0), enabled(false), trace(NULL), counters(NULL) {}
+
+void Profile::init(u_short hiddenRegions, int threads) {
+
+    this->slots = hiddenRegions + 2;
+    this->threads = threads;
+
+    threadSeconds.assign(threads, vector<double>(NR_OF_PHASES * slots, 0));
+    threadCounts.assign(threads, vector<unsigned long long>(NR_OF_PHASES * slots * NR_OF_COUNTERS, 0));
+    synapsesPerCall.assign(NR_OF_PHASES * slots, 0);
+    bytesPerCall.assign(NR_OF_PHASES * slots, 0);
+
+    clear(epoch);
+    clear(run);
+    epochs.clear();
+    epochNumbers.clear();
+
+    lastMark = epochStart = now();
+}
+
+void Profile::clear(Totals & totals) {
+
+    totals.seconds.assign(NR_OF_PHASES * slots, 0);
+    totals.wallSeconds.assign(NR_OF_PHASES, 0);
+    totals.calls.assign(NR_OF_PHASES, 0);
+    totals.counts.assign(NR_OF_PHASES * slots * NR_OF_COUNTERS, 0);
+    totals.epochSeconds = 0;
+}
+
+void Profile::add(Totals & to, const Totals & from) {
+
+    for(unsigned i = 0;i < to.seconds.size();i++)
+        to.seconds[i] += from.seconds[i];
+
+    for(unsigned i = 0;i < to.counts.size();i++)
+        to.counts[i] += from.counts[i];
+
+    for(unsigned p = 0;p < NR_OF_PHASES;p++) {
+        to.wallSeconds[p] += from.wallSeconds[p];
+        to.calls[p] += from.calls[p];
+    }
+
+    to.epochSeconds += from.epochSeconds;
+}
+
+// Moves what threads added so far into totals
+void Profile::collect(Totals & totals) {
+
+    for(int t = 0;t < threads;t++) {
+
+        for(unsigned i = 0;i < threadSeconds[t].size();i++) {
+            totals.seconds[i] += threadSeconds[t][i];
+            threadSeconds[t][i] = 0;
+        }
+
+        for(unsigned i = 0;i < threadCounts[t].size();i++) {
+            totals.counts[i] += threadCounts[t][i];
+            threadCounts[t][i] = 0;
+        }
+    }
+}
+
+void Profile::setWork(PHASE phase, u_short slot, unsigned long long synapses, unsigned long long bytes) {
+
+    synapsesPerCall[phase * slots + slot] = synapses;
+    bytesPerCall[phase * slots + slot] = bytes;
+}
+
+void Profile::addTime(PHASE phase, u_short slot, double seconds) {
+
+    int thread = threadNumber();
+
+    if(thread < threads)
+        threadSeconds[thread][phase * slots + slot] += seconds;
+}
+
+void Profile::addCounts(PHASE phase, u_short slot, const unsigned long long start[NR_OF_COUNTERS], const unsigned long long end[NR_OF_COUNTERS]) {
+
+    int thread = threadNumber();
+
+    if(thread >= threads)
+        return;
+
+    unsigned long long * counts = &threadCounts[thread][(phase * slots + slot) * NR_OF_COUNTERS];
+
+    for(int c = 0;c < NR_OF_COUNTERS;c++)
+        counts[c] += end[c] - start[c];
+}
+
+void Profile::addWallTime(PHASE phase, double seconds) {
+
+    epoch.wallSeconds[phase] += seconds;
+    epoch.calls[phase]++;
+}
+
+void Profile::mark(PHASE phase) {
+
+    if(!enabled || threadNumber() != 0)
+        return;
+
+    double t = now();
+
+    epoch.wallSeconds[phase] += t - lastMark;
+    epoch.calls[phase]++;
+    lastMark = t;
+}
+
+void Profile::skip() {
+
+    if(enabled && threadNumber() == 0)
+        lastMark = now();
+}
+
+void Profile::startEpoch() {
+
+    if(enabled)
+        lastMark = epochStart = now();
+}
+
+void Profile::endEpoch(u_short epochNumber) {
+
+    if(!enabled)
+        return;
+
+    collect(epoch);
+
+    epoch.epochSeconds = now() - epochStart;
+
+    epochs.push_back(epoch);
+    epochNumbers.push_back(epochNumber);
+    add(run, epoch);
+    clear(epoch);
+}
+
+string Profile::slotName(u_short slot) {
+
+    if(slot == 0)
+        return "input";
+    else if(slot == networkSlot())
+        return "network";
+
+    stringstream ss;
+    ss << "region " << slot;
+    return ss.str();
+}
+
+void Profile::writeJSON(std::ostream & file, const Totals & totals, const string & indent) {
+
+    file << indent << "\"seconds\": " << totals.epochSeconds << "," << endl;
+    file << indent << "\"phases\": [";
+
+    bool firstPhase = true;
+
+    for(unsigned p = 0;p < NR_OF_PHASES;p++) {
+
+        if(totals.calls[p] == 0)
+            continue;
+
+        double synapses = 0, bytes = 0;
+
+        for(u_short s = 0;s < slots;s++) {
+            synapses += static_cast<double>(synapsesPerCall[p * slots + s]) * totals.calls[p];
+            bytes += static_cast<double>(bytesPerCall[p * slots + s]) * totals.calls[p];
+        }
+
+        file << (firstPhase ? "" : ",") << endl;
+        file << indent << "  { \"phase\": \"" << phaseNames[p] << "\", \"calls\": " << totals.calls[p]
+             << ", \"wallSeconds\": " << totals.wallSeconds[p]
+             << ", \"synapseUpdates\": " << synapses << ", \"bytes\": " << bytes
+             << ", \"synapseUpdatesPerSecond\": " << perSecond(synapses, totals.wallSeconds[p])
+             << ", \"GBPerSecond\": " << perSecond(bytes, totals.wallSeconds[p]) / 1e9 << "," << endl;
+        file << indent << "    \"regions\": [";
+
+        bool firstRegion = true;
+
+        for(u_short s = 0;s < slots;s++) {
+
+            double seconds = totals.seconds[p * slots + s];
+            double regionSynapses = static_cast<double>(synapsesPerCall[p * slots + s]) * totals.calls[p];
+            double regionBytes = static_cast<double>(bytesPerCall[p * slots + s]) * totals.calls[p];
+
+            if(seconds == 0 && regionBytes == 0)
+                continue;
+
+            file << (firstRegion ? "" : ",") << endl;
+            file << indent << "      { \"region\": \"" << slotName(s) << "\", \"seconds\": " << seconds
+                 << ", \"synapseUpdates\": " << regionSynapses << ", \"bytes\": " << regionBytes
+                 << ", \"synapseUpdatesPerSecond\": " << perSecond(regionSynapses, seconds)
+                 << ", \"GBPerSecond\": " << perSecond(regionBytes, seconds) / 1e9;
+
+            if(counters != NULL)
+                writeCounters(file, totals, p * slots + s, regionSynapses, true);
+
+            file << " }";
+
+            firstRegion = false;
+        }
+
+        file << " ] }";
+        firstPhase = false;
+    }
+
+    file << " ]";
+}
+
+void Profile::writeCSV(std::ostream & file, const Totals & totals, const string & epochName) {
+
+    for(unsigned p = 0;p < NR_OF_PHASES;p++) {
+
+        if(totals.calls[p] == 0)
+            continue;
+
+        double synapses = 0, bytes = 0;
+
+        for(u_short s = 0;s < slots;s++) {
+
+            double seconds = totals.seconds[p * slots + s];
+            double regionSynapses = static_cast<double>(synapsesPerCall[p * slots + s]) * totals.calls[p];
+            double regionBytes = static_cast<double>(bytesPerCall[p * slots + s]) * totals.calls[p];
+
+            synapses += regionSynapses;
+            bytes += regionBytes;
+
+            if(seconds == 0 && regionBytes == 0)
+                continue;
+
+            file << epochName << "," << phaseNames[p] << "," << slotName(s) << "," << totals.calls[p] << "," << seconds << ","
+                 << regionSynapses << "," << regionBytes << "," << perSecond(regionSynapses, seconds) << "," << perSecond(regionBytes, seconds) / 1e9;
+
+            if(counters != NULL)
+                writeCounters(file, totals, p * slots + s, regionSynapses, false);
+
+            file << endl;
+        }
+
+        file << epochName << "," << phaseNames[p] << ",all," << totals.calls[p] << "," << totals.wallSeconds[p] << ","
+             << synapses << "," << bytes << "," << perSecond(synapses, totals.wallSeconds[p]) << "," << perSecond(bytes, totals.wallSeconds[p]) / 1e9;
+
+        // Counts are only per region
+        if(counters != NULL)
+            file << ",,,,,,,";
+
+        file << endl;
+    }
+}
+
+void Profile::write(const char * outputDirectory) {
+
+    if(!enabled)
+        return;
+
+    // Whatever came after the last epoch, i.e. output
+    collect(epoch);
+
+    add(run, epoch);
+    clear(epoch);
+
+    string base(outputDirectory);
+    ofstream json((base + "Profile.json").c_str());
+    ofstream csv((base + "Profile.csv").c_str());
+
+    if(!json || !csv) {
+
+        cerr << "Unable to open profile in " << outputDirectory << ": " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    // Counts are large
+    json.precision(12);
+    csv.precision(12);
+
+    // Busy seconds are summed over threads, rates of a region are per busy
+    // second, rates of a whole phase per wall second
+    json << "{" << endl;
+    json << "  \"threads\": " << threads << "," << endl;
+    json << "  \"epochs\": [";
+
+    for(unsigned e = 0;e < epochs.size();e++) {
+
+        json << (e == 0 ? "" : ",") << endl;
+        json << "    {" << endl;
+        json << "      \"epoch\": " << epochNumbers[e] << "," << endl;
+        writeJSON(json, epochs[e], "      ");
+        json << endl << "    }";
+    }
+
+    json << " ]," << endl;
+    json << "  \"run\": {" << endl;
+    writeJSON(json, run, "    ");
+    json << endl << "  }" << endl;
+    json << "}" << endl;
+
+    csv << "epoch,phase,region,calls,seconds,synapseUpdates,bytes,synapseUpdatesPerSecond,GBPerSecond";
+
+    if(counters != NULL)
+        csv << ",cycles,instructions,IPC,LLCMisses,dTLBMisses,LLCMissesPerSynapse,dTLBMissesPerSynapse";
+
+    csv << endl;
+
+    for(unsigned e = 0;e < epochs.size();e++) {
+
+        stringstream ss;
+        ss << epochNumbers[e];
+        writeCSV(csv, epochs[e], ss.str());
+    }
+
+    writeCSV(csv, run, "run");
+
+    if(counters != NULL)
+        reportCounters();
+}
+
+// Appends counts of one phase and slot to a region entry, as JSON fields or
+// CSV columns, counters the cpu lacks are null or empty, and misses per
+// synapse only exist for phases that go through synapses
+void Profile::writeCounters(std::ostream & file, const Totals & totals, unsigned index, double synapses, bool isJSON) {
+
+    static const char * names[7] = {"cycles", "instructions", "IPC", "LLCMisses", "dTLBMisses", "LLCMissesPerSynapse", "dTLBMissesPerSynapse"};
+
+    const double * counts = &totals.counts[index * NR_OF_COUNTERS];
+
+    bool present[7] = {counters->isAvailable(PC_CYCLES), counters->isAvailable(PC_INSTRUCTIONS),
+                       counters->isAvailable(PC_CYCLES) && counters->isAvailable(PC_INSTRUCTIONS) && counts[PC_CYCLES] > 0,
+                       counters->isAvailable(PC_LLC_MISSES), counters->isAvailable(PC_DTLB_MISSES),
+                       counters->isAvailable(PC_LLC_MISSES) && synapses > 0, counters->isAvailable(PC_DTLB_MISSES) && synapses > 0};
+
+    double values[7] = {counts[PC_CYCLES], counts[PC_INSTRUCTIONS],
+                        present[2] ? counts[PC_INSTRUCTIONS] / counts[PC_CYCLES] : 0,
+                        counts[PC_LLC_MISSES], counts[PC_DTLB_MISSES],
+                        present[5] ? counts[PC_LLC_MISSES] / synapses : 0,
+                        present[6] ? counts[PC_DTLB_MISSES] / synapses : 0};
+
+    for(int i = 0;i < 7;i++) {
+
+        if(isJSON) {
+
+            file << ", \"" << names[i] << "\": ";
+
+            if(present[i])
+                file << values[i];
+            else
+                file << "null";
+        }
+        else {
+
+            file << ",";
+
+            if(present[i])
+                file << values[i];
+        }
+    }
+}
+
+// Whole run, per region and phase that was counted
+void Profile::reportCounters() {
+
+    if(!counters->isAvailable(PC_CYCLES))
+        return;
+
+    std::streamsize precision = cout.precision();
+
+    cout << "Hardware counters:" << endl;
+    cout << std::left << setw(12) << "region" << setw(14) << "phase" << std::right << setw(8) << "IPC"
+         << setw(16) << "LLC miss/syn" << setw(16) << "dTLB miss/syn" << "  regime" << endl;
+
+    for(u_short s = 0;s < slots;s++)
+        for(unsigned p = 0;p < NR_OF_PHASES;p++) {
+
+            unsigned index = p * slots + s;
+            const double * counts = &run.counts[index * NR_OF_COUNTERS];
+
+            if(counts[PC_CYCLES] == 0)
+                continue;
+
+            double synapses = static_cast<double>(synapsesPerCall[index]) * run.calls[p];
+            double bytes = static_cast<double>(bytesPerCall[index]) * run.calls[p];
+
+            cout << std::left << setw(12) << slotName(s) << setw(14) << phaseNames[p] << std::right << std::fixed;
+            cout.precision(2);
+            cout << setw(8) << counts[PC_INSTRUCTIONS] / counts[PC_CYCLES];
+            cout.precision(4);
+
+            if(counters->isAvailable(PC_LLC_MISSES) && synapses > 0)
+                cout << setw(16) << counts[PC_LLC_MISSES] / synapses;
+            else
+                cout << setw(16) << "-";
+
+            if(counters->isAvailable(PC_DTLB_MISSES) && synapses > 0)
+                cout << setw(16) << counts[PC_DTLB_MISSES] / synapses;
+            else
+                cout << setw(16) << "-";
+
+            cout << "  " << (counters->isAvailable(PC_LLC_MISSES) ? regime(counts[PC_LLC_MISSES], bytes) : "-") << endl;
+            cout.unsetf(std::ios::fixed);
+        }
+
+    cout.precision(precision);
+}
+
+PhaseTimer::PhaseTimer(Profile & profile, PHASE phase, u_short slot, bool isWallTime) :
+profile(profile),
+phase(phase),
+slot(slot),
+isWallTime(isWallTime),
+start(profile.enabled || profile.trace != NULL ? now() : 0),
+counting(profile.enabled && profile.counters != NULL && profile.counters->read(startCounts)) {}
+
+PhaseTimer::~PhaseTimer() {
+
+    if(!profile.enabled && profile.trace == NULL)
+        return;
+
+    if(counting) {
+
+        unsigned long long endCounts[NR_OF_COUNTERS];
+
+        if(profile.counters->read(endCounts))
+            profile.addCounts(phase, slot, startCounts, endCounts);
+    }
+
+    double end = now();
+
+    if(profile.enabled) {
+
+        profile.addTime(phase, slot, end - start);
+
+        if(isWallTime)
+            profile.addWallTime(phase, end - start);
+    }
+
+    // Wall time spans are rare and outside time steps, so never sampled out
+    if(profile.trace != NULL)
+        profile.trace->addSpan(phaseNames[phase], slot, start, end, isWallTime);
+}
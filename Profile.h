@@ -0,0 +1,146 @@
+/*
+ *  Profile.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Includes
+#include <vector>
+#include <string>
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "Utilities.h"
+
+using std::vector;
+using std::string;
+
+enum PHASE {
+    PH_INPUT = 0,           // input firing rates, includes the barrier of InputRegion::setFiringRate()
+    PH_STIMULATION = 1,     // weighted sums, GLOBAL also computes firing rate here
+    PH_FILTER = 2,          // lateral interaction
+    PH_THRESHOLD = 3,       // sparseness percentile
+    PH_FIRING_RATE = 4,     // contrast enhancement
+    PH_LEARNING = 5,        // weight, trace and normalization update
+    PH_TIME_STEP = 6,       // time step without saving history
+    PH_HISTORY_SAVE = 7,    // time step that saves history
+    PH_SNAPSHOT = 8,        // checkpoints, network files saved during training and weight convergence
+    PH_OUTPUT = 9           // history files at end of run
+};
+
+#define NR_OF_PHASES 10
+
+const char * phaseName(PHASE phase);
+
+// Accumulates time per phase and region of a run, see Network::runContinous().
+// Every thread adds its own busy time on the part of a region it was given,
+// and thread 0 marks the end of each phase, which gives the wall time of the
+// phase for the whole team, barrier waits included. Work of a phase is an
+// estimate of the synapses processed and bytes read and written per call,
+// set once by Network::setupProfile(), times the number of calls. With
+// hardware counters, each thread also adds the counts of its own busy time.
+//
+// Slots: 0 = input, k = hidden region k, last = whole network (snapshot, output)
+class Profile {
+
+    private:
+
+        struct Totals {
+            vector<double> seconds;                     // [phase * slots + slot], busy, summed over threads
+            vector<double> wallSeconds;                 // [phase]
+            vector<unsigned long long> calls;           // [phase]
+            vector<double> counts;                      // [(phase * slots + slot) * NR_OF_COUNTERS + counter]
+            double epochSeconds;
+        };
+
+        u_short slots;
+        int threads;
+        vector<vector<double> > threadSeconds;          // [thread][phase * slots + slot], current epoch
+        vector<vector<unsigned long long> > threadCounts; // [thread][(phase * slots + slot) * NR_OF_COUNTERS + counter]
+        Totals epoch;
+        Totals run;
+        vector<Totals> epochs;
+        vector<u_short> epochNumbers;
+        double lastMark;
+        double epochStart;
+
+        vector<unsigned long long> synapsesPerCall;     // [phase * slots + slot]
+        vector<unsigned long long> bytesPerCall;
+
+        void clear(Totals & totals);
+        void add(Totals & to, const Totals & from);
+        void collect(Totals & totals);
+        string slotName(u_short slot);
+
+        void writeJSON(std::ostream & file, const Totals & totals, const string & indent);
+        void writeCSV(std::ostream & file, const Totals & totals, const string & epoch);
+        void writeCounters(std::ostream & file, const Totals & totals, unsigned index, double synapses, bool isJSON);
+        void reportCounters();
+
+    public:
+
+        bool enabled;
+    
+        // Timers also add spans to this trace when set
+        Trace * trace;
+    
+        // Timers also add hardware counts when set, only with enabled
+        PerfCounters * counters;
+
+        Profile();
+
+        // Resets all results
+        void init(u_short hiddenRegions, int threads);
+        u_short networkSlot() { return slots - 1; }
+
+        void setWork(PHASE phase, u_short slot, unsigned long long synapses, unsigned long long bytes);
+
+        // Busy time of calling thread
+        void addTime(PHASE phase, u_short slot, double seconds);
+    
+        // Counts of calling thread between start and end
+        void addCounts(PHASE phase, u_short slot, const unsigned long long start[NR_OF_COUNTERS], const unsigned long long end[NR_OF_COUNTERS]);
+    
+        // Wall time of one call made by a single thread while the team waits
+        void addWallTime(PHASE phase, double seconds);
+
+        // Only thread 0 does anything: time since last mark is wall time of phase,
+        // and counts as one call, skip() leaves it out, e.g. between objects
+        // or after addWallTime()
+        void mark(PHASE phase);
+        void skip();
+
+        // Thread 0, or outside parallel region
+        void startEpoch();
+        void endEpoch(u_short epoch);
+
+        // Profile.json and Profile.csv, with counters also a summary per
+        // region on the console
+        void write(const char * outputDirectory);
+};
+
+// Adds busy time of the enclosing block, and also its wall time when
+// isWallTime, and its hardware counts when the profile has counters,
+// nothing happens unless profile is enabled or has a trace
+class PhaseTimer {
+
+    private:
+
+        Profile & profile;
+        PHASE phase;
+        u_short slot;
+        bool isWallTime;
+        double start;
+        bool counting;
+        unsigned long long startCounts[NR_OF_COUNTERS];
+
+    public:
+
+        PhaseTimer(Profile & profile, PHASE phase, u_short slot, bool isWallTime = false);
+        ~PhaseTimer();
+};
+
+#endif // PROFILE_H
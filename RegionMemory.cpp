@@ -0,0 +1,209 @@
+/*
+ *  RegionMemory.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "RegionMemory.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+
+#ifdef __linux__
+    #include <sched.h>
+    #include <sys/mman.h>
+#endif
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::pair;
+
+// Read by every first-touch thread, falls back from explicit to transparent once
+static std::atomic<HUGEPAGES> hugePages(HP_NONE);
+static size_t hugePageSize = 2 * 1024 * 1024;
+
+static THREADBINDING threadBinding = TB_NONE;
+static vector<int> cpus; // allowed cpus, ordered by socket
+
+// Cpu the calling thread was bound to, threads of a pool are reused by every parallel region
+static thread_local int boundCpu = -1;
+
+void setHugePages(HUGEPAGES hugePages) {
+
+#ifdef __linux__
+    // Default size of explicit huge pages
+    std::ifstream meminfo("/proc/meminfo");
+    string line;
+
+    while(std::getline(meminfo, line))
+        if(line.compare(0, 13, "Hugepagesize:") == 0) {
+
+            std::istringstream ss(line.substr(13));
+            size_t kB;
+
+            if(ss >> kB && kB > 0)
+                hugePageSize = kB * 1024;
+        }
+
+    ::hugePages = hugePages;
+#else
+    if(hugePages != HP_NONE)
+        cout << "Huge pages are only supported on Linux, using regular pages." << endl;
+#endif
+}
+
+void setThreadBinding(THREADBINDING threadBinding) {
+
+#ifdef __linux__
+    if(threadBinding == TB_NONE)
+        return;
+
+    // Cpus we may run on, taken before any thread is pinned
+    cpu_set_t allowed;
+
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+
+        cerr << "Unable to get cpu affinity: " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    vector<pair<int, int> > socketAndCpu;
+
+    for(int c = 0;c < CPU_SETSIZE;c++)
+        if(CPU_ISSET(c, &allowed)) {
+
+            std::stringstream ss;
+            ss << "/sys/devices/system/cpu/cpu" << c << "/topology/physical_package_id";
+
+            std::ifstream file(ss.str().c_str());
+            int socket = 0;
+            file >> socket;
+
+            socketAndCpu.push_back(pair<int, int>(socket, c));
+        }
+
+    std::sort(socketAndCpu.begin(), socketAndCpu.end());
+
+    cpus.clear();
+    for(unsigned c = 0;c < socketAndCpu.size();c++)
+        cpus.push_back(socketAndCpu[c].second);
+
+    ::threadBinding = threadBinding;
+#else
+    if(threadBinding != TB_NONE)
+        cout << "Thread binding is only supported on Linux, ignored." << endl;
+#endif
+}
+
+void bindThread() {
+
+#ifdef __linux__
+    if(threadBinding == TB_NONE || cpus.empty())
+        return;
+
+    size_t thread = 0, threads = 1;
+
+#ifdef OMP_ENABLE
+    for(int level = 1;level <= omp_get_level();level++) {
+        thread = thread * omp_get_team_size(level) + omp_get_ancestor_thread_num(level);
+        threads *= omp_get_team_size(level);
+    }
+#endif
+
+    size_t n = cpus.size();
+    size_t slot = (threadBinding == TB_CLOSE) ? thread % n : (thread * n / threads) % n;
+
+    if(boundCpu == cpus[slot])
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[slot], &set);
+
+    // 0 = calling thread
+    if(sched_setaffinity(0, sizeof(set), &set) == 0)
+        boundCpu = cpus[slot];
+#endif
+}
+
+#ifdef __linux__
+static size_t roundUp(size_t bytes, size_t multiple) {
+    return ((bytes + multiple - 1) / multiple) * multiple;
+}
+#endif
+
+void * allocateRegionMemory(size_t bytes) {
+
+#ifdef __linux__
+    // Small blocks do not cover a huge page anyway
+    if(hugePages != HP_NONE && bytes >= hugePageSize) {
+
+        size_t size = roundUp(bytes, hugePageSize);
+
+        if(hugePages == HP_EXPLICIT) {
+
+            void * p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+            if(p != MAP_FAILED)
+                return p;
+
+            // Only the thread that makes the change reports it
+            HUGEPAGES expected = HP_EXPLICIT;
+
+            if(hugePages.compare_exchange_strong(expected, HP_TRANSPARENT)) {
+#pragma omp critical(regionMemory)
+                cout << "No explicit huge pages for " << size << " bytes (see /proc/sys/vm/nr_hugepages), using transparent huge pages." << endl;
+            }
+        }
+
+        // Transparent: aligned mapping, so every huge page of it can be backed
+        size_t mapped = size + hugePageSize;
+        char * p = static_cast<char *>(mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+        if(p == MAP_FAILED)
+            throw std::bad_alloc();
+
+        char * aligned = reinterpret_cast<char *>(roundUp(reinterpret_cast<size_t>(p), hugePageSize));
+
+        if(aligned != p)
+            munmap(p, aligned - p);
+
+        if(aligned + size != p + mapped)
+            munmap(aligned + size, (p + mapped) - (aligned + size));
+
+        madvise(aligned, size, MADV_HUGEPAGE);
+
+        return aligned;
+    }
+#endif
+
+    return ::operator new(bytes);
+}
+
+void freeRegionMemory(void * p, size_t bytes) {
+
+#ifdef __linux__
+    // Same test as allocation, hugePages only ever changes from explicit to transparent
+    if(hugePages != HP_NONE && bytes >= hugePageSize) {
+        munmap(p, roundUp(bytes, hugePageSize));
+        return;
+    }
+#endif
+
+    ::operator delete(p);
+}
@@ -0,0 +1,75 @@
+/*
+ *  RegionMemory.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef REGIONMEMORY_H
+#define REGIONMEMORY_H
+
+// Includes
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "Utilities.h"
+
+using std::vector;
+
+enum HUGEPAGES {
+    HP_NONE = 0,            // regular pages
+    HP_TRANSPARENT = 1,     // 2 MB aligned and madvise(MADV_HUGEPAGE)
+    HP_EXPLICIT = 2         // MAP_HUGETLB from the reserved pool, transparent if the pool is empty
+};
+
+enum THREADBINDING {
+    TB_NONE = 0,            // leave placement to the OS/OpenMP runtime
+    TB_CLOSE = 1,           // thread t on allowed cpu t, fills one socket first
+    TB_SPREAD = 2           // threads evenly over allowed cpus, i.e. over sockets
+};
+
+// Both must be set before any region is built, i.e. from main()
+void setHugePages(HUGEPAGES hugePages);
+void setThreadBinding(THREADBINDING threadBinding);
+
+// Pins calling thread according to thread binding, call first thing in
+// every parallel region that touches region memory. The position is taken
+// over all nested teams, so runs of a sweep get separate cpus.
+void bindThread();
+
+// Large blocks come from huge pages when enabled, nothing is touched
+void * allocateRegionMemory(size_t bytes);
+void freeRegionMemory(void * p, size_t bytes);
+
+// Allocator for region buffers. Elements are default initialized, which
+// for float means not written, so pages stay untouched until the thread
+// that owns that part of the region writes them (Linux first touch places
+// the page on the NUMA node of that thread).
+template <class T>
+class RegionAllocator {
+
+    public:
+
+        typedef T value_type;
+
+        RegionAllocator() {}
+        template <class U> RegionAllocator(const RegionAllocator<U> &) {}
+
+        T * allocate(size_t n) { return static_cast<T *>(allocateRegionMemory(n * sizeof(T))); }
+        void deallocate(T * p, size_t n) { freeRegionMemory(p, n * sizeof(T)); }
+
+        template <class U> void construct(U * p) { ::new(static_cast<void *>(p)) U; }
+        template <class U, class... Args> void construct(U * p, Args&&... args) { ::new(static_cast<void *>(p)) U(std::forward<Args>(args)...); }
+};
+
+template <class T, class U>
+bool operator==(const RegionAllocator<T> &, const RegionAllocator<U> &) { return true; }
+
+template <class T, class U>
+bool operator!=(const RegionAllocator<T> &, const RegionAllocator<U> &) { return false; }
+
+typedef vector<float, RegionAllocator<float> > RegionBuffer;
+typedef vector<bfloat16, RegionAllocator<bfloat16> > HalfRegionBuffer;
+
+#endif // REGIONMEMORY_H
@@ -0,0 +1,400 @@
+/*
+ *  Server.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Server.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::stringstream;
+
+// Set by SIGINT/SIGTERM, seen by the accept loop within a poll interval
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+// Seconds a client has to send its request line
+static const double requestTimeout = 10;
+
+static double now() {
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Names of recorded data, index is DATA, as the history file names
+static const char * dataNames[] = {"firingRate", "activation", "inhibitedActivation", "trace", "stimulation", "effectiveTrace"};
+
+static bool parseRecordedData(const string & list, unsigned & recordedData) {
+
+    stringstream names(list);
+    string name;
+    recordedData = 0;
+
+    while(getline(names, name, ',')) {
+
+        unsigned d = 0;
+
+        while(d < sizeof(dataNames)/sizeof(dataNames[0]) && name != dataNames[d])
+            d++;
+
+        if(d == sizeof(dataNames)/sizeof(dataNames[0]))
+            return false;
+
+        recordedData |= 1 << d;
+    }
+
+    return recordedData != 0;
+}
+
+static void reply(int fd, const string & line) {
+
+    string text = line + "\n";
+
+    // A client that left is no concern of the server (SIGPIPE is ignored)
+    if(write(fd, text.c_str(), text.size()) == -1)
+        return;
+}
+
+struct Connection {
+    Server * server;
+    int fd;
+};
+
+Server::Server(Network & trained, const char * socketPath, int numberOfThreads, int jobs, const RunOptions & options) :
+trained(trained),
+socketPath(socketPath),
+jobs(jobs),
+options(options),
+listener(-1),
+runningJobs(0),
+connections(0),
+stopping(false) {
+
+    // 75% of a single core rounds down to nothing
+    if(numberOfThreads < 1)
+        numberOfThreads = 1;
+
+    // As in a sweep, by default jobs are spread over threads
+    if(this->jobs < 1)
+        this->jobs = numberOfThreads;
+
+    this->jobThreads = numberOfThreads / this->jobs;
+
+    if(this->jobThreads < 1)
+        this->jobThreads = 1;
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&changed, NULL);
+}
+
+Server::~Server() {
+
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&changed);
+}
+
+void Server::run() {
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if(socketPath.size() >= sizeof(address.sun_path)) {
+
+        cerr << "Socket path is too long: " << socketPath << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    strcpy(address.sun_path, socketPath.c_str());
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(listener == -1) {
+
+        cerr << "Unable to create socket: " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    // A socket file left by a server that is gone is replaced, one of a live server is not
+    struct stat s;
+
+    if(stat(socketPath.c_str(), &s) == 0 && S_ISSOCK(s.st_mode)) {
+
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe != -1 && connect(probe, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == 0;
+
+        if(probe != -1)
+            close(probe);
+
+        if(live) {
+
+            cerr << "Another server is listening on " << socketPath << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+
+        unlink(socketPath.c_str());
+    }
+
+    if(bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) == -1 || listen(listener, 16) == -1) {
+
+        cerr << "Unable to listen on " << socketPath << ": " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    // Once, all jobs read these
+    trained.freezeWeights();
+
+    signal(SIGPIPE, SIG_IGN);
+    stopRequested = 0;
+    signal(SIGTERM, requestStop);
+    signal(SIGINT, requestStop);
+
+    cout << "Serving on " << socketPath << ", " << jobs << " job(s) at a time with " << jobThreads << " thread(s) each." << endl;
+
+    while(true) {
+
+        pthread_mutex_lock(&mutex);
+        bool stop = stopping || stopRequested;
+        pthread_mutex_unlock(&mutex);
+
+        if(stop)
+            break;
+
+        // Wakes up now and then to see if the server was stopped
+        struct pollfd incoming;
+        incoming.fd = listener;
+        incoming.events = POLLIN;
+        incoming.revents = 0;
+
+        if(poll(&incoming, 1, 250) <= 0)
+            continue;
+
+        int fd = accept(listener, NULL, NULL);
+
+        if(fd == -1)
+            continue;
+
+        Connection * connection = new Connection;
+        connection->server = this;
+        connection->fd = fd;
+
+        pthread_mutex_lock(&mutex);
+        connections++;
+        pthread_mutex_unlock(&mutex);
+
+        pthread_t thread;
+
+        if(pthread_create(&thread, NULL, serve, connection) != 0) {
+
+            reply(fd, string("error unable to start job: ") + strerror(errno));
+            close(fd);
+            delete connection;
+
+            pthread_mutex_lock(&mutex);
+            connections--;
+            pthread_mutex_unlock(&mutex);
+
+            continue;
+        }
+
+        pthread_detach(thread);
+    }
+
+    close(listener);
+    listener = -1;
+    unlink(socketPath.c_str());
+
+    cout << "Server stopped, waiting for running jobs..." << endl;
+
+    pthread_mutex_lock(&mutex);
+
+    while(connections > 0)
+        pthread_cond_wait(&changed, &mutex);
+
+    pthread_mutex_unlock(&mutex);
+
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+}
+
+void * Server::serve(void * connection) {
+
+    Connection c = *static_cast<Connection *>(connection);
+    delete static_cast<Connection *>(connection);
+
+    c.server->handle(c.fd);
+    close(c.fd);
+
+    pthread_mutex_lock(&c.server->mutex);
+    c.server->connections--;
+    pthread_cond_broadcast(&c.server->changed);
+    pthread_mutex_unlock(&c.server->mutex);
+
+    return NULL;
+}
+
+void Server::handle(int fd) {
+
+    // One request line, within requestTimeout seconds and while the server runs
+    string request;
+    char c = 0;
+    double deadline = now() + requestTimeout;
+
+    while(request.size() < 4096 && c != '\n') {
+
+        pthread_mutex_lock(&mutex);
+        bool stop = stopping || stopRequested;
+        pthread_mutex_unlock(&mutex);
+
+        if(stop || now() > deadline) {
+
+            reply(fd, "error timeout");
+            return;
+        }
+
+        struct pollfd incoming;
+        incoming.fd = fd;
+        incoming.events = POLLIN;
+        incoming.revents = 0;
+
+        if(poll(&incoming, 1, 250) <= 0)
+            continue;
+
+        if(read(fd, &c, 1) != 1)
+            break;
+
+        if(c != '\n')
+            request += c;
+    }
+
+    stringstream fields(request);
+    string command, dataFile, outputDirectory, recorded;
+    unsigned recordedData = ALL_RECORDED_DATA;
+
+    fields >> command;
+
+    if(command == "shutdown") {
+
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_mutex_unlock(&mutex);
+
+        reply(fd, "ok");
+        return;
+    }
+
+    if(command != "test" || !(fields >> dataFile >> outputDirectory)) {
+
+        reply(fd, "error expected: test <data file> <output directory> [<recorded data>], or shutdown");
+        return;
+    }
+
+    if(fields >> recorded && !parseRecordedData(recorded, recordedData)) {
+
+        reply(fd, "error unknown recorded data: " + recorded);
+        return;
+    }
+
+    // Data file smi test would end the process on
+    string problem;
+
+    if(!trained.area7a.checkDataFile(dataFile.c_str(), problem)) {
+
+        reply(fd, "error " + problem);
+        return;
+    }
+
+    struct stat s;
+
+    if(stat(outputDirectory.c_str(), &s) != 0 || !S_ISDIR(s.st_mode)) {
+
+        reply(fd, "error no output directory: " + outputDirectory);
+        return;
+    }
+
+    if(access(outputDirectory.c_str(), W_OK) != 0) {
+
+        reply(fd, "error output directory is not writable: " + outputDirectory);
+        return;
+    }
+
+    // History file names are appended to it
+    if(outputDirectory[outputDirectory.size() - 1] != '/')
+        outputDirectory += '/';
+
+    pthread_mutex_lock(&mutex);
+
+    while(runningJobs >= jobs)
+        pthread_cond_wait(&changed, &mutex);
+
+    runningJobs++;
+    pthread_mutex_unlock(&mutex);
+
+    double start = now();
+    bool written = true;
+
+    {
+#ifdef OMP_ENABLE
+        // Team size of regions built below and of the parallel region in runContinous()
+        omp_set_num_threads(jobThreads);
+#endif
+
+        Network job(dataFile.c_str(), trained);
+        job.options = options;
+        job.options.recordedData = recordedData;
+        job.options.throwOutputErrors = true;
+
+        try {
+            job.runContinous(outputDirectory.c_str(), false, false);
+        } catch (std::runtime_error & e) {
+            problem = e.what();
+            written = false;
+        }
+    }
+
+    double seconds = now() - start;
+
+    pthread_mutex_lock(&mutex);
+    runningJobs--;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&mutex);
+
+    if(!written) {
+
+        reply(fd, "error unable to write output to " + outputDirectory + ": " + problem);
+        return;
+    }
+
+    stringstream ok;
+    ok << "ok " << seconds;
+    reply(fd, ok.str());
+}
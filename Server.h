@@ -0,0 +1,65 @@
+/*
+ *  Server.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+// Includes
+#include <string>
+#include <pthread.h>
+#include "Network.h"
+#include "Utilities.h"
+
+using std::string;
+
+// Tests a network that is loaded once on data files sent over a Unix domain
+// socket. A client sends one request line per connection, fields are
+// separated by white space:
+//
+//   test <data file> <output directory> [<recorded data>]
+//   shutdown
+//
+// Recorded data is a comma separated subset of firingRate, activation,
+// inhibitedActivation, trace, stimulation and effectiveTrace, all by
+// default. The reply is one line, "ok <seconds>" once the output is written,
+// or "error <reason>", "error timeout" when the request line does not arrive
+// within 10 seconds or before the server stops. Jobs run concurrently, each on its own input and neuron
+// state over the frozen weights of the loaded network. Data files are checked
+// against the loaded network before a job is built, and output that cannot be
+// written is reported, neither ends the server.
+class Server {
+
+    private:
+
+        Network & trained;
+        string socketPath;
+        int jobs;
+        int jobThreads;
+        RunOptions options;
+        int listener;
+
+        // Jobs running and connections open, under mutex
+        pthread_mutex_t mutex;
+        pthread_cond_t changed;
+        int runningJobs;
+        int connections;
+        bool stopping;
+
+        static void * serve(void * connection);
+        void handle(int fd);
+
+    public:
+
+        // Jobs share numberOfThreads, at most jobs at a time
+        Server(Network & trained, const char * socketPath, int numberOfThreads, int jobs, const RunOptions & options);
+        ~Server();
+
+        // Until shutdown request, SIGINT or SIGTERM, returns once running jobs are done
+        void run();
+};
+
+#endif // SERVER_H
@@ -0,0 +1,347 @@
+/*
+ *  Sweep.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Sweep.h"
+#include "Network.h"
+#include "Ensemble.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <libconfig.h++>
+#include "Utilities.h"
+
+#ifdef OS_WIN
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using namespace libconfig;
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::stringstream;
+
+// Output directory of run r, created if needed
+static string makeRunDirectory(const char * outputDirectory, int r) {
+    
+    stringstream ss;
+    ss << outputDirectory << "run" << r+1 << "/";
+    string dir = ss.str();
+    
+#ifdef OS_WIN
+    int failed = _mkdir(dir.c_str());
+#else
+    int failed = mkdir(dir.c_str(), 0755);
+#endif
+    
+    if(failed != 0 && errno != EEXIST) {
+        
+        cerr << "Unable to create output directory: " << dir << ", error = " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    
+    return dir;
+}
+
+static bool fileExists(const string & file) {
+    
+    std::ifstream f(file.c_str());
+    return f.good();
+}
+
+Sweep::Sweep(const char * parameterFile, const char * sweepFile, const char * inputWeightFile, const char * dataFile, bool verbose) :
+parameterFile(parameterFile),
+sweepFile(sweepFile) {
+
+    Config cfg;
+
+    try {
+
+        cfg.readFile(sweepFile);
+
+        threadsPerRun = 0;
+        cfg.lookupValue("threadsPerRun", threadsPerRun);
+        
+        ensemble = false;
+        cfg.lookupValue("ensemble", ensemble);
+
+        Setting & list = cfg.lookup("runs");
+
+        if(list.getLength() == 0) {
+
+            cerr << "No runs in sweep file: " << sweepFile << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+
+        // Only the first run reads the data file
+        for(int r = 0;r < list.getLength();r++) {
+
+            cout << "Loading network for run #" << r+1 << "..." << endl;
+
+            if(r == 0)
+                runs.push_back(new Network(dataFile, parameterFile, verbose, inputWeightFile, true, &list[r]));
+            else
+                runs.push_back(new Network(runs.front()->area7a, parameterFile, verbose, inputWeightFile, true, &list[r]));
+        }
+    }
+    catch(const FileIOException &fioex) {
+        cerr << "I/O error while reading sweep file: " << sweepFile << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    catch(const ParseException &pex) {
+        cerr << "Parse error at " << pex.getFile() << ":" << pex.getLine()
+        << " - " << pex.getError() << "." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    catch(const SettingNotFoundException &nfex) {
+        cerr << "Setting not found in sweep file." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+    catch(const SettingTypeException & stex) {
+        cerr << "Setting had incompatible type in sweep file." << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    shareInputFrames();
+}
+
+Sweep::~Sweep() {
+
+    // In reverse, runs share the data of the first run
+    for(int r = runs.size() - 1;r >= 0;r--)
+        delete runs[r];
+
+    runs.clear();
+}
+
+void Sweep::shareInputFrames() {
+
+    // Run that owns the frames used by each run, -1 = none
+    vector<int> owner(runs.size(), -1);
+    vector<bool> computed(runs.size(), false);
+
+    for(unsigned r = 1;r < runs.size();r++)
+        for(unsigned s = 0;s < r;s++)
+            if(owner[s] == -1 && runs[r]->area7a.respondsAs(runs[s]->area7a)) {
+                owner[r] = s;
+                break;
+            }
+
+    // Frames are only computed when they are shared
+    for(unsigned r = 1;r < runs.size();r++) {
+
+        if(owner[r] == -1)
+            continue;
+
+        if(!computed[owner[r]]) {
+
+            cout << "Run #" << owner[r]+1 << " shares its input with other runs, ";
+            runs[owner[r]]->area7a.precomputeFrames();
+            computed[owner[r]] = true;
+        }
+
+        runs[r]->area7a.useFramesOf(runs[owner[r]]->area7a);
+    }
+}
+
+void Sweep::writeParameterFiles(const char * outputDirectory) {
+    
+    // Same runs as read by the constructor
+    Config cfg;
+    
+    try {
+        
+        cfg.readFile(sweepFile.c_str());
+        Setting & list = cfg.lookup("runs");
+        
+        for(unsigned r = 0;r < runs.size() && r < static_cast<unsigned>(list.getLength());r++) {
+            
+            string file = makeRunDirectory(outputDirectory, r) + "Parameters.txt";
+            Param::writeMerged(parameterFile.c_str(), &list[r], file.c_str());
+        }
+    }
+    catch(const ConfigException &cex) {
+        cerr << "Unable to read sweep file again: " << sweepFile << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+}
+
+bool Sweep::run(const char * outputDirectory, int numberOfThreads, const RunOptions & options, bool resume) {
+
+    int nrOfRuns = runs.size();
+
+    // 75% of a single core rounds down to nothing
+    if(numberOfThreads < 1)
+        numberOfThreads = 1;
+
+    // Ensemble or not, every run directory gets one
+    writeParameterFiles(outputDirectory);
+    
+    // Falls back to separate runs when runs differ in more than the replica parameters
+    if(ensemble && Ensemble::canRun(runs)) {
+        
+        if(resume) {
+            
+            cerr << "An ensemble writes no checkpoints, it cannot be resumed." << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+        
+        if(options.profiling || options.counting || options.tracing || !options.telemetryFile.empty())
+            cout << "Profiling, tracing and telemetry are not supported for an ensemble, no profile, trace or telemetry is written." << endl;
+        
+        return runEnsemble(outputDirectory, numberOfThreads);
+    }
+    
+    // Small networks do not scale on their own, so by default
+    // runs are spread over threads, and remaining threads go to each run
+    int concurrentRuns = numberOfThreads < nrOfRuns ? numberOfThreads : nrOfRuns;
+    int runThreads = threadsPerRun > 0 ? threadsPerRun : numberOfThreads / concurrentRuns;
+
+    if(runThreads < 1)
+        runThreads = 1;
+
+    concurrentRuns = numberOfThreads / runThreads;
+
+    if(concurrentRuns < 1)
+        concurrentRuns = 1;
+
+    cout << "Sweep of " << nrOfRuns << " runs, " << concurrentRuns << " at a time with " << runThreads << " thread(s) each." << endl;
+    
+    // A run continues from its checkpoint, or was finished before the sweep was interrupted
+    vector<bool> finished(nrOfRuns, false);
+    
+    for(int r = 0;resume && r < nrOfRuns;r++) {
+        
+        string dir = makeRunDirectory(outputDirectory, r);
+        
+        if(fileExists(dir + "Checkpoint.dat")) {
+            
+            cout << "Run #" << r+1 << ": ";
+            runs[r]->loadCheckpoint((dir + "Checkpoint.dat").c_str());
+            
+        } else if(fileExists(dir + "TrainedNetwork.txt")) {
+            
+            cout << "Run #" << r+1 << " was finished: " << dir << endl;
+            finished[r] = true;
+        }
+    }
+
+#ifdef OMP_ENABLE
+    omp_set_max_active_levels(runThreads > 1 ? 2 : 1);
+    double start = omp_get_wtime();
+#endif
+
+    bool interrupted = false;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(concurrentRuns)
+    for(int r = 0;r < nrOfRuns;r++) {
+
+        // Once a run has been interrupted by a signal, runs not started are skipped
+        bool skip;
+
+#pragma omp critical(sweep)
+        skip = interrupted;
+
+        if(skip || finished[r])
+            continue;
+
+        string dir = makeRunDirectory(outputDirectory, r);
+
+#ifdef OMP_ENABLE
+        // Team size of the parallel region in runContinous()
+        omp_set_num_threads(runThreads);
+#endif
+
+        runs[r]->options = options;
+        runs[r]->runContinous(dir.c_str(), true, false);
+
+        if(runs[r]->interrupted) {
+
+#pragma omp critical(sweep)
+            interrupted = true;
+
+            continue;
+        }
+
+        string s(dir);
+        s.append("TrainedNetwork.txt");
+        runs[r]->outputFinalNetwork(s.c_str());
+        
+        // So that a resumed sweep does not train it again
+        string checkpoint(dir);
+        checkpoint.append("Checkpoint.dat");
+        std::remove(checkpoint.c_str());
+
+#pragma omp critical(sweep)
+        cout << "Finished run #" << r+1 << " (" << runs[r]->epochsCompleted << " epochs): " << dir << endl;
+    }
+
+#ifdef OMP_ENABLE
+    double elapsed = omp_get_wtime() - start;
+    cout << "Total sweep time = " <<  (int)(elapsed)/60 << " minutes: " << (int)(elapsed)%60 << " seconds" << endl;
+#endif
+
+    if(interrupted)
+        cout << "Sweep interrupted, resume with: --resume " << outputDirectory << " sweep ... " << outputDirectory << endl;
+
+    return !interrupted;
+}
+
+bool Sweep::runEnsemble(const char * outputDirectory, int numberOfThreads) {
+    
+    int nrOfRuns = runs.size();
+    
+    vector<string> dirs;
+    
+    for(int r = 0;r < nrOfRuns;r++)
+        dirs.push_back(makeRunDirectory(outputDirectory, r));
+    
+    cout << "Sweep of " << nrOfRuns << " runs as one ensemble with " << numberOfThreads << " thread(s)." << endl;
+    
+#ifdef OMP_ENABLE
+    omp_set_num_threads(numberOfThreads);
+    double start = omp_get_wtime();
+#endif
+    
+    Ensemble e(runs);
+    e.run(dirs);
+    
+    for(int r = 0;r < nrOfRuns;r++) {
+        
+        string s(dirs[r]);
+        s.append("TrainedNetwork.txt");
+        runs[r]->outputFinalNetwork(s.c_str());
+        
+        cout << "Finished run #" << r+1 << " (" << runs[r]->epochsCompleted << " epochs): " << dirs[r] << endl;
+    }
+    
+#ifdef OMP_ENABLE
+    double elapsed = omp_get_wtime() - start;
+    cout << "Total sweep time = " <<  (int)(elapsed)/60 << " minutes: " << (int)(elapsed)%60 << " seconds" << endl;
+#endif
+    
+    return true;
+}
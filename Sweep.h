@@ -0,0 +1,70 @@
+/*
+ *  Sweep.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+// Forward declarations
+class Network;
+struct RunOptions;
+
+// Includes
+#include <vector>
+#include <string>
+#include "Utilities.h"
+
+using std::vector;
+using std::string;
+
+// Trains several variants of one network in a single process. The sweep file
+// is a libconfig file with a list of runs, each a group of settings
+// that override the base parameter file, e.g.
+//
+// threadsPerRun = 1; // optional, default: spread available threads over runs
+// ensemble = true;   // optional, train all runs in lock step, see Ensemble.h
+// runs = ( { seed = 2; },
+//          { extrastriate = ( { learningrate = 0.05; } ); } );
+//
+// The overrides must not change the architecture, all runs start from
+// the same untrained network file. The data file is read once and shared, and
+// runs with identical input neurons share precomputed input frames.
+//
+// Every run directory gets Parameters.txt, the parameter file with the
+// overrides of the run merged, so a run can also be resumed on its own with
+// train --resume. An interrupted sweep is resumed in the same output
+// directory: runs with a checkpoint continue from it, finished runs are kept.
+class Sweep {
+
+    private:
+
+        string parameterFile;
+        string sweepFile;
+        vector<Network *> runs;
+        int threadsPerRun;
+        bool ensemble;
+
+        // Let runs with identical input neurons use one set of input frames
+        void shareInputFrames();
+    
+        // <outputDirectory>run<r>/Parameters.txt of every run
+        void writeParameterFiles(const char * outputDirectory);
+    
+        // All runs in one ensemble, using all threads
+        bool runEnsemble(const char * outputDirectory, int numberOfThreads);
+
+    public:
+
+        Sweep(const char * parameterFile, const char * sweepFile, const char * inputWeightFile, const char * dataFile, bool verbose);
+        ~Sweep();
+
+        // Run r is written to <outputDirectory>run<r>/, returns false if any run was interrupted,
+        // options are passed on to the networks (not used by an ensemble). When resuming,
+        // outputDirectory is the one of the interrupted sweep, ensembles cannot be resumed
+        bool run(const char * outputDirectory, int numberOfThreads, const RunOptions & options, bool resume);
+};
+
+#endif // SWEEP_H
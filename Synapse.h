@@ -14,6 +14,7 @@ class HiddenNeuron;
 
 // Includes
 #include <vector>
+#include "Utilities.h"
 
 using std::vector;
 
@@ -27,7 +28,11 @@ class Synapse {
 		
 		// Preallocate the required amount of space to save the history of the network
         //vector<float> weightHistory;
-        float * weightHistory;
+        // halfWeightHistory when p.weightPrecision == BF16, see HiddenNeuron::saveState()
+        union {
+            float * weightHistory;
+            bfloat16 * halfWeightHistory;
+        };
         
         Synapse(float weight, const Neuron * preSynapticNeuron, const HiddenNeuron * postSynapticNeuron, float * weightHistory);//, int fixedBufferWeightHistorySize);
 		~Synapse();
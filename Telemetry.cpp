@@ -0,0 +1,276 @@
+/*
+ *  Telemetry.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Telemetry.h"
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+using std::cerr;
+using std::endl;
+using std::stringstream;
+
+static double now() {
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// Resident set now, peak where /proc is missing
+static unsigned long long residentBytes() {
+
+#ifdef __linux__
+    FILE * statm = fopen("/proc/self/statm", "r");
+
+    if(statm != NULL) {
+
+        unsigned long size = 0, resident = 0;
+        int read = fscanf(statm, "%lu %lu", &size, &resident);
+        fclose(statm);
+
+        if(read == 2)
+            return static_cast<unsigned long long>(resident) * sysconf(_SC_PAGESIZE);
+    }
+#endif
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return static_cast<unsigned long long>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+static string escape(const string & s) {
+
+    string escaped;
+
+    for(unsigned i = 0;i < s.size();i++) {
+
+        if(s[i] == '"' || s[i] == '\\')
+            escaped += '\\';
+
+        escaped += s[i];
+    }
+
+    return escaped;
+}
+
+Telemetry::Telemetry() :
+interval(10),
+running(false),
+stopping(false),
+fd(-1),
+totalSteps(0),
+synapsesPerStep(0),
+epochs(0),
+objects(0),
+startTime(0),
+startSteps(0),
+steps(0),
+epoch(0),
+object(0),
+convergence(-1),
+lastSteps(0),
+lastTime(0) {
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&wake, NULL);
+}
+
+Telemetry::~Telemetry() {
+
+    stop("done");
+
+    pthread_mutex_destroy(&mutex);
+    pthread_cond_destroy(&wake);
+}
+
+void Telemetry::start(const string & path, double interval, const char * outputDirectory,
+                      unsigned long long totalSteps, unsigned long long doneSteps,
+                      unsigned long long synapsesPerStep, u_short epochs, u_short objects) {
+
+    if(running)
+        stop("done");
+
+    this->path = path;
+    this->interval = interval;
+    this->outputDirectory = outputDirectory;
+    this->totalSteps = totalSteps;
+    this->synapsesPerStep = synapsesPerStep;
+    this->epochs = epochs;
+    this->objects = objects;
+    this->startSteps = doneSteps;
+    this->steps = doneSteps;
+    this->epoch = 0;
+    this->object = 0;
+    this->convergence = -1;
+    this->stopping = false;
+
+    startTime = lastTime = now();
+    lastSteps = doneSteps;
+
+    // A FIFO is opened by the thread, when a reader is there, a bad file name is an error now
+    struct stat s;
+    bool isFifo = stat(path.c_str(), &s) == 0 && S_ISFIFO(s.st_mode);
+
+    if(!isFifo) {
+
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+        if(fd == -1) {
+
+            cerr << "Unable to open telemetry file " << path << ": " << strerror(errno) << endl;
+            cerr.flush();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if(pthread_create(&thread, NULL, loop, this) != 0) {
+
+        cerr << "Unable to start telemetry thread: " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    running = true;
+}
+
+void Telemetry::stop(const char * state) {
+
+    if(!running)
+        return;
+
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&mutex);
+
+    pthread_join(thread, NULL);
+    running = false;
+
+    writeLine(state);
+
+    if(fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void Telemetry::setPosition(u_short epoch, u_short object) {
+
+    this->epoch.store(epoch, std::memory_order_relaxed);
+    this->object.store(object, std::memory_order_relaxed);
+}
+
+void Telemetry::setConvergence(float rms) {
+
+    pthread_mutex_lock(&mutex);
+    convergence = rms;
+    pthread_mutex_unlock(&mutex);
+}
+
+void * Telemetry::loop(void * telemetry) {
+
+    Telemetry & t = *static_cast<Telemetry *>(telemetry);
+
+    // A FIFO whose reader left gives EPIPE instead of killing the process
+    sigset_t pipe;
+    sigemptyset(&pipe);
+    sigaddset(&pipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe, NULL);
+
+    pthread_mutex_lock(&t.mutex);
+
+    while(!t.stopping) {
+
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+
+        double wakeUp = tv.tv_sec + tv.tv_usec * 1e-6 + t.interval;
+        struct timespec until;
+        until.tv_sec = static_cast<time_t>(wakeUp);
+        until.tv_nsec = static_cast<long>((wakeUp - until.tv_sec) * 1e9);
+
+        while(!t.stopping && pthread_cond_timedwait(&t.wake, &t.mutex, &until) != ETIMEDOUT);
+
+        if(t.stopping)
+            break;
+
+        pthread_mutex_unlock(&t.mutex);
+        t.writeLine("running");
+        pthread_mutex_lock(&t.mutex);
+    }
+
+    pthread_mutex_unlock(&t.mutex);
+    return NULL;
+}
+
+void Telemetry::writeLine(const char * state) {
+
+    if(fd == -1) {
+
+        fd = open(path.c_str(), O_WRONLY | O_APPEND | O_NONBLOCK);
+
+        if(fd == -1)
+            return;
+    }
+
+    double time = now();
+    unsigned long long done = steps.load(std::memory_order_relaxed);
+
+    // Recent rate for throughput, average over run for ETA
+    double recentRate = time > lastTime ? (done - lastSteps) / (time - lastTime) : 0;
+    double averageRate = time > startTime ? (done - startSteps) / (time - startTime) : 0;
+    double eta = averageRate > 0 && totalSteps > done ? (totalSteps - done) / averageRate : 0;
+
+    lastSteps = done;
+    lastTime = time;
+
+    pthread_mutex_lock(&mutex);
+    float rms = convergence;
+    pthread_mutex_unlock(&mutex);
+
+    stringstream line;
+    line.precision(12);
+
+    line << "{\"output\":\"" << escape(outputDirectory) << "\",\"state\":\"" << state << "\",\"seconds\":" << time - startTime
+         << ",\"epoch\":" << epoch.load(std::memory_order_relaxed) << ",\"epochs\":" << epochs
+         << ",\"object\":" << object.load(std::memory_order_relaxed) << ",\"objects\":" << objects
+         << ",\"step\":" << done << ",\"steps\":" << totalSteps
+         << ",\"stepsPerSecond\":" << recentRate << ",\"synapseUpdatesPerSecond\":" << recentRate * synapsesPerStep
+         << ",\"eta\":" << eta << ",\"rssBytes\":" << residentBytes() << ",\"weightChange\":";
+
+    if(rms < 0)
+        line << "null";
+    else
+        line << rms;
+
+    line << "}\n";
+
+    // One write, so lines of runs sharing a file stay whole
+    string text = line.str();
+
+    if(write(fd, text.c_str(), text.size()) == -1 && errno != EAGAIN) {
+
+        // Reader of FIFO left, reopened with next line
+        close(fd);
+        fd = -1;
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ *  Telemetry.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Includes
+#include <string>
+#include <atomic>
+#include <pthread.h>
+#include "Utilities.h"
+
+using std::string;
+
+// Progress of a run as JSON lines, written every interval seconds by a
+// background thread to a file or FIFO: epoch, object, steps/s, synapse
+// updates/s, ETA, resident memory and last weight change. Lines are appended
+// and name the output directory, so runs of a sweep can share one file. A
+// FIFO without reader is skipped, and reopened once one comes along.
+//
+// The team only stores counters, from thread 0 and without barriers.
+class Telemetry {
+
+    private:
+
+        string path;
+        string outputDirectory;
+        double interval;
+
+        pthread_t thread;
+        pthread_mutex_t mutex;
+        pthread_cond_t wake;
+        bool running;
+        bool stopping;
+        int fd;
+
+        // Set before thread starts
+        unsigned long long totalSteps;
+        unsigned long long synapsesPerStep;
+        u_short epochs;
+        u_short objects;
+        double startTime;
+        unsigned long long startSteps;
+
+        // Set by team
+        std::atomic<unsigned long long> steps;
+        std::atomic<int> epoch;
+        std::atomic<int> object;
+        float convergence;                  // under mutex, < 0 until first epoch ends
+
+        // Rate since last line
+        unsigned long long lastSteps;
+        double lastTime;
+
+        static void * loop(void * telemetry);
+        void writeLine(const char * state);
+
+    public:
+
+        Telemetry();
+        ~Telemetry();
+
+        // doneSteps of totalSteps are done already, e.g. when resuming
+        void start(const string & path, double interval, const char * outputDirectory,
+                   unsigned long long totalSteps, unsigned long long doneSteps,
+                   unsigned long long synapsesPerStep, u_short epochs, u_short objects);
+
+        // Writes last line with state (done, converged, interrupted) and joins thread
+        void stop(const char * state);
+
+        void addSteps(unsigned long long count) { steps.fetch_add(count, std::memory_order_relaxed); }
+        void setPosition(u_short epoch, u_short object);
+        void setConvergence(float rms);
+};
+
+#endif // TELEMETRY_H
@@ -0,0 +1,198 @@
+/*
+ *  TestBatch.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "TestBatch.h"
+#include "Network.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include "Utilities.h"
+
+#ifdef OS_WIN
+    #include <direct.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::ifstream;
+using std::ofstream;
+using std::stringstream;
+
+// Directory <parent><name><i+1>/, created if needed
+static string makeDirectory(const string & parent, const char * name, int i) {
+
+    stringstream ss;
+    ss << parent << name << i+1 << "/";
+    string dir = ss.str();
+
+#ifdef OS_WIN
+    int failed = _mkdir(dir.c_str());
+#else
+    int failed = mkdir(dir.c_str(), 0755);
+#endif
+
+    if(failed != 0 && errno != EEXIST) {
+
+        cerr << "Unable to create output directory: " << dir << ", error = " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    return dir;
+}
+
+TestBatch::TestBatch(const char * parameterFile, const char * networkList, const char * dataList, bool verbose) :
+parameterFile(parameterFile),
+networks(readList(networkList)),
+dataFiles(readList(dataList)),
+verbose(verbose) {}
+
+vector<string> TestBatch::readList(const char * listFile) {
+
+    ifstream file(listFile);
+
+    if(!file) {
+
+        cerr << "Unable to open list file: " << listFile << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    vector<string> list;
+    string line;
+
+    while(getline(file, line)) {
+
+        // Trim surrounding white space, also \r of lists written on windows
+        size_t first = line.find_first_not_of(" \t\r");
+        size_t last = line.find_last_not_of(" \t\r");
+
+        if(first == string::npos || line[first] == '#')
+            continue;
+
+        list.push_back(line.substr(first, last - first + 1));
+    }
+
+    if(list.empty()) {
+
+        cerr << "No files in list file: " << listFile << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    return list;
+}
+
+void TestBatch::run(const char * outputDirectory, int numberOfThreads, const RunOptions & options) {
+
+    int nrOfNetworks = networks.size();
+
+    // 75% of a single core rounds down to nothing
+    if(numberOfThreads < 1)
+        numberOfThreads = 1;
+
+    // As in a sweep, tests are spread over threads, and remaining threads go to each test
+    int concurrentTests = numberOfThreads < nrOfNetworks ? numberOfThreads : nrOfNetworks;
+    int testThreads = numberOfThreads / concurrentTests;
+
+    cout << "Test batch of " << nrOfNetworks << " networks on " << dataFiles.size() << " data files, "
+         << concurrentTests << " at a time with " << testThreads << " thread(s) each." << endl;
+
+    // Directories are known up front, so the index does not depend on which test finishes first
+    string indexFile(outputDirectory);
+    indexFile.append("TestBatch.txt");
+    ofstream index(indexFile.c_str());
+
+    if(!index) {
+
+        cerr << "Unable to open index file: " << indexFile << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    vector<vector<string> > dirs(dataFiles.size());
+
+    for(unsigned d = 0;d < dataFiles.size();d++) {
+
+        string dataDirectory = makeDirectory(outputDirectory, "data", d);
+
+        for(int n = 0;n < nrOfNetworks;n++) {
+
+            dirs[d].push_back(makeDirectory(dataDirectory, "net", n));
+            index << dirs[d][n] << " " << networks[n] << " " << dataFiles[d] << endl;
+        }
+    }
+
+    index.close();
+
+#ifdef OMP_ENABLE
+    omp_set_max_active_levels(testThreads > 1 ? 2 : 1);
+    double start = omp_get_wtime();
+    omp_set_num_threads(testThreads);
+#endif
+
+    for(unsigned d = 0;d < dataFiles.size();d++) {
+
+        // First network reads the data file, the others share its data and input frames
+        cout << "Loading data file #" << d+1 << ": " << dataFiles[d] << endl;
+        Network * first = new Network(dataFiles[d].c_str(), parameterFile.c_str(), verbose, networks[0].c_str(), false);
+
+        if(nrOfNetworks > 1) {
+
+            cout << "Data file #" << d+1 << " is shared by " << nrOfNetworks << " networks, ";
+            first->area7a.precomputeFrames();
+        }
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(concurrentTests)
+        for(int n = 0;n < nrOfNetworks;n++) {
+
+#ifdef OMP_ENABLE
+            // Team size of the regions built below and of the parallel region in runContinous()
+            omp_set_num_threads(testThreads);
+#endif
+
+            Network * network = first;
+
+            // Loading is mostly reading a file, one at a time keeps the log readable
+            if(n > 0) {
+
+#pragma omp critical(testBatch)
+                {
+                    cout << "Loading network #" << n+1 << ": " << networks[n] << endl;
+                    network = new Network(first->area7a, parameterFile.c_str(), verbose, networks[n].c_str(), false);
+                    network->area7a.useFramesOf(first->area7a);
+                }
+            }
+
+            network->options = options;
+            network->runContinous(dirs[d][n].c_str(), false, false);
+
+#pragma omp critical(testBatch)
+            cout << "Finished test of network #" << n+1 << " on data file #" << d+1 << ": " << dirs[d][n] << endl;
+
+            if(network != first)
+                delete network;
+        }
+
+        delete first;
+    }
+
+#ifdef OMP_ENABLE
+    double elapsed = omp_get_wtime() - start;
+    cout << "Total test batch time = " <<  (int)(elapsed)/60 << " minutes: " << (int)(elapsed)%60 << " seconds" << endl;
+#endif
+}
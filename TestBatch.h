@@ -0,0 +1,49 @@
+/*
+ *  TestBatch.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef TESTBATCH_H
+#define TESTBATCH_H
+
+// Forward declarations
+struct RunOptions;
+
+// Includes
+#include <vector>
+#include <string>
+#include "Utilities.h"
+
+using std::vector;
+using std::string;
+
+// Tests every trained network of a list on every data file of a list in a
+// single process. The list files hold one file name per line, empty lines
+// and lines starting with # are skipped, e.g. all TrainedNetwork_eN.txt of
+// a run. Data files are done one after the other: a data file is read and its
+// input frames are computed once, then its networks are tested in parallel.
+// Networks are loaded when a thread is free to test them and freed right
+// after, so at most one network per concurrent test is in memory.
+class TestBatch {
+
+    private:
+
+        string parameterFile;
+        vector<string> networks;
+        vector<string> dataFiles;
+        bool verbose;
+
+        static vector<string> readList(const char * listFile);
+
+    public:
+
+        TestBatch(const char * parameterFile, const char * networkList, const char * dataList, bool verbose);
+
+        // Network n on data file d is written to <outputDirectory>data<d>/net<n>/,
+        // <outputDirectory>TestBatch.txt lists the files of each directory
+        void run(const char * outputDirectory, int numberOfThreads, const RunOptions & options);
+};
+
+#endif // TESTBATCH_H
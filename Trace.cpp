@@ -0,0 +1,159 @@
+/*
+ *  Trace.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Trace.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ofstream;
+using std::string;
+
+static double now() {
+#ifdef OMP_ENABLE
+    return omp_get_wtime();
+#else
+    return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+static int threadNumber() {
+#ifdef OMP_ENABLE
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+Trace::Trace() : slots(0), origin(0), enabled(false), stepInterval(1), maxSpans(200000) {}
+
+void Trace::init(u_short hiddenRegions, int threads) {
+
+    this->slots = hiddenRegions + 2;
+
+    buffers.assign(threads, ThreadBuffer());
+
+    for(int t = 0;t < threads;t++) {
+        buffers[t].dropped = 0;
+        buffers[t].step = 0;
+        buffers[t].recording = false;
+    }
+
+    origin = now();
+}
+
+void Trace::startStep() {
+
+    if(!enabled)
+        return;
+
+    int thread = threadNumber();
+
+    if(thread < static_cast<int>(buffers.size())) {
+
+        ThreadBuffer & buffer = buffers[thread];
+        buffer.recording = (buffer.step % stepInterval) == 0;
+        buffer.step++;
+    }
+}
+
+void Trace::addSpan(const char * name, u_short slot, double start, double end, bool always) {
+
+    int thread = threadNumber();
+
+    if(!enabled || thread >= static_cast<int>(buffers.size()))
+        return;
+
+    ThreadBuffer & buffer = buffers[thread];
+
+    if(!buffer.recording && !always)
+        return;
+
+    if(buffer.spans.size() < maxSpans) {
+
+        Span span = {name, slot, start - origin, end - origin};
+        buffer.spans.push_back(span);
+    }
+    else
+        buffer.dropped++;
+}
+
+void Trace::write(const char * outputDirectory) {
+
+    if(!enabled)
+        return;
+
+    string name(outputDirectory);
+    name.append("Trace.json");
+
+    ofstream file(name.c_str());
+
+    if(!file) {
+
+        cerr << "Unable to open " << name << ": " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    // Microseconds
+    file.setf(std::ios::fixed);
+    file.precision(3);
+
+    file << "{\"traceEvents\":[" << endl;
+
+    unsigned long long dropped = 0;
+
+    for(unsigned t = 0;t < buffers.size();t++) {
+
+        file << (t == 0 ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t << ",\"args\":{\"name\":\"thread " << t << "\"}}";
+
+        for(unsigned s = 0;s < buffers[t].spans.size();s++) {
+
+            const Span & span = buffers[t].spans[s];
+
+            file << ",\n{\"name\":\"" << span.name << "\",\"cat\":\"";
+
+            if(span.slot == 0)
+                file << "input";
+            else if(span.slot == teamSlot())
+                file << "team";
+            else
+                file << "region " << span.slot;
+
+            file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << t << ",\"ts\":" << span.start * 1e6 << ",\"dur\":" << (span.end - span.start) * 1e6 << "}";
+        }
+
+        dropped += buffers[t].dropped;
+    }
+
+    file << endl << "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"stepInterval\":" << stepInterval << ",\"maxSpans\":" << maxSpans << ",\"droppedSpans\":" << dropped << "}}" << endl;
+
+    if(dropped > 0)
+        cout << "Trace buffers were full, " << dropped << " spans were dropped (--tracemax)." << endl;
+}
+
+TraceSpan::TraceSpan(Trace & trace, const char * name) :
+trace(trace),
+name(name),
+start(trace.enabled ? now() : 0) {}
+
+TraceSpan::~TraceSpan() {
+
+    if(trace.enabled)
+        trace.addSpan(name, trace.teamSlot(), start, now());
+}
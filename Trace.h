@@ -0,0 +1,83 @@
+/*
+ *  Trace.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Includes
+#include <vector>
+#include "Utilities.h"
+
+using std::vector;
+
+// Timeline of spans per thread, written in Chrome trace format (chrome://tracing
+// or ui.perfetto.dev). Each thread appends to its own buffer, so recording takes
+// no lock. Only every stepInterval-th time step is recorded, and a thread stops
+// recording once its buffer holds maxSpans spans, later spans are only counted.
+//
+// Slots are those of Profile: 0 = input, k = hidden region k, last = whole team
+class Trace {
+
+    private:
+
+        struct Span {
+            const char * name;
+            u_short slot;
+            double start, end;
+        };
+
+        // Padded, so threads never write to the same cache line
+        struct ThreadBuffer {
+            vector<Span> spans;
+            unsigned long long dropped;
+            unsigned long long step;
+            bool recording;
+            char padding[64];
+        };
+
+        vector<ThreadBuffer> buffers;
+        u_short slots;
+        double origin;
+
+    public:
+
+        bool enabled;
+        unsigned long stepInterval;
+        unsigned long maxSpans;
+
+        Trace();
+
+        // Drops all spans
+        void init(u_short hiddenRegions, int threads);
+        u_short teamSlot() { return slots - 1; }
+
+        // Called by every thread at the start of each time step, decides if the step is recorded
+        void startStep();
+
+        // Span of calling thread, always is for rare spans outside time steps (snapshot, output)
+        void addSpan(const char * name, u_short slot, double start, double end, bool always = false);
+
+        // Trace.json
+        void write(const char * outputDirectory);
+};
+
+// Traces the enclosing block as a span of the whole team, e.g. a barrier wait
+class TraceSpan {
+
+    private:
+
+        Trace & trace;
+        const char * name;
+        double start;
+
+    public:
+
+        TraceSpan(Trace & trace, const char * name);
+        ~TraceSpan();
+};
+
+#endif // TRACE_H
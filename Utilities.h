@@ -8,6 +8,8 @@
  #ifndef UTILITIES_H
 #define UTILITIES_H
 
+#include <cstring>
+
 // Define this macro to disable openmp, e.g. while debugging
 //#define DEBUG
 
@@ -21,6 +23,30 @@
 
 typedef unsigned short u_short;
 
+// bfloat16 is the upper half of a float: same range, 8 instead of 24 bits
+// of mantissa. Rounding is to nearest even, NaN stays NaN.
+typedef u_short bfloat16;
+
+inline bfloat16 toBfloat16(float f) {
+    
+    unsigned int bits;
+    memcpy(&bits, &f, sizeof(bits));
+    
+    if((bits & 0x7fffffff) > 0x7f800000)
+        return static_cast<bfloat16>((bits >> 16) | 0x40);
+    
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return static_cast<bfloat16>(bits >> 16);
+}
+
+inline float fromBfloat16(bfloat16 h) {
+    
+    unsigned int bits = static_cast<unsigned int>(h) << 16;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
 enum DATA { 
     FIRING_RATE = 0,
     ACTIVATION = 1,
@@ -0,0 +1,214 @@
+/*
+ *  Benchmark.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Benchmark.h"
+#include "../HiddenRegion.h"
+#include "../HiddenNeuron.h"
+#include <ctime>
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+static const char * kernelNames[NR_OF_KERNELS] = {"input", "stimulation", "filter", "threshold", "firing rate", "learning", "time step"};
+
+const char * kernelName(KERNEL kernel) {
+    return kernelNames[kernel];
+}
+
+static double now() {
+#ifdef OMP_ENABLE
+    return omp_get_wtime();
+#else
+    return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+static int threadNumber() {
+#ifdef OMP_ENABLE
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+Benchmark::Benchmark(Network & network, unsigned repetitions, unsigned warmUp) :
+network(network),
+repetitions(repetitions),
+warmUp(warmUp) {
+
+    network.setupPushPropagation();
+
+    // As at the start of training, only SCALED normalization reads them
+    for(unsigned k = 0;k < network.ESPathway.size();k++)
+        network.ESPathway[k].setupWeightScales();
+}
+
+void Benchmark::setThreads(int threads) {
+
+#ifdef OMP_ENABLE
+    omp_set_num_threads(threads);
+#endif
+
+    network.setupPartition(threads);
+}
+
+void Benchmark::run(KERNEL kernel, unsigned long int step) {
+
+    int thread = threadNumber();
+    vector<HiddenRegion> & regions = network.ESPathway;
+
+    switch(kernel) {
+
+        case K_INPUT:
+            network.area7a.setFiringRate(0, step % network.area7a.timeStepsInObject[0]);
+            break;
+
+        case K_STIMULATION:
+            // Push propagation finds the presynaptic neurons that fire first, as Network does
+            if(network.p.pushEpsilon >= 0) {
+#pragma omp for schedule(static, 1)
+                for(unsigned k = 0;k < regions.size();k++)
+                    regions[k].findActivePreSynaptic();
+            }
+
+            for(unsigned r = 0;r < network.stimulationPartition[thread].size();r++) {
+                const NeuronRange & range = network.stimulationPartition[thread][r];
+                regions[range.region].computeNewActivation(range.first, range.last);
+            }
+            break;
+
+        case K_FILTER:
+            for(unsigned r = 0;r < network.filterPartition[thread].size();r++) {
+                const NeuronRange & range = network.filterPartition[thread][r];
+                regions[range.region].filter(range.first, range.last);
+            }
+            break;
+
+        // Every thread finds the same threshold in a time step, once is enough here
+        case K_THRESHOLD:
+#pragma omp single nowait
+            for(unsigned k = 0;k < regions.size();k++)
+                regions[k].computeThreshold();
+            break;
+
+        case K_FIRING_RATE:
+            for(unsigned r = 0;r < network.firingRatePartition[thread].size();r++) {
+                const NeuronRange & range = network.firingRatePartition[thread][r];
+                regions[range.region].computeNewFiringRate(range.first, range.last);
+            }
+            break;
+
+        case K_LEARNING:
+            for(unsigned r = 0;r < network.learningPartition[thread].size();r++) {
+                const NeuronRange & range = network.learningPartition[thread][r];
+                regions[range.region].applyLearningRule(range.first, range.last);
+            }
+            break;
+
+        case K_TIME_STEP:
+            for(unsigned r = 0;r < network.timeStepPartition[thread].size();r++) {
+                const NeuronRange & range = network.timeStepPartition[thread][r];
+                regions[range.region].doTimeStep(range.first, range.last, false);
+            }
+            break;
+    }
+}
+
+void Benchmark::settle(unsigned steps) {
+
+#pragma omp parallel
+    {
+        for(unsigned s = 0;s < steps;s++) {
+
+            unsigned long int t = s % network.area7a.timeStepsInObject[0];
+
+            network.area7a.setFiringRate(0, t);
+            network.computeNewFiringRates(t);
+            network.applyLearningRules(t);
+
+#pragma omp barrier
+            network.doTimeSteps(false, t);
+        }
+    }
+}
+
+double Benchmark::time(KERNEL kernel) {
+
+    double start = 0, seconds = 0;
+
+#pragma omp parallel
+    {
+        for(unsigned r = 0;r < warmUp + repetitions;r++) {
+
+            // Everybody is done with warm up after the barrier below
+            if(r == warmUp) {
+#pragma omp master
+                start = now();
+            }
+
+            run(kernel, r);
+
+#pragma omp barrier
+        }
+
+#pragma omp master
+        seconds = now() - start;
+    }
+
+    return seconds / repetitions;
+}
+
+bool Benchmark::usesSynapses(KERNEL kernel) {
+    return kernel == K_STIMULATION || kernel == K_LEARNING;
+}
+
+unsigned long long Benchmark::work(KERNEL kernel) {
+
+    if(kernel == K_INPUT)
+        return network.area7a.depth * network.area7a.verDimension * network.area7a.horDimension;
+
+    unsigned long long total = 0;
+
+    for(unsigned k = 0;k < network.ESPathway.size();k++) {
+
+        HiddenRegion & region = network.ESPathway[k];
+        unsigned int neurons = region.getNrOfNeurons();
+
+        if(kernel == K_FILTER)
+            total += region.verDimension * region.horDimension;
+        else if(usesSynapses(kernel))
+            for(unsigned int n = 0;n < neurons;n++)
+                total += region.getNrOfAfferentSynapses(n);
+        else
+            total += neurons;
+    }
+
+    return total;
+}
+
+double Benchmark::outputHistory(const char * outputDirectory) {
+
+    unsigned long int outputs = network.area7a.outputtedTimeStepsPerEpoch;
+
+    // Exactly as many saves as the history has room for
+#pragma omp parallel
+    {
+        for(unsigned long int s = 0;s < outputs;s++) {
+
+            unsigned long int t = s % network.area7a.timeStepsInObject[0];
+
+            network.area7a.setFiringRate(0, t);
+            network.computeNewFiringRates(t);
+            network.doTimeSteps(true, t);
+        }
+    }
+
+    double start = now();
+    network.outputHistory(outputDirectory, false);
+    return now() - start;
+}
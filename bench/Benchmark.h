@@ -0,0 +1,65 @@
+/*
+ *  Benchmark.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Includes
+#include "../Network.h"
+#include "../Utilities.h"
+
+enum KERNEL {
+    K_INPUT = 0,            // InputRegion::setFiringRate()
+    K_STIMULATION = 1,      // HiddenRegion::computeNewActivation()
+    K_FILTER = 2,           // HiddenRegion::filter(), only with lateral interaction
+    K_THRESHOLD = 3,        // HiddenRegion::computeThreshold() (findThreshold()), one thread
+    K_FIRING_RATE = 4,      // HiddenRegion::computeNewFiringRate()
+    K_LEARNING = 5,         // HiddenRegion::applyLearningRule(), rule of parameter file
+    K_TIME_STEP = 6         // HiddenRegion::doTimeStep() without saving
+};
+
+#define NR_OF_KERNELS 7
+
+const char * kernelName(KERNEL kernel);
+
+// Runs one kernel over and over on the neuron ranges Network gives each
+// thread (Network::setupPartition()), with a barrier after each call, as
+// in a time step. Memory stays where the network was first placed.
+class Benchmark {
+
+    private:
+
+        Network & network;
+        unsigned repetitions;
+        unsigned warmUp;
+
+        // Call of calling thread, step picks the input sample
+        void run(KERNEL kernel, unsigned long int step);
+
+    public:
+
+        Benchmark(Network & network, unsigned repetitions, unsigned warmUp);
+
+        // Team size and partition of following calls
+        void setThreads(int threads);
+
+        // Runs whole time steps, so firing rates and traces are not all zero
+        void settle(unsigned steps);
+
+        // Seconds per call
+        double time(KERNEL kernel);
+
+        // Per call, synapses for stimulation and learning, neurons otherwise
+        bool usesSynapses(KERNEL kernel);
+        unsigned long long work(KERNEL kernel);
+
+        // Fills the history of a network loaded for testing and writes it
+        // to outputDirectory, returns seconds of writing only
+        double outputHistory(const char * outputDirectory);
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,117 @@
+/*
+ *  Generator.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Generator.h"
+#include "../BinaryWrite.h"
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+
+using std::ofstream;
+using std::cerr;
+using std::endl;
+
+SyntheticNetwork::SyntheticNetwork() :
+dimension(32),
+depth(1),
+regions(1),
+inputDimension(41),
+fanIn(1),
+rule(TRACE_RULE),
+lateralInteraction(NONE),
+saveHistory(SH_NONE),
+outputAtTimeStepMultiple(10),
+objects(2),
+samplesPerObject(20) {}
+
+// Preferences are 1 degree apart, so the field has inputDimension of them
+static float fieldSize(const SyntheticNetwork & network) {
+    return static_cast<float>(network.inputDimension - 1);
+}
+
+void writeParameterFile(const string & filename, const SyntheticNetwork & network) {
+
+    ofstream file(filename.c_str());
+
+    if(!file) {
+
+        cerr << "Unable to open " << filename << ": " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    file << "# synthetic benchmark network" << endl;
+    file << "traceTimeConstant = 0.1;" << endl;
+    file << "stepSizeFraction = 0.1;" << endl;
+    file << "resetActivity = true;" << endl;
+    file << "outputAtTimeStepMultiple = " << network.outputAtTimeStepMultiple << ";" << endl;
+    file << "training: {" << endl;
+    file << "  rule = " << network.rule << ";" << endl;
+    file << "  covarianceThreshold = 0.5;" << endl;
+    file << "  resetTrace = true;" << endl;
+    file << "  saveNetwork = false;" << endl;
+    file << "  saveNetworkAtEpochMultiple = 1;" << endl;
+    file << "  nrOfEpochs = 1;" << endl;
+    file << "};" << endl;
+    file << "feedback = 0;" << endl;
+    file << "initialWeight = 1;" << endl;
+    file << "weightNormalization = 1;" << endl;
+    file << "weightVectorLength = 1.0;" << endl;
+    file << "sparsenessRoutine = 1;" << endl;
+    file << "lateralInteraction = " << network.lateralInteraction << ";" << endl;
+    file << "seed = 55;" << endl;
+    file << "area7a: {" << endl;
+    file << "  visualPreferenceDistance = 1.0;" << endl;
+    file << "  eyePositionPrefrerenceDistance = 1.0;" << endl;
+    file << "  horVisualFieldSize = " << fieldSize(network) << ".0;" << endl;
+    file << "  horEyePositionFieldSize = " << fieldSize(network) << ".0;" << endl;
+    file << "  gaussianSigma = 5.0;" << endl;
+    file << "  sigmoidSlope = 0.1;" << endl;
+    file << "  sigmoidModulationPercentage = 0.0;" << endl;
+    file << "  inputEncoding = 1;" << endl;
+    file << "};" << endl;
+    file << "extrastriate = (" << endl;
+
+    // Full connectivity takes every presynaptic neuron, whatever fanInCountPercentage is
+    for(u_short k = 0;k < network.regions;k++)
+        file << "  { dimension = " << network.dimension << "; depth = " << network.depth
+             << "; connectivity = " << (network.fanIn < 1 ? SPARSE : FULL) << "; fanInCountPercentage = " << network.fanIn
+             << "; epochs = 1; learningrate = 0.1; eta = 0.8; timeConstant = 0.1; sparsenessLevel = 0.9; sigmoidSlope = 10.0; sigmoidThreshold = 0.0;"
+             << " globalInhibitoryConstant = 0.0; externalStimulation = 0.0; inhibitoryRadius = 1.0; inhibitoryContrast = 1.0;"
+             << " somExcitatoryRadius = 1.0; somExcitatoryContrast = 1.0; somInhibitoryRadius = 1.0; somInhibitoryContrast = 1.0;"
+             << " filterWidth = 3; saveHistory = " << network.saveHistory << "; }" << (k + 1 < network.regions ? "," : "") << endl;
+
+    file << ");" << endl;
+}
+
+void writeDataFile(const string & filename, const SyntheticNetwork & network) {
+
+    BinaryWrite file(filename);
+
+    float field = fieldSize(network);
+    u_short samplingRate = 10;
+    u_short simultanousObjects = 1;
+
+    file << samplingRate << simultanousObjects << field << field;
+
+    // Eye sweeps the field, object o is seen at its own retinal position
+    for(u_short o = 0;o < network.objects;o++) {
+
+        float retinal = -field / 2 + field * (o + 0.5f) / network.objects;
+
+        for(u_short s = 0;s < network.samplesPerObject;s++) {
+
+            float eye = -field / 2 + field * s / (network.samplesPerObject > 1 ? network.samplesPerObject - 1 : 1);
+            file << eye << retinal;
+        }
+
+        file << std::numeric_limits<float>::quiet_NaN();
+    }
+}
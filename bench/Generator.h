@@ -0,0 +1,43 @@
+/*
+ *  Generator.h
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+// Includes
+#include <string>
+#include "../Param.h"
+#include "../Utilities.h"
+
+using std::string;
+
+// Network and stimuli of a benchmark, written as an ordinary parameter file
+// and data file, so benchmarks need no data file made by MATLAB. All hidden
+// regions have the same size, the input layer is inputDimension x inputDimension.
+struct SyntheticNetwork {
+
+    u_short dimension;
+    u_short depth;
+    u_short regions;
+    u_short inputDimension;
+    float fanIn;                    // fraction of presynaptic layer, 1 = full connectivity
+    LEARNING_RULE rule;
+    LATERAL lateralInteraction;
+    SAVEHISTORY saveHistory;
+    u_short outputAtTimeStepMultiple;
+
+    // One eye sweep over the visual field per object
+    u_short objects;
+    u_short samplesPerObject;
+
+    SyntheticNetwork();
+};
+
+void writeParameterFile(const string & filename, const SyntheticNetwork & network);
+void writeDataFile(const string & filename, const SyntheticNetwork & network);
+
+#endif // GENERATOR_H
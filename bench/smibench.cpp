@@ -0,0 +1,600 @@
+/*
+ *  smibench.cpp
+ *
+ * Copyright 2018 OFTNAI. All rights reserved.
+ *
+ */
+
+#include "Generator.h"
+#include "Benchmark.h"
+#include "../Network.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#ifdef OMP_ENABLE
+    #include <omp.h>
+#endif
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ofstream;
+using std::stringstream;
+using std::setw;
+using std::string;
+using std::vector;
+
+static const char * ruleNames[3] = {"trace", "hebb", "covariance"};
+
+// What to sweep, from the command line
+struct Sweep {
+    vector<int> threads;
+    vector<int> dimensions;
+    vector<int> depths;
+    vector<float> fanIns;
+    vector<int> rules;
+    int regions;
+    int inputDimension;
+    int weakDimension;
+    unsigned repetitions;
+    LATERAL lateralInteraction;
+    bool verbose;
+};
+
+// One benchmark result, a row of bench.csv
+struct Result {
+    string table;
+    string kernel;
+    int rule;
+    int dimension;
+    int depth;
+    float fanIn;
+    int threads;
+    double seconds;
+    unsigned long long work;
+    double speedup;
+    double efficiency;
+};
+
+void usage();
+
+static double now() {
+#ifdef OMP_ENABLE
+    return omp_get_wtime();
+#else
+    return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+static int processors() {
+#ifdef OMP_ENABLE
+    return omp_get_num_procs();
+#else
+    return 1;
+#endif
+}
+
+static void setThreads(int threads) {
+#ifdef OMP_ENABLE
+    omp_set_num_threads(threads);
+#endif
+}
+
+// Comma separated list
+template <class T>
+static bool parseList(const char * text, vector<T> & list) {
+
+    stringstream ss(text);
+    string item;
+
+    list.clear();
+
+    while(std::getline(ss, item, ',')) {
+
+        stringstream value(item);
+        T v;
+
+        if(!(value >> v) || v <= 0)
+            return false;
+
+        list.push_back(v);
+    }
+
+    return !list.empty();
+}
+
+static unsigned long long fileSize(const string & filename) {
+
+    struct stat s;
+    return stat(filename.c_str(), &s) == 0 ? s.st_size : 0;
+}
+
+static unsigned long long directorySize(const string & directory) {
+
+    unsigned long long total = 0;
+    DIR * dir = opendir(directory.c_str());
+
+    if(dir == NULL)
+        return 0;
+
+    struct dirent * entry;
+
+    while((entry = readdir(dir)) != NULL)
+        if(entry->d_name[0] != '.')
+            total += fileSize(directory + entry->d_name);
+
+    closedir(dir);
+    return total;
+}
+
+static void makeDirectory(const string & directory) {
+
+    if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+
+        cerr << "Unable to create " << directory << ": " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Simulator output while building and loading is dropped unless --verbose
+class Quiet {
+
+    private:
+
+        std::streambuf * saved;
+        ofstream sink;
+
+    public:
+
+        Quiet(bool verbose) : saved(NULL) {
+
+            if(!verbose)
+                saved = cout.rdbuf(sink.rdbuf());
+        }
+
+        ~Quiet() { stop(); }
+
+        void stop() {
+
+            if(saved != NULL)
+                cout.rdbuf(saved);
+
+            saved = NULL;
+        }
+};
+
+static SyntheticNetwork synthetic(const Sweep & sweep, int dimension, int depth, float fanIn, int rule) {
+
+    SyntheticNetwork network;
+
+    network.dimension = dimension;
+    network.depth = depth;
+    network.fanIn = fanIn;
+    network.rule = static_cast<LEARNING_RULE>(rule);
+    network.regions = sweep.regions;
+    network.inputDimension = sweep.inputDimension;
+    network.lateralInteraction = sweep.lateralInteraction;
+
+    return network;
+}
+
+// Kernels of one network at each thread count, speedup against the first thread count
+static void strongScaling(const Sweep & sweep, Network & network, const SyntheticNetwork & s, bool learningOnly, vector<Result> & results) {
+
+    Benchmark benchmark(network, sweep.repetitions, 2);
+
+    for(unsigned k = 0;k < NR_OF_KERNELS;k++) {
+
+        KERNEL kernel = static_cast<KERNEL>(k);
+
+        if((learningOnly && kernel != K_LEARNING) || (kernel == K_FILTER && sweep.lateralInteraction == NONE))
+            continue;
+
+        double first = 0;
+
+        for(unsigned t = 0;t < sweep.threads.size();t++) {
+
+            benchmark.setThreads(sweep.threads[t]);
+
+            if(k == 0 && t == 0)
+                benchmark.settle(5);
+
+            Result r;
+            r.table = "strong";
+            r.kernel = kernelName(kernel);
+            r.rule = s.rule;
+            r.dimension = s.dimension;
+            r.depth = s.depth;
+            r.fanIn = s.fanIn;
+            r.threads = sweep.threads[t];
+            r.seconds = benchmark.time(kernel);
+            r.work = benchmark.work(kernel);
+
+            if(t == 0)
+                first = r.seconds;
+
+            r.speedup = r.seconds > 0 ? first / r.seconds : 0;
+            r.efficiency = r.speedup * sweep.threads[0] / sweep.threads[t];
+
+            results.push_back(r);
+        }
+    }
+}
+
+// Build, save and load of weight file, and history output, at the largest thread count
+static void inputOutput(const Sweep & sweep, const string & directory, const SyntheticNetwork & s, vector<Result> & results) {
+
+    string parameterFile = directory + "Parameters.txt";
+    string dataFile = directory + "Data.dat";
+    string weightFile = directory + "BlankNetwork.txt";
+    string historyDirectory = directory + "history/";
+
+    Result r;
+    r.table = "io";
+    r.rule = s.rule;
+    r.dimension = s.dimension;
+    r.depth = s.depth;
+    r.fanIn = s.fanIn;
+    r.threads = sweep.threads.back();
+    r.speedup = r.efficiency = 0;
+
+    setThreads(r.threads);
+
+    double buildSeconds, saveSeconds, loadSeconds, historySeconds;
+
+    {
+        Quiet quiet(sweep.verbose);
+
+        double start = now();
+        Network built(parameterFile.c_str(), sweep.verbose);
+        buildSeconds = now() - start;
+
+        start = now();
+        built.outputFinalNetwork(weightFile.c_str());
+        saveSeconds = now() - start;
+    }
+
+    unsigned long long weightBytes = fileSize(weightFile);
+
+    {
+        Quiet quiet(sweep.verbose);
+
+        double start = now();
+        Network loaded(dataFile.c_str(), parameterFile.c_str(), sweep.verbose, weightFile.c_str(), true);
+        loadSeconds = now() - start;
+    }
+
+    // History of a whole test epoch
+    SyntheticNetwork h = s;
+    h.saveHistory = SH_ALL_NEURONS_IN_REGION;
+    string historyParameterFile = directory + "HistoryParameters.txt";
+    writeParameterFile(historyParameterFile, h);
+    makeDirectory(historyDirectory);
+
+    {
+        Quiet quiet(sweep.verbose);
+
+        Network tested(dataFile.c_str(), historyParameterFile.c_str(), sweep.verbose, weightFile.c_str(), false);
+        Benchmark benchmark(tested, 1, 0);
+        historySeconds = benchmark.outputHistory(historyDirectory.c_str());
+    }
+
+    r.kernel = "weights build";
+    r.seconds = buildSeconds;
+    r.work = weightBytes;
+    results.push_back(r);
+
+    r.kernel = "weights save";
+    r.seconds = saveSeconds;
+    results.push_back(r);
+
+    r.kernel = "weights load";
+    r.seconds = loadSeconds;
+    results.push_back(r);
+
+    r.kernel = "history output";
+    r.seconds = historySeconds;
+    r.work = directorySize(historyDirectory);
+    results.push_back(r);
+}
+
+// Dimension grows with the square root of the thread count, so every thread keeps about the same number of neurons
+static void weakScaling(const Sweep & sweep, const string & directory, vector<Result> & results) {
+
+    vector<double> first(NR_OF_KERNELS, 0);
+
+    for(unsigned t = 0;t < sweep.threads.size();t++) {
+
+        int dimension = static_cast<int>(floor(sweep.weakDimension * sqrt(static_cast<double>(sweep.threads[t]) / sweep.threads[0]) + 0.5));
+        SyntheticNetwork s = synthetic(sweep, dimension, sweep.depths[0], sweep.fanIns[0], sweep.rules[0]);
+
+        string parameterFile = directory + "Parameters.txt";
+        string dataFile = directory + "Data.dat";
+        string weightFile = directory + "BlankNetwork.txt";
+
+        writeParameterFile(parameterFile, s);
+        writeDataFile(dataFile, s);
+        setThreads(sweep.threads[t]);
+
+        Quiet quiet(sweep.verbose);
+        Network built(parameterFile.c_str(), sweep.verbose);
+        built.outputFinalNetwork(weightFile.c_str());
+        Network network(dataFile.c_str(), parameterFile.c_str(), sweep.verbose, weightFile.c_str(), true);
+        quiet.stop();
+
+        Benchmark benchmark(network, sweep.repetitions, 2);
+        benchmark.setThreads(sweep.threads[t]);
+        benchmark.settle(5);
+
+        for(unsigned k = 0;k < NR_OF_KERNELS;k++) {
+
+            KERNEL kernel = static_cast<KERNEL>(k);
+
+            if(kernel == K_FILTER && sweep.lateralInteraction == NONE)
+                continue;
+
+            Result r;
+            r.table = "weak";
+            r.kernel = kernelName(kernel);
+            r.rule = s.rule;
+            r.dimension = s.dimension;
+            r.depth = s.depth;
+            r.fanIn = s.fanIn;
+            r.threads = sweep.threads[t];
+            r.seconds = benchmark.time(kernel);
+            r.work = benchmark.work(kernel);
+
+            if(t == 0)
+                first[k] = r.seconds;
+
+            r.efficiency = r.seconds > 0 ? first[k] / r.seconds : 0;
+            r.speedup = r.efficiency * sweep.threads[t] / sweep.threads[0];
+
+            results.push_back(r);
+        }
+    }
+}
+
+static void printTable(const vector<Result> & results, const string & table) {
+
+    cout << endl;
+    cout << std::left << setw(16) << "kernel" << setw(12) << "rule" << std::right << setw(6) << "dim" << setw(6) << "depth" << setw(7) << "fanIn"
+         << setw(8) << "threads" << setw(14) << "us/call" << setw(14) << (table == "io" ? "MB/s" : "M/s") << setw(9) << "speedup" << setw(11) << "efficiency" << endl;
+
+    for(unsigned i = 0;i < results.size();i++) {
+
+        const Result & r = results[i];
+
+        if(r.table != table)
+            continue;
+
+        double rate = r.seconds > 0 ? r.work / r.seconds / 1e6 : 0;
+
+        cout << std::left << setw(16) << r.kernel << setw(12) << ruleNames[r.rule] << std::right << setw(6) << r.dimension << setw(6) << r.depth << setw(7) << r.fanIn
+             << setw(8) << r.threads << std::fixed << std::setprecision(1) << setw(14) << r.seconds * 1e6 << setw(14) << rate;
+
+        if(table == "io")
+            cout << setw(9) << "-" << setw(11) << "-";
+        else
+            cout << std::setprecision(2) << setw(9) << r.speedup << setw(11) << r.efficiency;
+
+        cout.unsetf(std::ios::fixed);
+        cout << std::setprecision(6) << endl;
+    }
+}
+
+static void writeResults(const vector<Result> & results, const string & filename) {
+
+    ofstream file(filename.c_str());
+
+    if(!file) {
+
+        cerr << "Unable to open " << filename << ": " << strerror(errno) << endl;
+        cerr.flush();
+        exit(EXIT_FAILURE);
+    }
+
+    file.precision(12);
+    file << "table,kernel,rule,dimension,depth,fanIn,threads,secondsPerCall,work,workPerSecond,speedup,efficiency" << endl;
+
+    for(unsigned i = 0;i < results.size();i++) {
+
+        const Result & r = results[i];
+
+        file << r.table << "," << r.kernel << "," << ruleNames[r.rule] << "," << r.dimension << "," << r.depth << "," << r.fanIn << "," << r.threads << ","
+             << r.seconds << "," << r.work << "," << (r.seconds > 0 ? r.work / r.seconds : 0) << "," << r.speedup << "," << r.efficiency << endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    Sweep sweep;
+    sweep.dimensions.push_back(16);
+    sweep.dimensions.push_back(32);
+    sweep.dimensions.push_back(64);
+    sweep.depths.push_back(1);
+    sweep.depths.push_back(2);
+    sweep.fanIns.push_back(0.1f);
+    sweep.fanIns.push_back(1);
+    sweep.rules.push_back(TRACE_RULE);
+    sweep.rules.push_back(HEBB_RULE);
+    sweep.rules.push_back(COVARIANCE_PRESYNAPTIC_TRACE_RULE);
+    sweep.regions = 1;
+    sweep.inputDimension = 41;
+    sweep.weakDimension = 0;
+    sweep.repetitions = 20;
+    sweep.lateralInteraction = NONE;
+    sweep.verbose = false;
+
+    // Powers of two up to all processors, and all processors
+    for(int t = 1;t < processors();t *= 2)
+        sweep.threads.push_back(t);
+
+    sweep.threads.push_back(processors());
+
+    int i = 1;
+
+    for(;i < argc;i++) {
+
+        if(argv[i][0] != '-' || argv[i][1] != '-')  // break on first non-option token
+            break;
+
+        bool hasValue = i + 1 < argc;
+
+        if(strcmp("--help", argv[i]) == 0) {
+            usage();
+            return 0;
+        }
+        else if(strcmp("--verbose", argv[i]) == 0)
+            sweep.verbose = true;
+        else if(strcmp("--lateral", argv[i]) == 0)
+            sweep.lateralInteraction = SHORT_INHIBITION_LONG_EXCITATION;
+        else if(strcmp("--quick", argv[i]) == 0) {
+            sweep.dimensions.assign(1, 16);
+            sweep.depths.assign(1, 1);
+            sweep.fanIns.assign(1, 0.1f);
+            sweep.repetitions = 5;
+        }
+        else if(strcmp("--threads", argv[i]) == 0 && hasValue && parseList(argv[i + 1], sweep.threads))
+            i++;
+        else if(strcmp("--dimensions", argv[i]) == 0 && hasValue && parseList(argv[i + 1], sweep.dimensions))
+            i++;
+        else if(strcmp("--depths", argv[i]) == 0 && hasValue && parseList(argv[i + 1], sweep.depths))
+            i++;
+        else if(strcmp("--fanins", argv[i]) == 0 && hasValue && parseList(argv[i + 1], sweep.fanIns))
+            i++;
+        else if(strcmp("--rules", argv[i]) == 0 && hasValue) {
+
+            // By name, parseList() takes no 0 (trace)
+            sweep.rules.clear();
+            stringstream ss(argv[++i]);
+            string item;
+
+            while(std::getline(ss, item, ',')) {
+
+                int rule = -1;
+
+                for(int r = 0;r < 3;r++)
+                    if(item == ruleNames[r])
+                        rule = r;
+
+                if(rule == -1) {
+                    cout << "Unknown rule: " << item << endl;
+                    usage();
+                    return 1;
+                }
+
+                sweep.rules.push_back(rule);
+            }
+        }
+        else if(strcmp("--regions", argv[i]) == 0 && hasValue && atoi(argv[i + 1]) > 0)
+            sweep.regions = atoi(argv[++i]);
+        else if(strcmp("--input", argv[i]) == 0 && hasValue && atoi(argv[i + 1]) > 1)
+            sweep.inputDimension = atoi(argv[++i]);
+        else if(strcmp("--weak", argv[i]) == 0 && hasValue && atoi(argv[i + 1]) > 0)
+            sweep.weakDimension = atoi(argv[++i]);
+        else if(strcmp("--repetitions", argv[i]) == 0 && hasValue && atoi(argv[i + 1]) > 0)
+            sweep.repetitions = atoi(argv[++i]);
+        else {
+            cout << "Unknown option: " << argv[i] << endl;
+            usage();
+            return 1;
+        }
+    }
+
+    if(argc - i != 1 || sweep.rules.empty()) {
+        usage();
+        return 1;
+    }
+
+    if(sweep.weakDimension == 0)
+        sweep.weakDimension = sweep.dimensions[0];
+
+    string directory(argv[i]);
+
+    if(directory[directory.size() - 1] != '/')
+        directory.append("/");
+
+    makeDirectory(directory);
+
+    vector<Result> results;
+
+    // Strong scaling and file access of every network
+    for(unsigned d = 0;d < sweep.dimensions.size();d++)
+        for(unsigned e = 0;e < sweep.depths.size();e++)
+            for(unsigned f = 0;f < sweep.fanIns.size();f++)
+                for(unsigned r = 0;r < sweep.rules.size();r++) {
+
+                    SyntheticNetwork s = synthetic(sweep, sweep.dimensions[d], sweep.depths[e], sweep.fanIns[f], sweep.rules[r]);
+
+                    cout << "dimension " << s.dimension << ", depth " << s.depth << ", fan-in " << s.fanIn << ", " << ruleNames[s.rule] << " rule" << endl;
+
+                    string parameterFile = directory + "Parameters.txt";
+                    string dataFile = directory + "Data.dat";
+                    string weightFile = directory + "BlankNetwork.txt";
+
+                    writeParameterFile(parameterFile, s);
+                    writeDataFile(dataFile, s);
+
+                    // Only learning differs between rules
+                    if(r == 0)
+                        inputOutput(sweep, directory, s, results);
+                    else {
+                        Quiet quiet(sweep.verbose);
+                        setThreads(sweep.threads.back());
+                        Network built(parameterFile.c_str(), sweep.verbose);
+                        built.outputFinalNetwork(weightFile.c_str());
+                    }
+
+                    // Placed by the largest team, like a run of that size
+                    setThreads(sweep.threads.back());
+                    Quiet quiet(sweep.verbose);
+                    Network network(dataFile.c_str(), parameterFile.c_str(), sweep.verbose, weightFile.c_str(), true);
+                    quiet.stop();
+
+                    strongScaling(sweep, network, s, r > 0, results);
+                }
+
+    cout << "weak scaling from dimension " << sweep.weakDimension << endl;
+    weakScaling(sweep, directory, results);
+
+    cout << endl << "Strong scaling (speedup against " << sweep.threads[0] << " thread" << (sweep.threads[0] > 1 ? "s" : "") << ", M/s = million synapses or neurons per second):";
+    printTable(results, "strong");
+
+    cout << endl << "Weak scaling (dimension grows with square root of threads, efficiency = first time / time):";
+    printTable(results, "weak");
+
+    cout << endl << "Weight file and history output (MB/s of file):";
+    printTable(results, "io");
+
+    writeResults(results, directory + "bench.csv");
+    cout << endl << "Results are in " << directory << "bench.csv" << endl;
+
+    return 0;
+}
+
+void usage() {
+
+    cout << "usage: smibench [--help] [--verbose] [--quick] [--threads <list>] [--dimensions <list>] [--depths <list>]" << endl;
+    cout << "                [--fanins <list>] [--rules trace,hebb,covariance] [--regions <n>] [--input <n>]" << endl;
+    cout << "                [--weak <dimension>] [--repetitions <n>] [--lateral] <scratch directory>" << endl;
+    cout << endl;
+    cout << "Builds synthetic networks (no data file needed) in the scratch directory and times each" << endl;
+    cout << "kernel of a time step at every thread count, for every hidden dimension, depth, fan-in" << endl;
+    cout << "(fraction of presynaptic layer, 1 = full connectivity) and learning rule. Lists are comma" << endl;
+    cout << "separated. --threads defaults to powers of two up to all processors, --input is the input" << endl;
+    cout << "layer side (default 41), --weak the hidden dimension at the first thread count of the weak" << endl;
+    cout << "scaling table (default first of --dimensions), --lateral adds lateral interaction (filter)." << endl;
+    cout << "Tables go to the console and bench.csv in the scratch directory." << endl;
+}
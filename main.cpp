@@ -6,6 +6,10 @@
  */
 
 #include "Network.h"
+#include "Sweep.h"
+#include "TestBatch.h"
+#include "Server.h"
+#include "RegionMemory.h"
 #include <iostream>
 #include <cstring>
 #include <string>
@@ -29,12 +33,11 @@ int main (int argc, char *argv[]) {
 	// Iterate command line options
 	bool verbose = false;
 	bool xgrid = false;
-	
-	#ifdef OMP_ENABLE
-		int numberOfThreads = (3 * omp_get_num_procs())/4; // Ben's advice, uses 75% of cores
-	#else
-		int numberOfThreads = 1;
-	#endif
+	const char * resumeFile = NULL;
+	int numberOfThreads = 0; // 0 = default below
+	HUGEPAGES hugePages = HP_NONE;
+	THREADBINDING threadBinding = TB_NONE;
+	RunOptions options;
 
 
 	if(xgrid) {
@@ -63,6 +66,42 @@ int main (int argc, char *argv[]) {
 			xgrid = true;
 		else if(strcmp("--singlethreaded", argv[i]) == 0)
 			numberOfThreads = 1;
+		else if(strcmp("--tasks", argv[i]) == 0)
+			options.taskScheduling = true;
+		else if(strcmp("--profile", argv[i]) == 0)
+			options.profiling = true;
+		else if(strcmp("--counters", argv[i]) == 0)
+			options.counting = true;
+		else if(strcmp("--trace", argv[i]) == 0)
+			options.tracing = true;
+		else if(strcmp("--traceinterval", argv[i]) == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+			options.traceInterval = atoi(argv[++i]);
+		else if(strcmp("--tracemax", argv[i]) == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+			options.traceMaxSpans = atoi(argv[++i]);
+		else if(strcmp("--telemetry", argv[i]) == 0 && i + 1 < argc)
+			options.telemetryFile = argv[++i];
+		else if(strcmp("--telemetryinterval", argv[i]) == 0 && i + 1 < argc && atof(argv[i + 1]) > 0)
+			options.telemetryInterval = atof(argv[++i]);
+		else if(strcmp("--threads", argv[i]) == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+			numberOfThreads = atoi(argv[++i]);
+		else if(strcmp("--bind", argv[i]) == 0 && i + 1 < argc && strcmp("close", argv[i + 1]) == 0) {
+			threadBinding = TB_CLOSE;
+			i++;
+		}
+		else if(strcmp("--bind", argv[i]) == 0 && i + 1 < argc && strcmp("spread", argv[i + 1]) == 0) {
+			threadBinding = TB_SPREAD;
+			i++;
+		}
+		else if(strcmp("--hugepages", argv[i]) == 0 && i + 1 < argc && strcmp("transparent", argv[i + 1]) == 0) {
+			hugePages = HP_TRANSPARENT;
+			i++;
+		}
+		else if(strcmp("--hugepages", argv[i]) == 0 && i + 1 < argc && strcmp("explicit", argv[i + 1]) == 0) {
+			hugePages = HP_EXPLICIT;
+			i++;
+		}
+		else if(strcmp("--resume", argv[i]) == 0 && i + 1 < argc)
+			resumeFile = argv[++i];
 		else {
 			cout << "Unknown option: " << argv[i] << endl;
 			usage();
@@ -70,6 +109,25 @@ int main (int argc, char *argv[]) {
 		}
 	}
     
+	if(numberOfThreads == 0) {
+	#ifdef OMP_ENABLE
+		numberOfThreads = (3 * omp_get_num_procs())/4; // Ben's advice, uses 75% of cores
+        
+		if(numberOfThreads < 1)
+			numberOfThreads = 1;
+	#else
+		numberOfThreads = 1;
+	#endif
+	}
+    
+	// Before any region is built: regions are first touched by the team that runs them
+	setHugePages(hugePages);
+	setThreadBinding(threadBinding);
+    
+	#ifdef OMP_ENABLE
+		omp_set_num_threads(numberOfThreads);
+	#endif
+    
 	// Iterate command line arguments
 	if(argc - i < 3)
 		cout << "Expected at least three arguments." << endl;
@@ -140,8 +198,18 @@ int main (int argc, char *argv[]) {
 			cout << "Loading network..." << endl;
 			Network n(dataFile, paramFile, verbose, net, true);
 			
+			if(resumeFile != NULL) {
+				cout << "Loading checkpoint..." << endl;
+				n.loadCheckpoint(resumeFile);
+			}
+			
 			cout << "Training network..." << endl;
+			n.options = options;
 			n.run(outputDir, true, numberOfThreads, xgrid);
+			
+			// Checkpoint was written, nothing else to save
+			if(n.interrupted)
+				return 1;
 
 			cout << "Saving network..." << endl;
 			string s(outputDir);
@@ -157,6 +225,34 @@ int main (int argc, char *argv[]) {
                 }			
 			#endif
 			
+		} else if(strcmp("sweep", argv[i]) == 0) {
+			
+			if(xgrid) {
+				cerr << "No support for sweeps on grid..." << endl;
+				return 1;
+			} else if(argc - i != 6) {
+				cout << "Expected six arguments: sweep <parameter file> <sweep file> <untrained network file> <data file> <output directory>" << endl;
+				return 1;
+			}
+			
+			paramFile = argv[i + 1];
+			net = argv[i + 3];
+			dataFile = argv[i + 4];
+			outputDir = argv[i + 5];
+			
+			// Checkpoints are in the run directories of the interrupted sweep
+			if(resumeFile != NULL && strcmp(resumeFile, outputDir) != 0) {
+				cerr << "A sweep is resumed in its own output directory: --resume " << outputDir << endl;
+				return 1;
+			}
+			
+			Sweep sweep(paramFile, argv[i + 2], net, dataFile, verbose);
+			
+			cout << "Training networks..." << endl;
+			
+			if(!sweep.run(outputDir, numberOfThreads, options, resumeFile != NULL))
+				return 1;
+			
 		} else if(strcmp("test", argv[i]) == 0) {
 			
 			if(xgrid) {
@@ -183,8 +279,46 @@ int main (int argc, char *argv[]) {
 			Network n(dataFile, paramFile, verbose, net, false);
 
 			cout << "Testing network..." << endl;
+			n.options = options;
 			n.run(outputDir, false, numberOfThreads, xgrid);
 
+		} else if(strcmp("testbatch", argv[i]) == 0) {
+			
+			if(xgrid) {
+				cerr << "No support for testing on grid..." << endl;
+				return 1;
+			} else if(argc - i != 5) {
+				cout << "Expected five arguments: testbatch <parameter file> <trained network list> <data file list> <output directory>" << endl;
+				return 1;
+			}
+			
+			paramFile = argv[i + 1];
+			outputDir = argv[i + 4];
+			
+			TestBatch batch(paramFile, argv[i + 2], argv[i + 3], verbose);
+			
+			cout << "Testing networks..." << endl;
+			batch.run(outputDir, numberOfThreads, options);
+			
+		} else if(strcmp("serve", argv[i]) == 0) {
+			
+			if(xgrid) {
+				cerr << "No support for serving on grid..." << endl;
+				return 1;
+			} else if(argc - i != 4 && argc - i != 5) {
+				cout << "Expected three or four arguments: serve <parameter file> <trained network file> <socket> [<concurrent jobs>]" << endl;
+				return 1;
+			}
+			
+			paramFile = argv[i + 1];
+			net = argv[i + 2];
+			
+			cout << "Loading network..." << endl;
+			Network n(NULL, paramFile, verbose, net, false);
+			
+			Server server(n, argv[i + 3], numberOfThreads, argc - i == 5 ? atoi(argv[i + 4]) : 0, options);
+			server.run();
+			
 		} else if(strcmp("loadtest", argv[i]) == 0) {
             
             /*
@@ -213,9 +347,26 @@ int main (int argc, char *argv[]) {
 void usage() {
 
 	cout << endl;
-	cout << "usage: smi [--help] [--verbose]  [--xgrid] [--singlethreaded] " << endl; // [--silent]
+	cout << "usage: smi [--help] [--verbose]  [--xgrid] [--singlethreaded] [--resume <checkpoint file>]" << endl; // [--silent]
+	cout << "           [--threads <n>] [--bind close|spread] [--hugepages transparent|explicit] [--tasks] [--profile]" << endl;
+	cout << "           [--counters] [--trace] [--traceinterval <n>] [--tracemax <n>]" << endl;
+	cout << "           [--telemetry <file>] [--telemetryinterval <seconds>]" << endl;
     cout << "               COMMAND ARGS" << endl;
     cout << endl;
+    cout << "--threads sets the number of threads (default 75% of cores), --bind pins them to cores," << endl;
+    cout << "close fills one socket first, spread divides them over sockets. --hugepages backs large" << endl;
+    cout << "region buffers with transparent huge pages or the reserved pool (/proc/sys/vm/nr_hugepages)." << endl;
+    cout << "--tasks runs each time step as tasks with per region dependencies instead of barriers." << endl;
+    cout << "--profile writes time per phase and region, synapse updates/s and GB/s to Profile.json" << endl;
+    cout << "and Profile.csv in the output directory, per epoch and for the whole run." << endl;
+    cout << "--counters also adds cycles, instructions, LLC and dTLB misses (Linux perf_event_open)" << endl;
+    cout << "to the profile, and prints IPC and misses per synapse of each region at the end." << endl;
+    cout << "--trace writes Trace.json (chrome://tracing, ui.perfetto.dev) with a span per thread for" << endl;
+    cout << "every region phase and wait, of every n-th time step (--traceinterval, default 1) and at" << endl;
+    cout << "most n spans per thread (--tracemax, default 200000)." << endl;
+    cout << "--telemetry appends a JSON line with epoch, object, steps/s, synapse updates/s, ETA, RSS and" << endl;
+    cout << "last weight change to a file or FIFO every n seconds (--telemetryinterval, default 10)." << endl;
+    cout << endl;
     cout << "The command list for smi is:" << endl;
 
 	cout << "\t build\t Build new network." << endl;
@@ -223,7 +374,26 @@ void usage() {
 
 	cout << "\t run\t Train built network." << endl;
 	cout << "\t\t\t  train <parameter file> <untrained network file> <data file> <output directory>" << endl;
+	cout << "\t\t\t  Training writes <output directory>Checkpoint.dat on SIGTERM/SIGINT (and every" << endl;
+	cout << "\t\t\t  training.checkpointInterval seconds), continue with --resume <checkpoint file>." << endl;
+
+	cout << "\t sweep\t Train variants of built network in one process." << endl;
+	cout << "\t\t\t  sweep <parameter file> <sweep file> <untrained network file> <data file> <output directory>" << endl;
+	cout << "\t\t\t  The sweep file lists runs = ( {...}, ... ) of settings overriding the parameter file," << endl;
+	cout << "\t\t\t  run r is saved in <output directory>run<r>/ with its merged Parameters.txt. An interrupted" << endl;
+	cout << "\t\t\t  sweep continues with --resume <output directory>, runs from their checkpoints." << endl;
 
 	cout << "\t run\t Test trained network." << endl;
 	cout << "\t\t\t  test <parameter file> <untrained network file> <data file> <output directory>" << endl;
+
+	cout << "\t testbatch\t Test several trained networks on several data files in one process." << endl;
+	cout << "\t\t\t  testbatch <parameter file> <trained network list> <data file list> <output directory>" << endl;
+	cout << "\t\t\t  Lists have one file per line, network n on data file d is saved in" << endl;
+	cout << "\t\t\t  <output directory>data<d>/net<n>/, TestBatch.txt lists the files of each directory." << endl;
+
+	cout << "\t serve\t Test trained network on data files sent over a Unix domain socket." << endl;
+	cout << "\t\t\t  serve <parameter file> <trained network file> <socket> [<concurrent jobs>]" << endl;
+	cout << "\t\t\t  Each connection sends one line: test <data file> <output directory> [<recorded data>]," << endl;
+	cout << "\t\t\t  recorded data is e.g. firingRate,trace (default all), or shutdown. Reply is ok <seconds>" << endl;
+	cout << "\t\t\t  or error <reason>. Jobs share the threads, by default one thread per job." << endl;
 }